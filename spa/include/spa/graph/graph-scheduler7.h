@@ -0,0 +1,624 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_GRAPH_SCHEDULER_H__
+#define __SPA_GRAPH_SCHEDULER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include <spa/graph/graph.h>
+
+/* Non-recursive scheduler.
+ *
+ * Whenever the graph version changes, the nodes of the graph are sorted
+ * in topological order and compiled into an array of node records with
+ * an array of port records next to it. The records of a node hold the
+ * implementation, the scheduling counters and for each port the io
+ * area and the index of the peer, so that a cycle does not need to
+ * follow the lists of the graph. The lists stay the view of the graph
+ * used to make changes.
+ *
+ * A cycle then consists of a backwards sweep over the records, pulling
+ * data from upstream nodes, and a forwards sweep, pushing data to the
+ * downstream nodes. Sweeps are repeated until no node has work left.
+ *
+ * Nodes that are linked to the graph but not part of any graph are
+ * processed right away from their lists.
+ *
+ * The records live in a storage block that is allocated by the thread that
+ * changes the graph, see spa_graph_reserve(). The data thread takes the
+ * newest block when it sorts and hands the old one back to be freed, so
+ * that it does not allocate memory itself. */
+
+#define SPA_GRAPH_STATE_IDLE		0	/**< nothing to do */
+#define SPA_GRAPH_STATE_PROCESS_OUTPUT	1	/**< call process_output */
+#define SPA_GRAPH_STATE_PROCESS_INPUT	2	/**< call process_input */
+
+struct spa_graph_data_port {
+	struct spa_io_buffers *io;		/**< io of the peer port */
+	uint32_t flags;				/**< flags of the port */
+	uint32_t peer;				/**< index of the peer node record or
+						  *  SPA_ID_INVALID */
+	uint32_t *peer_ready;			/**< ready counter of the peer */
+	uint32_t *peer_required;		/**< required counter of the peer */
+	struct spa_graph_node *foreign;		/**< peer node without graph */
+};
+
+struct spa_graph_data_node {
+	struct spa_node *implementation;
+	uint32_t state;
+	uint32_t ready[2];
+	uint32_t required[2];
+	uint32_t n_ports[2];
+	struct spa_graph_data_port *ports[2];
+	struct spa_graph_node *node;
+};
+
+/* the memory for the records */
+struct spa_graph_data_storage {
+	struct spa_graph_data_storage *next;	/**< next retired storage */
+	uint32_t max_nodes;
+	uint32_t max_ports;
+	struct spa_graph_data_node *nodes;
+	struct spa_graph_data_port *ports;
+};
+
+struct spa_graph_data {
+	struct spa_graph *graph;
+	uint32_t version;			/**< graph version of the records */
+	uint32_t n_pending;			/**< nodes with a state != IDLE */
+	uint32_t pull_end;			/**< end of the nodes to pull */
+	uint32_t push_start;			/**< start of the nodes to push */
+	bool running;				/**< sweeping the records */
+
+	struct spa_graph_data_node *nodes;	/**< nodes in topological order */
+	uint32_t n_nodes;
+	struct spa_graph_data_storage *storage;	/**< in use by the data thread */
+
+	/* owned by the thread that changes the graph */
+	struct spa_graph_data_storage *pending;	/**< newest storage, not taken yet */
+	struct spa_graph_data_storage *retired;	/**< storage given back to be freed */
+	int32_t reserved_nodes;			/**< room asked for */
+	int32_t reserved_ports;
+	uint32_t max_nodes;			/**< room of the newest storage */
+	uint32_t max_ports;
+};
+
+static inline void spa_graph_data_init(struct spa_graph_data *data,
+				       struct spa_graph *graph)
+{
+	data->graph = graph;
+	data->version = SPA_ID_INVALID;
+	data->n_pending = 0;
+	data->pull_end = data->push_start = 0;
+	data->running = false;
+	data->nodes = NULL;
+	data->n_nodes = 0;
+	data->storage = data->pending = data->retired = NULL;
+	data->reserved_nodes = data->reserved_ports = 0;
+	data->max_nodes = data->max_ports = 0;
+}
+
+static inline void spa_graph_data_free_retired(struct spa_graph_data *data)
+{
+	struct spa_graph_data_storage *s, *next;
+
+	s = __atomic_exchange_n(&data->retired, NULL, __ATOMIC_ACQUIRE);
+	for (; s; s = next) {
+		next = s->next;
+		free(s);
+	}
+}
+
+static inline void spa_graph_data_clear(struct spa_graph_data *data)
+{
+	spa_graph_data_free_retired(data);
+	free(data->storage);
+	free(data->pending);
+	spa_graph_data_init(data, data->graph);
+}
+
+static inline struct spa_graph_data_storage *
+spa_graph_data_storage_new(uint32_t max_nodes, uint32_t max_ports)
+{
+	struct spa_graph_data_storage *s;
+
+	s = malloc(sizeof(*s) + max_nodes * sizeof(struct spa_graph_data_node) +
+		   max_ports * sizeof(struct spa_graph_data_port));
+	if (s == NULL)
+		return NULL;
+
+	s->next = NULL;
+	s->max_nodes = max_nodes;
+	s->max_ports = max_ports;
+	s->nodes = SPA_MEMBER(s, sizeof(*s), struct spa_graph_data_node);
+	s->ports = SPA_MEMBER(s->nodes, max_nodes * sizeof(struct spa_graph_data_node),
+			      struct spa_graph_data_port);
+	return s;
+}
+
+/* give \a s back to the thread that changes the graph */
+static inline void spa_graph_data_retire(struct spa_graph_data *data,
+					 struct spa_graph_data_storage *s)
+{
+	s->next = __atomic_load_n(&data->retired, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&data->retired, &s->next, s, false,
+					    __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/** Make room for \a n_nodes more nodes and \a n_ports more ports, called
+ * from the thread that changes the graph */
+static inline int spa_graph_data_reserve(struct spa_graph_data *data,
+					 int32_t n_nodes, int32_t n_ports)
+{
+	struct spa_graph_data_storage *s;
+	uint32_t max_nodes, max_ports;
+
+	spa_graph_data_free_retired(data);
+
+	data->reserved_nodes = SPA_MAX(data->reserved_nodes + n_nodes, 0);
+	data->reserved_ports = SPA_MAX(data->reserved_ports + n_ports, 0);
+
+	if ((uint32_t) data->reserved_nodes <= data->max_nodes &&
+	    (uint32_t) data->reserved_ports <= data->max_ports)
+		return 0;
+
+	max_nodes = SPA_MAX((uint32_t) data->reserved_nodes, data->max_nodes * 2);
+	max_ports = SPA_MAX((uint32_t) data->reserved_ports, data->max_ports * 2);
+	if ((s = spa_graph_data_storage_new(max_nodes, max_ports)) == NULL)
+		return -ENOMEM;
+
+	/* a storage that was not taken yet was never used */
+	free(__atomic_exchange_n(&data->pending, s, __ATOMIC_ACQ_REL));
+	data->max_nodes = max_nodes;
+	data->max_ports = max_ports;
+
+	return 0;
+}
+
+/* take the newest storage, from the data thread */
+static inline int spa_graph_data_ensure(struct spa_graph_data *data,
+					uint32_t n_nodes, uint32_t n_ports)
+{
+	struct spa_graph_data_storage *s, *old = data->storage;
+
+	if ((s = __atomic_exchange_n(&data->pending, NULL, __ATOMIC_ACQUIRE)) == NULL)
+		s = old;
+
+	/* only when nodes or ports were added without reserving room */
+	if (s == NULL || n_nodes > s->max_nodes || n_ports > s->max_ports) {
+		struct spa_graph_data_storage *t;
+
+		spa_debug("graph %p: %d nodes %d ports were not reserved", data->graph,
+			  n_nodes, n_ports);
+		if ((t = spa_graph_data_storage_new(n_nodes * 2, n_ports * 2)) == NULL)
+			return -ENOMEM;
+		if (s != NULL && s != old)
+			spa_graph_data_retire(data, s);
+		s = t;
+	}
+	if (s != old) {
+		if (old != NULL)
+			spa_graph_data_retire(data, old);
+		data->storage = s;
+		data->nodes = s->nodes;
+		data->n_nodes = 0;
+	}
+	return 0;
+}
+
+static inline struct spa_graph_node *
+spa_graph_data_peer_node(struct spa_graph *graph, struct spa_graph_port *port)
+{
+	struct spa_graph_port *peer = port->peer;
+
+	if (peer == NULL || peer->peer != port ||
+	    peer->node == NULL || peer->node->graph != graph)
+		return NULL;
+	return peer->node;
+}
+
+/* the record of a node, removed nodes can still point to an old record */
+static inline struct spa_graph_data_node *
+spa_graph_data_find_node(struct spa_graph_data *data, struct spa_graph_node *node)
+{
+	struct spa_graph_data_node *n = node->scheduler_data;
+
+	if (node->graph != data->graph || n == NULL ||
+	    n < data->nodes || n >= data->nodes + data->n_nodes || n->node != node)
+		return NULL;
+	return n;
+}
+
+static inline int spa_graph_data_sort(struct spa_graph_data *data)
+{
+	struct spa_graph *graph = data->graph;
+	struct spa_graph_node *n, *pn;
+	struct spa_graph_port *p, *pp;
+	struct spa_list order;
+	uint32_t i, d, n_nodes = 0, n_ports = 0;
+	int res;
+
+	spa_debug("graph %p sort version %d", graph, graph->version);
+
+	spa_list_for_each(n, &graph->nodes, link) {
+		n_nodes++;
+		for (d = 0; d < 2; d++)
+			spa_list_for_each(p, &n->ports[d], link)
+				n_ports++;
+	}
+	if ((res = spa_graph_data_ensure(data, n_nodes, n_ports)) < 0)
+		return res;
+
+	spa_list_init(&order);
+
+	/* the state is used to count the unsorted peers of each node */
+	spa_list_for_each(n, &graph->nodes, link) {
+		n->ready_link.next = NULL;
+		n->state = 0;
+		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
+			if (spa_graph_data_peer_node(graph, p))
+				n->state++;
+		}
+	}
+	spa_list_for_each(n, &graph->nodes, link) {
+		if (n->state == 0)
+			spa_list_append(&order, &n->ready_link);
+	}
+	spa_list_for_each(n, &order, ready_link) {
+		spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
+			if ((pn = spa_graph_data_peer_node(graph, p)) == NULL)
+				continue;
+			if (--pn->state == 0)
+				spa_list_append(&order, &pn->ready_link);
+		}
+	}
+	/* nodes in a loop never get sorted, run them last */
+	spa_list_for_each(n, &graph->nodes, link) {
+		if (n->ready_link.next == NULL) {
+			spa_debug("node %p is in a loop", n);
+			spa_list_append(&order, &n->ready_link);
+		}
+		n->state = SPA_STATUS_OK;
+	}
+
+	i = 0;
+	spa_list_for_each(n, &order, ready_link) {
+		struct spa_graph_data_node *dn = &data->nodes[i++];
+		dn->node = n;
+		dn->implementation = n->implementation;
+		dn->state = SPA_GRAPH_STATE_IDLE;
+		for (d = 0; d < 2; d++) {
+			dn->ready[d] = 0;
+			dn->required[d] = n->required[d];
+		}
+		n->scheduler_data = dn;
+	}
+	data->n_nodes = n_nodes;
+
+	/* the order list only lives while sorting */
+	spa_list_for_each(n, &graph->nodes, link)
+		n->ready_link.next = NULL;
+
+	n_ports = 0;
+	for (i = 0; i < n_nodes; i++) {
+		struct spa_graph_data_node *dn = &data->nodes[i];
+
+		for (d = 0; d < 2; d++) {
+			dn->ports[d] = &data->storage->ports[n_ports];
+			dn->n_ports[d] = 0;
+
+			spa_list_for_each(p, &dn->node->ports[d], link) {
+				struct spa_graph_data_port *dp;
+				struct spa_graph_data_node *pdn;
+
+				/* ports of the other graphs are scheduled from there */
+				if ((pp = p->peer) == NULL || (pp->flags & SPA_GRAPH_PORT_FLAG_DISABLED) ||
+				    (pn = pp->node) == NULL || (pn->graph != NULL && pn->graph != graph))
+					continue;
+
+				dp = &dn->ports[d][dn->n_ports[d]++];
+				dp->io = pp->io;
+				dp->flags = p->flags;
+				if ((pdn = spa_graph_data_find_node(data, pn)) != NULL) {
+					dp->peer = pdn - data->nodes;
+					dp->peer_ready = &pdn->ready[SPA_DIRECTION_REVERSE(d)];
+					dp->peer_required = &pdn->required[SPA_DIRECTION_REVERSE(d)];
+					dp->foreign = NULL;
+				} else {
+					dp->peer = SPA_ID_INVALID;
+					dp->peer_ready = &pn->ready[SPA_DIRECTION_REVERSE(d)];
+					dp->peer_required = &pn->required[SPA_DIRECTION_REVERSE(d)];
+					dp->foreign = pn;
+				}
+			}
+			n_ports += dn->n_ports[d];
+		}
+	}
+	data->n_pending = 0;
+	data->pull_end = 0;
+	data->push_start = n_nodes;
+	data->version = graph->version;
+
+	spa_debug("graph %p sorted %d nodes %d ports", graph, n_nodes, n_ports);
+
+	return 0;
+}
+
+static inline void spa_graph_data_process_foreign(struct spa_graph_data *data,
+						  struct spa_graph_node *node, int state);
+
+static inline void spa_graph_data_mark_node(struct spa_graph_data *data,
+					    struct spa_graph_data_node *node, int state)
+{
+	uint32_t index = node - data->nodes;
+
+	if (node->state == SPA_GRAPH_STATE_IDLE)
+		data->n_pending++;
+	node->state = state;
+
+	/* the sweeps only visit the range of marked nodes */
+	if (state == SPA_GRAPH_STATE_PROCESS_OUTPUT)
+		data->pull_end = SPA_MAX(data->pull_end, index + 1);
+	else
+		data->push_start = SPA_MIN(data->push_start, index);
+}
+
+static inline void spa_graph_data_mark(struct spa_graph_data *data,
+				       struct spa_graph_data_port *port, int state)
+{
+	if (port->peer == SPA_ID_INVALID) {
+		spa_graph_data_process_foreign(data, port->foreign, state);
+		return;
+	}
+	spa_graph_data_mark_node(data, &data->nodes[port->peer], state);
+}
+
+static inline void spa_graph_data_need_input(struct spa_graph_data *data,
+					     struct spa_graph_data_node *node)
+{
+	struct spa_graph_data_port *p, *end;
+
+	spa_debug("node %p need input", node->node);
+
+	node->ready[SPA_DIRECTION_INPUT] = 0;
+	node->required[SPA_DIRECTION_INPUT] = 0;
+
+	p = node->ports[SPA_DIRECTION_INPUT];
+	end = p + node->n_ports[SPA_DIRECTION_INPUT];
+	for (; p < end; p++) {
+		if (p->io->status == SPA_STATUS_NEED_BUFFER) {
+			(*p->peer_ready)++;
+			if (!(p->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
+				node->required[SPA_DIRECTION_INPUT]++;
+		}
+		if (*p->peer_required > 0 && *p->peer_ready >= *p->peer_required)
+			spa_graph_data_mark(data, p, SPA_GRAPH_STATE_PROCESS_OUTPUT);
+	}
+}
+
+static inline void spa_graph_data_have_output(struct spa_graph_data *data,
+					      struct spa_graph_data_node *node)
+{
+	struct spa_graph_data_port *p, *end;
+
+	spa_debug("node %p have output", node->node);
+
+	node->ready[SPA_DIRECTION_OUTPUT] = 0;
+	node->required[SPA_DIRECTION_OUTPUT] = 0;
+
+	p = node->ports[SPA_DIRECTION_OUTPUT];
+	end = p + node->n_ports[SPA_DIRECTION_OUTPUT];
+	for (; p < end; p++) {
+		if (p->io->status == SPA_STATUS_HAVE_BUFFER) {
+			(*p->peer_ready)++;
+			if (!(p->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
+				node->required[SPA_DIRECTION_OUTPUT]++;
+		}
+		if (*p->peer_required > 0 && *p->peer_ready >= *p->peer_required)
+			spa_graph_data_mark(data, p, SPA_GRAPH_STATE_PROCESS_INPUT);
+	}
+}
+
+static inline void spa_graph_data_process(struct spa_graph_data *data,
+					  struct spa_graph_data_node *node, int state)
+{
+	int res;
+
+	if (state == SPA_GRAPH_STATE_PROCESS_OUTPUT) {
+		res = spa_node_process_output(node->implementation);
+		spa_debug("node %p processed out %d", node->node, res);
+	} else {
+		res = spa_node_process_input(node->implementation);
+		spa_debug("node %p processed in %d", node->node, res);
+	}
+
+	if (res == SPA_STATUS_NEED_BUFFER)
+		spa_graph_data_need_input(data, node);
+	else if (res == SPA_STATUS_HAVE_BUFFER)
+		spa_graph_data_have_output(data, node);
+}
+
+/* scan the ports of a node that has no record */
+static inline void spa_graph_data_scan_foreign(struct spa_graph_data *data,
+					       struct spa_graph_node *node,
+					       enum spa_direction direction)
+{
+	struct spa_graph_port *p;
+	enum spa_direction reverse = SPA_DIRECTION_REVERSE(direction);
+	int status = direction == SPA_DIRECTION_INPUT ?
+		SPA_STATUS_NEED_BUFFER : SPA_STATUS_HAVE_BUFFER;
+	int state = direction == SPA_DIRECTION_INPUT ?
+		SPA_GRAPH_STATE_PROCESS_OUTPUT : SPA_GRAPH_STATE_PROCESS_INPUT;
+
+	node->ready[direction] = 0;
+	node->required[direction] = 0;
+	spa_list_for_each(p, &node->ports[direction], link) {
+		struct spa_graph_port *pport;
+		struct spa_graph_node *pnode;
+		struct spa_graph_data_node *pdn;
+		uint32_t *pready, *prequired;
+
+		if ((pport = p->peer) == NULL || (pport->flags & SPA_GRAPH_PORT_FLAG_DISABLED))
+			continue;
+		pnode = pport->node;
+
+		if ((pdn = spa_graph_data_find_node(data, pnode)) != NULL) {
+			pready = &pdn->ready[reverse];
+			prequired = &pdn->required[reverse];
+		} else if (pnode->graph == NULL) {
+			pready = &pnode->ready[reverse];
+			prequired = &pnode->required[reverse];
+		} else
+			continue;
+
+		if (pport->io->status == status) {
+			(*pready)++;
+			if (!(p->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
+				node->required[direction]++;
+		}
+		if (*prequired == 0 || *pready < *prequired)
+			continue;
+
+		if (pdn == NULL) {
+			spa_graph_data_process_foreign(data, pnode, state);
+			continue;
+		}
+		spa_graph_data_mark_node(data, pdn, state);
+	}
+}
+
+static inline void spa_graph_data_process_foreign(struct spa_graph_data *data,
+						  struct spa_graph_node *node, int state)
+{
+	int res;
+
+	if (state == SPA_GRAPH_STATE_PROCESS_OUTPUT)
+		res = spa_node_process_output(node->implementation);
+	else
+		res = spa_node_process_input(node->implementation);
+
+	spa_debug("foreign node %p processed %d", node, res);
+
+	if (res == SPA_STATUS_NEED_BUFFER)
+		spa_graph_data_scan_foreign(data, node, SPA_DIRECTION_INPUT);
+	else if (res == SPA_STATUS_HAVE_BUFFER)
+		spa_graph_data_scan_foreign(data, node, SPA_DIRECTION_OUTPUT);
+}
+
+static inline void spa_graph_data_run(struct spa_graph_data *data)
+{
+	struct spa_graph_data_node *n;
+	uint32_t i;
+
+	data->running = true;
+	while (data->n_pending > 0) {
+		/* pull, upstream nodes come before their peers */
+		i = data->pull_end;
+		data->pull_end = 0;
+		for (; i > 0 && data->n_pending > 0; i--) {
+			n = &data->nodes[i - 1];
+			if (n->state != SPA_GRAPH_STATE_PROCESS_OUTPUT)
+				continue;
+			n->state = SPA_GRAPH_STATE_IDLE;
+			data->n_pending--;
+			spa_graph_data_process(data, n, SPA_GRAPH_STATE_PROCESS_OUTPUT);
+		}
+		/* push, downstream nodes come after their peers */
+		i = data->push_start;
+		data->push_start = data->n_nodes;
+		for (; i < data->n_nodes && data->n_pending > 0; i++) {
+			n = &data->nodes[i];
+			if (n->state != SPA_GRAPH_STATE_PROCESS_INPUT)
+				continue;
+			n->state = SPA_GRAPH_STATE_IDLE;
+			data->n_pending--;
+			spa_graph_data_process(data, n, SPA_GRAPH_STATE_PROCESS_INPUT);
+		}
+	}
+	data->running = false;
+}
+
+static inline int spa_graph_data_start(struct spa_graph_data *data,
+				       struct spa_graph_node *node,
+				       enum spa_direction direction)
+{
+	struct spa_graph_data_node *n;
+	int res;
+
+	if (!data->running && data->version != data->graph->version &&
+	    (res = spa_graph_data_sort(data)) < 0)
+		return res;
+
+	if ((n = spa_graph_data_find_node(data, node)) == NULL)
+		spa_graph_data_scan_foreign(data, node, direction);
+	else if (direction == SPA_DIRECTION_INPUT)
+		spa_graph_data_need_input(data, n);
+	else
+		spa_graph_data_have_output(data, n);
+
+	/* when called from a node callback, the running cycle picks up the work */
+	if (!data->running)
+		spa_graph_data_run(data);
+
+	return 0;
+}
+
+static inline int spa_graph_impl_need_input(void *data, struct spa_graph_node *node)
+{
+	int res;
+
+	spa_debug("node %p start pull", node);
+	res = spa_graph_data_start(data, node, SPA_DIRECTION_INPUT);
+	spa_debug("node %p end pull %d", node, res);
+	return res;
+}
+
+static inline int spa_graph_impl_have_output(void *data, struct spa_graph_node *node)
+{
+	int res;
+
+	spa_debug("node %p start push", node);
+	res = spa_graph_data_start(data, node, SPA_DIRECTION_OUTPUT);
+	spa_debug("node %p end push %d", node, res);
+	return res;
+}
+
+static inline int spa_graph_impl_reserve(void *data, int32_t n_nodes, int32_t n_ports)
+{
+	return spa_graph_data_reserve(data, n_nodes, n_ports);
+}
+
+static const struct spa_graph_callbacks spa_graph_impl_default = {
+	SPA_VERSION_GRAPH_CALLBACKS,
+	.need_input = spa_graph_impl_need_input,
+	.have_output = spa_graph_impl_have_output,
+	.reserve = spa_graph_impl_reserve,
+};
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_GRAPH_SCHEDULER_H__ */
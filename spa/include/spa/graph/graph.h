@@ -43,16 +43,25 @@ struct spa_graph_callbacks {
 
 	int (*need_input) (void *data, struct spa_graph_node *node);
 	int (*have_output) (void *data, struct spa_graph_node *node);
+
+	/** Make room for \a n_nodes more nodes and \a n_ports more ports, negative
+	 *  values release room again. Called from the thread that changes the
+	 *  graph before it queues the change for the data thread, so that the
+	 *  scheduler does not need to allocate memory when it runs. Optional. */
+	int (*reserve) (void *data, int32_t n_nodes, int32_t n_ports);
 };
 
 struct spa_graph {
 	struct spa_list nodes;
+	uint32_t version;		/**< incremented on each topology change */
 	const struct spa_graph_callbacks *callbacks;
 	void *callbacks_data;
 };
 
 #define spa_graph_need_input(g,n)	((g)->callbacks->need_input((g)->callbacks_data, (n)))
 #define spa_graph_have_output(g,n)	((g)->callbacks->have_output((g)->callbacks_data, (n)))
+#define spa_graph_reserve(g,n,p)	((g)->callbacks && (g)->callbacks->reserve ?		\
+					 (g)->callbacks->reserve((g)->callbacks_data, (n), (p)) : 0)
 #define spa_graph_reuse_buffer(g,n,p,i)	((g)->callbacks->reuse_buffer((g)->callbacks_data, (n),(p),(i)))
 
 struct spa_graph_node {
@@ -84,6 +93,15 @@ struct spa_graph_port {
 static inline void spa_graph_init(struct spa_graph *graph)
 {
 	spa_list_init(&graph->nodes);
+	graph->version = 0;
+	graph->callbacks = NULL;
+	graph->callbacks_data = NULL;
+}
+
+static inline void spa_graph_changed(struct spa_graph *graph)
+{
+	if (graph)
+		graph->version++;
 }
 
 static inline void
@@ -100,6 +118,8 @@ spa_graph_node_init(struct spa_graph_node *node)
 {
 	spa_list_init(&node->ports[SPA_DIRECTION_INPUT]);
 	spa_list_init(&node->ports[SPA_DIRECTION_OUTPUT]);
+	node->graph = NULL;
+	node->ready_link.next = NULL;
 	node->flags = 0;
 	node->required[SPA_DIRECTION_INPUT] = node->ready[SPA_DIRECTION_INPUT] = 0;
 	node->required[SPA_DIRECTION_OUTPUT] = node->ready[SPA_DIRECTION_OUTPUT] = 0;
@@ -121,6 +141,7 @@ spa_graph_node_add(struct spa_graph *graph,
 	node->state = SPA_STATUS_OK;
 	node->ready_link.next = NULL;
 	spa_list_append(&graph->nodes, &node->link);
+	spa_graph_changed(graph);
 	spa_debug("node %p add", node);
 }
 
@@ -132,6 +153,7 @@ spa_graph_port_init(struct spa_graph_port *port,
 		    struct spa_io_buffers *io)
 {
 	spa_debug("port %p init type %d id %d", port, direction, port_id);
+	port->node = NULL;
 	port->direction = direction;
 	port->port_id = port_id;
 	port->flags = flags;
@@ -147,6 +169,7 @@ spa_graph_port_add(struct spa_graph_node *node,
 	spa_list_append(&node->ports[port->direction], &port->link);
 	if (!(port->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
 		node->required[port->direction]++;
+	spa_graph_changed(node->graph);
 }
 
 static inline void spa_graph_node_remove(struct spa_graph_node *node)
@@ -155,6 +178,7 @@ static inline void spa_graph_node_remove(struct spa_graph_node *node)
 	spa_list_remove(&node->link);
 	if (node->ready_link.next)
 		spa_list_remove(&node->ready_link);
+	spa_graph_changed(node->graph);
 }
 
 static inline void spa_graph_port_remove(struct spa_graph_port *port)
@@ -165,6 +189,7 @@ static inline void spa_graph_port_remove(struct spa_graph_port *port)
 	    port->node->required[port->direction] > 0) {
 		port->node->required[port->direction]--;
 	}
+	spa_graph_changed(port->node->graph);
 }
 
 static inline void
@@ -173,6 +198,8 @@ spa_graph_port_link(struct spa_graph_port *out, struct spa_graph_port *in)
 	spa_debug("port %p link to %p", out, in);
 	out->peer = in;
 	in->peer = out;
+	if (out->node)
+		spa_graph_changed(out->node->graph);
 }
 
 static inline void
@@ -183,6 +210,8 @@ spa_graph_port_unlink(struct spa_graph_port *port)
 		port->peer->peer = NULL;
 		port->peer = NULL;
 	}
+	if (port->node)
+		spa_graph_changed(port->node->graph);
 }
 
 #ifdef __cplusplus
@@ -69,9 +69,33 @@ struct spa_io_control_range {
 	uint32_t max_size;	/**< maximum size of data */
 };
 
+/** The graph quantum */
+#define SPA_TYPE_IO_CONTROL__Quantum	SPA_TYPE_IO_CONTROL_BASE "Quantum"
+
+/** The number of samples the graph processes in one cycle. The area is
+ * shared by all ports of the graph, drivers wake up the graph after
+ * \a size samples. The size can change between two cycles. */
+struct spa_io_control_quantum {
+	uint32_t size;		/**< the quantum in samples */
+};
+
+/** The clock of a driver */
+#define SPA_TYPE_IO_CONTROL__Clock	SPA_TYPE_IO_CONTROL_BASE "Clock"
+
+/** The timing of the current cycle, updated by a driver before it wakes
+ * up the graph. The data of the cycle has to be complete before
+ * \a deadline or the driver will run out of data. */
+struct spa_io_control_clock {
+	uint64_t nsec;		/**< monotonic time when the cycle started */
+	uint64_t deadline;	/**< monotonic time when the cycle must be complete */
+	uint64_t n_xruns;	/**< number of xruns of the driver */
+};
+
 struct spa_type_io {
 	uint32_t Buffers;
 	uint32_t ControlRange;
+	uint32_t ControlQuantum;
+	uint32_t ControlClock;
 	uint32_t Prop;
 };
 
@@ -80,6 +104,8 @@ static inline void spa_type_io_map(struct spa_type_map *map, struct spa_type_io
 	if (type->Buffers == 0) {
 		type->Buffers = spa_type_map_get_id(map, SPA_TYPE_IO__Buffers);
 		type->ControlRange = spa_type_map_get_id(map, SPA_TYPE_IO_CONTROL__Range);
+		type->ControlQuantum = spa_type_map_get_id(map, SPA_TYPE_IO_CONTROL__Quantum);
+		type->ControlClock = spa_type_map_get_id(map, SPA_TYPE_IO_CONTROL__Clock);
 		type->Prop = spa_type_map_get_id(map, SPA_TYPE_IO__Prop);
 	}
 }
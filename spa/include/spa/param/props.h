@@ -45,6 +45,9 @@ extern "C" {
 #define SPA_TYPE_PROPS__frequency	SPA_TYPE_PROPS_BASE "frequency"
 #define SPA_TYPE_PROPS__volume		SPA_TYPE_PROPS_BASE "volume"
 #define SPA_TYPE_PROPS__mute		SPA_TYPE_PROPS_BASE "mute"
+#define SPA_TYPE_PROPS__channelVolumes	SPA_TYPE_PROPS_BASE "channelVolumes"
+#define SPA_TYPE_PROPS__rampDuration	SPA_TYPE_PROPS_BASE "rampDuration"
+#define SPA_TYPE_PROPS__rampCurve	SPA_TYPE_PROPS_BASE "rampCurve"
 #define SPA_TYPE_PROPS__patternType	SPA_TYPE_PROPS_BASE "patternType"
 
 #ifdef __cplusplus
@@ -36,6 +36,13 @@ struct spa_loop_utils;
 #define SPA_TYPE_LOOP__MainLoop		SPA_TYPE_LOOP_BASE "MainLoop"
 #define SPA_TYPE_LOOP__DataLoop		SPA_TYPE_LOOP_BASE "DataLoop"
 
+/** Info key of the loop factory to select how the loop waits for events,
+ * "epoll" (default) or "io_uring" when it is available */
+#define SPA_LOOP_INFO_BACKEND		"loop.backend"
+/** Info key of the loop factory to collect dispatch statistics of the
+ * sources, see \ref spa_loop_source_stats */
+#define SPA_LOOP_INFO_PROFILE		"loop.profile"
+
 #include <spa/utils/defs.h>
 #include <spa/utils/hook.h>
 
@@ -50,6 +57,12 @@ struct spa_source;
 
 typedef void (*spa_source_func_t) (struct spa_source *source);
 
+/** Priorities of sources, of the sources that are ready at the same time
+ * the ones with the highest priority are dispatched first */
+#define SPA_SOURCE_PRIORITY_LOW		-10	/**< protocol connections */
+#define SPA_SOURCE_PRIORITY_DEFAULT	0
+#define SPA_SOURCE_PRIORITY_HIGH	10	/**< realtime devices and transports */
+
 struct spa_source {
 	struct spa_loop *loop;
 	spa_source_func_t func;
@@ -57,6 +70,8 @@ struct spa_source {
 	int fd;
 	enum spa_io mask;
 	enum spa_io rmask;
+	void *priv;		/**< private data of the loop implementation */
+	int priority;		/**< dispatch priority, can be changed at any time */
 };
 
 typedef int (*spa_invoke_func_t) (struct spa_loop *loop,
@@ -101,6 +116,20 @@ struct spa_loop {
 #define spa_loop_invoke(l,...)		(l)->invoke((l),__VA_ARGS__)
 
 
+/** Dispatch statistics of a source. The delay is measured from the moment
+ * the loop woke up, or from the expiration for timers, until the callback
+ * was called. All times are in nanoseconds. */
+struct spa_loop_source_stats {
+	const struct spa_source *source;	/**< the source */
+	const void *func;			/**< the callback of the source */
+	void *data;				/**< the data of the callback */
+	uint64_t n_dispatch;			/**< number of times the callback was called */
+	uint64_t total_time;			/**< total time spent in the callback */
+	uint64_t max_time;			/**< longest callback */
+	uint64_t total_delay;			/**< total delay before dispatch */
+	uint64_t max_delay;			/**< longest delay before dispatch */
+};
+
 /** Control hooks */
 struct spa_loop_control_hooks {
 #define SPA_VERSION_LOOP_CONTROL_HOOKS	0
@@ -117,7 +146,7 @@ struct spa_loop_control_hooks {
 struct spa_loop_control {
 	/* the version of this structure. This can be used to expand this
 	 * structure in the future */
-#define SPA_VERSION_LOOP_CONTROL	0
+#define SPA_VERSION_LOOP_CONTROL	1
 	uint32_t version;
 
 	int (*get_fd) (struct spa_loop_control *ctrl);
@@ -133,7 +162,22 @@ struct spa_loop_control {
 	void (*enter) (struct spa_loop_control *ctrl);
 	void (*leave) (struct spa_loop_control *ctrl);
 
+	/** Wait \a timeout msec for events and dispatch them
+	 * \param ctrl the control
+	 * \param timeout the timeout in msec, -1 waits forever
+	 * \return the number of events, < 0 on error */
 	int (*iterate) (struct spa_loop_control *ctrl, int timeout);
+
+	/** Get the dispatch statistics of a source, since version 1.
+	 * This function should only be called when the loop is not running
+	 * or from the context of the running loop.
+	 * \param ctrl the control
+	 * \param index the index of the source, incremented on success
+	 * \param stats the statistics to fill
+	 * \return 1 when \a stats was filled, 0 when there are no more sources,
+	 *         -ENOTSUP when profiling is not enabled */
+	int (*get_stats) (struct spa_loop_control *ctrl, uint32_t *index,
+			  struct spa_loop_source_stats *stats);
 };
 
 #define spa_loop_control_get_fd(l)		(l)->get_fd(l)
@@ -141,6 +185,7 @@ struct spa_loop_control {
 #define spa_loop_control_enter(l)		(l)->enter(l)
 #define spa_loop_control_iterate(l,...)		(l)->iterate((l),__VA_ARGS__)
 #define spa_loop_control_leave(l)		(l)->leave(l)
+#define spa_loop_control_get_stats(l,...)	(l)->get_stats((l),__VA_ARGS__)
 
 
 typedef void (*spa_source_io_func_t) (void *data, int fd, enum spa_io mask);
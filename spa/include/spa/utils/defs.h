@@ -51,6 +51,8 @@ enum spa_direction {
 	SPA_DIRECTION_OUTPUT = 1,
 };
 
+#define SPA_DIRECTION_REVERSE(d)	((d) == SPA_DIRECTION_INPUT ? SPA_DIRECTION_OUTPUT : SPA_DIRECTION_INPUT)
+
 #define SPA_RECTANGLE(width,height) (struct spa_rectangle){ width, height }
 
 struct spa_rectangle {
@@ -80,6 +80,14 @@ static inline void spa_list_remove(struct spa_list *elem)
 #define spa_list_for_each(pos, head, member)						\
 	spa_list_for_each_next(pos, head, head, member)					\
 
+#define spa_list_for_each_prev(pos, head, curr, member)					\
+	for (pos = SPA_CONTAINER_OF((curr)->prev, __typeof__(*pos), member);		\
+	     &pos->member != (head);							\
+	     pos = SPA_CONTAINER_OF(pos->member.prev, __typeof__(*pos), member))
+
+#define spa_list_for_each_reverse(pos, head, member)					\
+	spa_list_for_each_prev(pos, head, head, member)					\
+
 #define spa_list_for_each_safe_next(pos, tmp, head, curr, member)			\
 	for (pos = SPA_CONTAINER_OF((curr)->next, __typeof__(*pos), member),		\
 	     tmp = SPA_CONTAINER_OF((pos)->member.next, __typeof__(*tmp), member);	\
@@ -163,6 +163,252 @@ static inline void spa_ringbuffer_write_update(struct spa_ringbuffer *rbuf, int3
 	__atomic_store_n(&rbuf->writeindex, index, __ATOMIC_RELEASE);
 }
 
+/**
+ * Reserve \a len bytes for writing in place.
+ *
+ * The \a size bytes of \a buffer must be mapped twice back to back, so
+ * that the reserved bytes are always contiguous, even when they wrap
+ * around the end of the ringbuffer memory.
+ *
+ * \param rbuf a spa_ringbuffer
+ * \param buffer the mirrored ringbuffer memory
+ * \param size the size of \a buffer, a power of 2
+ * \param len the number of bytes to reserve, at most \a size
+ * \param index the write index, pass it to spa_ringbuffer_write_commit()
+ * \return a pointer to \a len bytes or NULL when there is not enough space
+ */
+static inline void *
+spa_ringbuffer_write_reserve(struct spa_ringbuffer *rbuf, void *buffer, uint32_t size,
+			     uint32_t len, uint32_t *index)
+{
+	int32_t filled = spa_ringbuffer_get_write_index(rbuf, index);
+
+	if (filled < 0 || (int32_t) size - filled < (int32_t) len)
+		return NULL;
+	return SPA_MEMBER(buffer, *index & (size - 1), void);
+}
+
+/**
+ * Make \a len of the reserved bytes available to the reader.
+ *
+ * \param rbuf a spa_ringbuffer
+ * \param index the index from spa_ringbuffer_write_reserve()
+ * \param len the number of bytes written
+ */
+static inline void
+spa_ringbuffer_write_commit(struct spa_ringbuffer *rbuf, uint32_t index, uint32_t len)
+{
+	spa_ringbuffer_write_update(rbuf, index + len);
+}
+
+/**
+ * Get a pointer to all the readable bytes of a mirrored ringbuffer,
+ * see spa_ringbuffer_write_reserve().
+ *
+ * \param rbuf a spa_ringbuffer
+ * \param buffer the mirrored ringbuffer memory
+ * \param size the size of \a buffer, a power of 2
+ * \param index the read index, pass it to spa_ringbuffer_read_release()
+ * \param avail the number of contiguous bytes at the returned pointer
+ * \return a pointer to the readable bytes or NULL when there are none
+ */
+static inline const void *
+spa_ringbuffer_read_peek(struct spa_ringbuffer *rbuf, const void *buffer, uint32_t size,
+			 uint32_t *index, int32_t *avail)
+{
+	if ((*avail = spa_ringbuffer_get_read_index(rbuf, index)) <= 0)
+		return NULL;
+	*avail = SPA_MIN(*avail, (int32_t) size);
+	return SPA_MEMBER(buffer, *index & (size - 1), const void);
+}
+
+/**
+ * Release \a len bytes that were read in place.
+ *
+ * \param rbuf a spa_ringbuffer
+ * \param index the index from spa_ringbuffer_read_peek()
+ * \param len the number of bytes consumed
+ */
+static inline void
+spa_ringbuffer_read_release(struct spa_ringbuffer *rbuf, uint32_t index, uint32_t len)
+{
+	spa_ringbuffer_read_update(rbuf, index + len);
+}
+
+/**
+ * A ringbuffer with the read and write index on separate cache lines.
+ *
+ * The reader and the writer each keep a copy of the index of the other
+ * side next to their own index. The index of the other side is only
+ * loaded when the copy says there is not enough data (reader) or space
+ * (writer), so the cache lines don't move between the cpus on every
+ * update.
+ *
+ * There can be only one reader and one writer.
+ */
+struct spa_ringbuffer_padded {
+	uint32_t readindex SPA_ALIGNED(64);	/*< the current read index */
+	uint32_t read_cache;			/*< the writeindex last seen by the reader */
+	uint32_t writeindex SPA_ALIGNED(64);	/*< the current write index */
+	uint32_t write_cache;			/*< the readindex last seen by the writer */
+} SPA_ALIGNED(64);
+
+/**
+ * Initialize a spa_ringbuffer_padded.
+ *
+ * \param rbuf a spa_ringbuffer_padded
+ */
+static inline void spa_ringbuffer_padded_init(struct spa_ringbuffer_padded *rbuf)
+{
+	rbuf->readindex = rbuf->read_cache = 0;
+	rbuf->writeindex = rbuf->write_cache = 0;
+}
+
+/**
+ * Get the read index and available bytes for reading.
+ *
+ * \param rbuf a spa_ringbuffer_padded
+ * \param index the value of readindex
+ * \param len the number of bytes the reader needs, the writeindex is
+ *         loaded when less are available
+ * \return number of available bytes to read, see
+ *         spa_ringbuffer_get_read_index()
+ */
+static inline int32_t
+spa_ringbuffer_padded_get_read_index(struct spa_ringbuffer_padded *rbuf, uint32_t *index,
+				     uint32_t len)
+{
+	int32_t avail;
+
+	*index = rbuf->readindex;
+	avail = (int32_t) (rbuf->read_cache - *index);
+	if (avail < (int32_t) len) {
+		rbuf->read_cache = __atomic_load_n(&rbuf->writeindex, __ATOMIC_ACQUIRE);
+		avail = (int32_t) (rbuf->read_cache - *index);
+	}
+	return avail;
+}
+
+/**
+ * Read \a len bytes from \a rbuf, see spa_ringbuffer_read_data()
+ */
+static inline void
+spa_ringbuffer_padded_read_data(struct spa_ringbuffer_padded *rbuf,
+				const void *buffer, uint32_t size,
+				uint32_t offset, void *data, uint32_t len)
+{
+	spa_ringbuffer_read_data(NULL, buffer, size, offset, data, len);
+}
+
+/**
+ * Update the read pointer to \a index.
+ *
+ * \param rbuf a spa_ringbuffer_padded
+ * \param index new index
+ */
+static inline void
+spa_ringbuffer_padded_read_update(struct spa_ringbuffer_padded *rbuf, int32_t index)
+{
+	__atomic_store_n(&rbuf->readindex, index, __ATOMIC_RELEASE);
+}
+
+/**
+ * Get the write index and the number of bytes inside the ringbuffer.
+ *
+ * \param rbuf a spa_ringbuffer_padded
+ * \param index the value of writeindex
+ * \param size the size of the ringbuffer memory
+ * \param len the number of bytes the writer needs, the readindex is
+ *         loaded when less space is available
+ * \return the fill level of \a rbuf, see spa_ringbuffer_get_write_index()
+ */
+static inline int32_t
+spa_ringbuffer_padded_get_write_index(struct spa_ringbuffer_padded *rbuf, uint32_t *index,
+				      uint32_t size, uint32_t len)
+{
+	int32_t filled;
+
+	*index = rbuf->writeindex;
+	filled = (int32_t) (*index - rbuf->write_cache);
+	if ((int32_t) size - filled < (int32_t) len) {
+		rbuf->write_cache = __atomic_load_n(&rbuf->readindex, __ATOMIC_ACQUIRE);
+		filled = (int32_t) (*index - rbuf->write_cache);
+	}
+	return filled;
+}
+
+/**
+ * Write \a len bytes to \a rbuf, see spa_ringbuffer_write_data()
+ */
+static inline void
+spa_ringbuffer_padded_write_data(struct spa_ringbuffer_padded *rbuf,
+				 void *buffer, uint32_t size,
+				 uint32_t offset, const void *data, uint32_t len)
+{
+	spa_ringbuffer_write_data(NULL, buffer, size, offset, data, len);
+}
+
+/**
+ * Update the write pointer to \a index
+ *
+ * \param rbuf a spa_ringbuffer_padded
+ * \param index new index
+ */
+static inline void
+spa_ringbuffer_padded_write_update(struct spa_ringbuffer_padded *rbuf, int32_t index)
+{
+	__atomic_store_n(&rbuf->writeindex, index, __ATOMIC_RELEASE);
+}
+
+/**
+ * Reserve \a len bytes for writing in place, see
+ * spa_ringbuffer_write_reserve()
+ */
+static inline void *
+spa_ringbuffer_padded_write_reserve(struct spa_ringbuffer_padded *rbuf, void *buffer,
+				    uint32_t size, uint32_t len, uint32_t *index)
+{
+	int32_t filled = spa_ringbuffer_padded_get_write_index(rbuf, index, size, len);
+
+	if (filled < 0 || (int32_t) size - filled < (int32_t) len)
+		return NULL;
+	return SPA_MEMBER(buffer, *index & (size - 1), void);
+}
+
+/**
+ * Make \a len of the reserved bytes available to the reader
+ */
+static inline void
+spa_ringbuffer_padded_write_commit(struct spa_ringbuffer_padded *rbuf, uint32_t index,
+				   uint32_t len)
+{
+	spa_ringbuffer_padded_write_update(rbuf, index + len);
+}
+
+/**
+ * Get a pointer to the readable bytes of a mirrored ringbuffer when
+ * there are at least \a len of them, see spa_ringbuffer_read_peek()
+ */
+static inline const void *
+spa_ringbuffer_padded_read_peek(struct spa_ringbuffer_padded *rbuf, const void *buffer,
+				uint32_t size, uint32_t len, uint32_t *index, int32_t *avail)
+{
+	if ((*avail = spa_ringbuffer_padded_get_read_index(rbuf, index, len)) < (int32_t) len ||
+	    *avail <= 0)
+		return NULL;
+	*avail = SPA_MIN(*avail, (int32_t) size);
+	return SPA_MEMBER(buffer, *index & (size - 1), const void);
+}
+
+/**
+ * Release \a len bytes that were read in place
+ */
+static inline void
+spa_ringbuffer_padded_read_release(struct spa_ringbuffer_padded *rbuf, uint32_t index,
+				   uint32_t len)
+{
+	spa_ringbuffer_padded_read_update(rbuf, index + len);
+}
 
 #ifdef __cplusplus
 }  /* extern "C" */
@@ -552,6 +552,10 @@ impl_node_port_set_io(struct spa_node *node,
 		this->io = data;
 	else if (id == t->io.ControlRange)
 		this->range = data;
+	else if (id == t->io.ControlQuantum)
+		this->quantum = data;
+	else if (id == t->io.ControlClock)
+		this->clock = data;
 	else
 		return -ENOENT;
 
@@ -561,6 +561,10 @@ impl_node_port_set_io(struct spa_node *node,
 
 	if (id == t->io.Buffers)
 		this->io = data;
+	else if (id == t->io.ControlQuantum)
+		this->quantum = data;
+	else if (id == t->io.ControlClock)
+		this->clock = data;
 	else
 		return -ENOENT;
 
@@ -353,6 +353,23 @@ static inline void try_pull(struct state *state, snd_pcm_uframes_t frames,
 	}
 }
 
+static inline void add_xrun(struct state *state)
+{
+	if (state->clock)
+		state->clock->n_xruns++;
+}
+
+/* the graph has to deliver or consume the data before the device has
+ * played or recorded \a frames */
+static inline void update_clock(struct state *state, int64_t now, snd_pcm_uframes_t frames)
+{
+	if (state->clock == NULL)
+		return;
+
+	state->clock->nsec = now;
+	state->clock->deadline = now + frames * SPA_NSEC_PER_SEC / state->rate;
+}
+
 static inline snd_pcm_uframes_t
 pull_frames(struct state *state,
 	    const snd_pcm_channel_area_t *my_areas,
@@ -414,6 +431,8 @@ pull_frames(struct state *state,
 	if (total_frames == 0 && do_pull) {
 		total_frames = SPA_MIN(frames, state->threshold);
 		snd_pcm_areas_silence(my_areas, offset, state->channels, total_frames, state->format);
+		if (state->underrun == 0)
+			add_xrun(state);
 		state->underrun += total_frames;
 		underrun = true;
 	}
@@ -498,6 +517,25 @@ static int alsa_try_resume(struct state *state)
 	return res;
 }
 
+/* follow the quantum of the graph when there is one, the buffers are
+ * never larger than max_latency for playback and min_latency for capture */
+static void update_threshold(struct state *state)
+{
+	uint32_t threshold = state->props.min_latency;
+
+	if (state->quantum && state->quantum->size > 0) {
+		threshold = state->quantum->size;
+		if (state->stream == SND_PCM_STREAM_PLAYBACK)
+			threshold = SPA_MIN(threshold, state->props.max_latency);
+		else
+			threshold = SPA_MIN(threshold, state->props.min_latency);
+	}
+	if (threshold != state->threshold)
+		spa_log_debug(state->log, "%p: threshold %d -> %d", state, state->threshold, threshold);
+
+	state->threshold = threshold;
+}
+
 static void alsa_on_playback_timeout_event(struct spa_source *source)
 {
 	uint64_t exp;
@@ -523,6 +561,8 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 	avail = snd_pcm_status_get_avail(status);
 	snd_pcm_status_get_htstamp(status, &state->now);
 
+	update_threshold(state);
+
 	if (avail > state->buffer_frames)
 		avail = state->buffer_frames;
 
@@ -530,6 +570,7 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 
 	state->last_ticks = state->sample_count - state->filled;
 	state->last_monotonic = (int64_t) state->now.tv_sec * SPA_NSEC_PER_SEC + (int64_t) state->now.tv_nsec;
+	update_clock(state, state->last_monotonic, state->filled);
 
 	spa_log_trace(state->log, "timeout %ld %d %ld %ld %ld", state->filled, state->threshold,
 		      state->sample_count, state->now.tv_sec, state->now.tv_nsec);
@@ -561,6 +602,8 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 			spa_log_trace(state->log, "commit %ld %ld", offset, written);
 			if ((res = snd_pcm_mmap_commit(hndl, offset, written)) < 0) {
 				spa_log_error(state->log, "snd_pcm_mmap_commit error: %s", snd_strerror(res));
+				if (res == -EPIPE)
+					add_xrun(state);
 				if (res != -EPIPE && res != -ESTRPIPE)
 					return;
 			}
@@ -613,8 +656,12 @@ static void alsa_on_capture_timeout_event(struct spa_source *source)
 	avail = snd_pcm_status_get_avail(status);
 	snd_pcm_status_get_htstamp(status, &htstamp);
 
+	update_threshold(state);
+
 	state->last_ticks = state->sample_count + avail;
 	state->last_monotonic = (int64_t) htstamp.tv_sec * SPA_NSEC_PER_SEC + (int64_t) htstamp.tv_nsec;
+	update_clock(state, state->last_monotonic,
+		     avail < state->buffer_frames ? state->buffer_frames - avail : 0);
 
 	spa_log_trace(state->log, "timeout %ld %d %ld %ld %ld", avail, state->threshold,
 		      state->sample_count, htstamp.tv_sec, htstamp.tv_nsec);
@@ -643,6 +690,8 @@ static void alsa_on_capture_timeout_event(struct spa_source *source)
 
 			if ((res = snd_pcm_mmap_commit(hndl, offset, read)) < 0) {
 				spa_log_error(state->log, "snd_pcm_mmap_commit error: %s", snd_strerror(res));
+				if (res == -EPIPE)
+					add_xrun(state);
 				if (res != -EPIPE && res != -ESTRPIPE)
 					return;
 			}
@@ -685,9 +734,10 @@ int spa_alsa_start(struct state *state, bool xrun_recover)
 	state->source.fd = state->timerfd;
 	state->source.mask = SPA_IO_IN;
 	state->source.rmask = 0;
+	state->source.priority = SPA_SOURCE_PRIORITY_HIGH;
 	spa_loop_add_source(state->data_loop, &state->source);
 
-	state->threshold = state->props.min_latency;
+	update_threshold(state);
 
 	if (state->stream == SND_PCM_STREAM_PLAYBACK) {
 		state->alsa_started = false;
@@ -146,6 +146,8 @@ struct state {
 	struct spa_port_info info;
 	struct spa_io_buffers *io;
 	struct spa_io_control_range *range;
+	struct spa_io_control_quantum *quantum;
+	struct spa_io_control_clock *clock;
 
 	struct buffer buffers[MAX_BUFFERS];
 	unsigned int n_buffers;
@@ -0,0 +1,134 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <math.h>
+#include <emmintrin.h>
+
+#include "fmt-ops.h"
+
+/* these are only used when source and destination have the same layout, so
+ * each plane is converted as one flat array of samples. The tails do the
+ * same math as the C versions so that the results are the same */
+
+#define FOREACH_PLANE(conv,n_samples,p,n)					\
+	uint32_t p, n_planes, n;						\
+	if (CONV_IS_PLANAR((conv)->src_fmt)) {					\
+		n_planes = (conv)->n_channels;					\
+		n = (n_samples);						\
+	} else {								\
+		n_planes = 1;							\
+		n = (n_samples) * (conv)->n_channels;				\
+	}									\
+	for (p = 0; p < n_planes; p++)
+
+static void
+s16_to_f32(float *d, const int16_t *s, uint32_t n_samples)
+{
+	__m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	__m128i in, lo, hi;
+	uint32_t n;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		in = _mm_loadu_si128((const __m128i *) &s[n]);
+		lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+		hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+		_mm_storeu_ps(&d[n], _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(&d[n + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+	for (; n < n_samples; n++)
+		d[n] = s[n] * (1.0f / 32768.0f);
+}
+
+void conv_s16_to_f32_sse2(struct convert *conv, void *dst[], const void *src[], uint32_t n_samples)
+{
+	FOREACH_PLANE(conv, n_samples, p, n)
+		s16_to_f32(dst[p], src[p], n);
+}
+
+static void
+f32_to_s16(int16_t *d, const float *s, uint32_t n_samples)
+{
+	__m128 min = _mm_set1_ps(-1.0f), max = _mm_set1_ps(1.0f);
+	__m128 scale = _mm_set1_ps(32767.0f);
+	__m128 in0, in1;
+	uint32_t n;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		in0 = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&s[n]), min), max);
+		in1 = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&s[n + 4]), min), max);
+		_mm_storeu_si128((__m128i *) &d[n],
+				 _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(in0, scale)),
+						 _mm_cvtps_epi32(_mm_mul_ps(in1, scale))));
+	}
+	for (; n < n_samples; n++)
+		d[n] = lrintf(SPA_CLAMP(s[n], -1.0f, 1.0f) * 32767.0f);
+}
+
+void conv_f32_to_s16_sse2(struct convert *conv, void *dst[], const void *src[], uint32_t n_samples)
+{
+	FOREACH_PLANE(conv, n_samples, p, n)
+		f32_to_s16(dst[p], src[p], n);
+}
+
+static void
+s32_to_f32(float *d, const int32_t *s, uint32_t n_samples)
+{
+	__m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+	__m128i in;
+	uint32_t n;
+
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		in = _mm_loadu_si128((const __m128i *) &s[n]);
+		_mm_storeu_ps(&d[n], _mm_mul_ps(_mm_cvtepi32_ps(in), scale));
+	}
+	for (; n < n_samples; n++)
+		d[n] = s[n] * (1.0f / 2147483648.0f);
+}
+
+void conv_s32_to_f32_sse2(struct convert *conv, void *dst[], const void *src[], uint32_t n_samples)
+{
+	FOREACH_PLANE(conv, n_samples, p, n)
+		s32_to_f32(dst[p], src[p], n);
+}
+
+static void
+f32_to_s32(int32_t *d, const float *s, uint32_t n_samples)
+{
+	__m128 min = _mm_set1_ps(-1.0f), max = _mm_set1_ps(1.0f);
+	__m128d scale = _mm_set1_pd(2147483647.0);
+	__m128d lo, hi;
+	__m128 in;
+	uint32_t n;
+
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		in = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&s[n]), min), max);
+		lo = _mm_mul_pd(_mm_cvtps_pd(in), scale);
+		hi = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(in, in)), scale);
+		_mm_storeu_si128((__m128i *) &d[n],
+				 _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi)));
+	}
+	for (; n < n_samples; n++)
+		d[n] = lrint(SPA_CLAMP(s[n], -1.0f, 1.0f) * 2147483647.0);
+}
+
+void conv_f32_to_s32_sse2(struct convert *conv, void *dst[], const void *src[], uint32_t n_samples)
+{
+	FOREACH_PLANE(conv, n_samples, p, n)
+		f32_to_s32(dst[p], src[p], n);
+}
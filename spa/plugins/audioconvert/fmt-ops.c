@@ -0,0 +1,350 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <math.h>
+#include <endian.h>
+
+#include "fmt-ops.h"
+
+typedef struct {
+	uint8_t v[3];
+} __attribute__ ((packed)) s24_t;
+
+#define S24_MAX		8388607
+
+static inline int32_t read_s24(const s24_t *s)
+{
+#if __BYTE_ORDER == __BIG_ENDIAN
+	return ((int8_t) s->v[0] << 16) | (s->v[1] << 8) | s->v[2];
+#else
+	return ((int8_t) s->v[2] << 16) | (s->v[1] << 8) | s->v[0];
+#endif
+}
+
+static inline s24_t write_s24(int32_t v)
+{
+	s24_t s;
+#if __BYTE_ORDER == __BIG_ENDIAN
+	s.v[0] = v >> 16;
+	s.v[1] = v >> 8;
+	s.v[2] = v;
+#else
+	s.v[0] = v;
+	s.v[1] = v >> 8;
+	s.v[2] = v >> 16;
+#endif
+	return s;
+}
+
+/* to F32, the integer formats go to [-1.0, 1.0) */
+#define U8_TO_F32(s)		(((s) - 128) * (1.0f / 128.0f))
+#define S16_TO_F32(s)		((s) * (1.0f / 32768.0f))
+#define S24_TO_F32(s)		(read_s24(&(s)) * (1.0f / 8388608.0f))
+#define S24_32_TO_F32(s)	(((int32_t) ((uint32_t) (s) << 8) >> 8) * (1.0f / 8388608.0f))
+#define S32_TO_F32(s)		((s) * (1.0f / 2147483648.0f))
+#define F64_TO_F32(s)		((float) (s))
+
+/* from F32, clipped to [-1.0, 1.0] and rounded to nearest. S32 goes
+ * through doubles because floats don't have the bits */
+#define CLIP(s)			SPA_CLAMP((s), -1.0f, 1.0f)
+#define F32_TO_U8(s)		(lrintf(CLIP(s) * 127.0f) + 128)
+#define F32_TO_S16(s)		lrintf(CLIP(s) * 32767.0f)
+#define F32_TO_S24(s)		write_s24(lrintf(CLIP(s) * (float) S24_MAX))
+#define F32_TO_S24_32(s)	lrintf(CLIP(s) * (float) S24_MAX)
+#define F32_TO_S32(s)		lrint(CLIP(s) * 2147483647.0)
+#define F32_TO_F64(s)		((double) (s))
+
+/* S32 and F64 have more bits than F32 and go to and from F64 */
+#define U8_TO_F64(s)		(((s) - 128) * (1.0 / 128.0))
+#define S16_TO_F64(s)		((s) * (1.0 / 32768.0))
+#define S24_TO_F64(s)		(read_s24(&(s)) * (1.0 / 8388608.0))
+#define S24_32_TO_F64(s)	(((int32_t) ((uint32_t) (s) << 8) >> 8) * (1.0 / 8388608.0))
+#define S32_TO_F64(s)		((s) * (1.0 / 2147483648.0))
+
+#define CLIP_F64(s)		SPA_CLAMP((s), -1.0, 1.0)
+#define F64_TO_U8(s)		(lrint(CLIP_F64(s) * 127.0) + 128)
+#define F64_TO_S16(s)		lrint(CLIP_F64(s) * 32767.0)
+#define F64_TO_S24(s)		write_s24(lrint(CLIP_F64(s) * (double) S24_MAX))
+#define F64_TO_S24_32(s)	lrint(CLIP_F64(s) * (double) S24_MAX)
+#define F64_TO_S32(s)		lrint(CLIP_F64(s) * 2147483647.0)
+
+#define COPY(s)			(s)
+
+/* convert each channel on its own, which works for all the layouts */
+#define MAKE_CONV(name,stype,dtype,func)						\
+static void										\
+name(struct convert *conv, void *dst[], const void *src[], uint32_t n_samples)		\
+{											\
+	uint32_t c, i, n_channels = conv->n_channels;					\
+	bool src_planar = CONV_IS_PLANAR(conv->src_fmt);				\
+	bool dst_planar = CONV_IS_PLANAR(conv->dst_fmt);				\
+	uint32_t ss = src_planar ? 1 : n_channels;					\
+	uint32_t ds = dst_planar ? 1 : n_channels;					\
+											\
+	for (c = 0; c < n_channels; c++) {						\
+		const stype *s = src_planar ? src[c] : (const stype *) src[0] + c;	\
+		dtype *d = dst_planar ? dst[c] : (dtype *) dst[0] + c;			\
+											\
+		for (i = 0; i < n_samples; i++)						\
+			d[i * ds] = func(s[i * ss]);					\
+	}										\
+}
+
+MAKE_CONV(conv_u8_to_f32, uint8_t, float, U8_TO_F32)
+MAKE_CONV(conv_s16_to_f32, int16_t, float, S16_TO_F32)
+MAKE_CONV(conv_s24_to_f32, s24_t, float, S24_TO_F32)
+MAKE_CONV(conv_s24_32_to_f32, int32_t, float, S24_32_TO_F32)
+MAKE_CONV(conv_s32_to_f32, int32_t, float, S32_TO_F32)
+MAKE_CONV(conv_f64_to_f32, double, float, F64_TO_F32)
+
+MAKE_CONV(conv_f32_to_u8, float, uint8_t, F32_TO_U8)
+MAKE_CONV(conv_f32_to_s16, float, int16_t, F32_TO_S16)
+MAKE_CONV(conv_f32_to_s24, float, s24_t, F32_TO_S24)
+MAKE_CONV(conv_f32_to_s24_32, float, int32_t, F32_TO_S24_32)
+MAKE_CONV(conv_f32_to_s32, float, int32_t, F32_TO_S32)
+MAKE_CONV(conv_f32_to_f64, float, double, F32_TO_F64)
+
+MAKE_CONV(conv_u8_to_f64, uint8_t, double, U8_TO_F64)
+MAKE_CONV(conv_s16_to_f64, int16_t, double, S16_TO_F64)
+MAKE_CONV(conv_s24_to_f64, s24_t, double, S24_TO_F64)
+MAKE_CONV(conv_s24_32_to_f64, int32_t, double, S24_32_TO_F64)
+MAKE_CONV(conv_s32_to_f64, int32_t, double, S32_TO_F64)
+
+MAKE_CONV(conv_f64_to_u8, double, uint8_t, F64_TO_U8)
+MAKE_CONV(conv_f64_to_s16, double, int16_t, F64_TO_S16)
+MAKE_CONV(conv_f64_to_s24, double, s24_t, F64_TO_S24)
+MAKE_CONV(conv_f64_to_s24_32, double, int32_t, F64_TO_S24_32)
+MAKE_CONV(conv_f64_to_s32, double, int32_t, F64_TO_S32)
+
+/* the same format in another layout */
+MAKE_CONV(conv_copy8, uint8_t, uint8_t, COPY)
+MAKE_CONV(conv_copy16, uint16_t, uint16_t, COPY)
+MAKE_CONV(conv_copy24, s24_t, s24_t, COPY)
+MAKE_CONV(conv_copy32, uint32_t, uint32_t, COPY)
+MAKE_CONV(conv_copy64, uint64_t, uint64_t, COPY)
+
+#define LAYOUT_ANY	0
+#define LAYOUT_SAME	1	/**< both interleaved or both planar */
+
+struct conv_info {
+	uint32_t src_fmt;
+	uint32_t dst_fmt;
+	uint32_t layout;
+	uint32_t cpu_flags;
+	convert_func_t func;
+	const char *name;
+};
+
+#define CONV(s,d,l,f,func)	{ s, d, l, f, func, #func }
+
+/* the direct conversions, the first match is used so the vector versions
+ * go first. Conversions that are not here go through planar F32, or
+ * planar F64 when S32 or F64 is involved */
+static const struct conv_info conv_table[] =
+{
+#if defined(HAVE_SSE2)
+	CONV(CONV_S16, CONV_F32, LAYOUT_SAME, CONV_CPU_FLAG_SSE2, conv_s16_to_f32_sse2),
+	CONV(CONV_F32, CONV_S16, LAYOUT_SAME, CONV_CPU_FLAG_SSE2, conv_f32_to_s16_sse2),
+	CONV(CONV_S32, CONV_F32, LAYOUT_SAME, CONV_CPU_FLAG_SSE2, conv_s32_to_f32_sse2),
+	CONV(CONV_F32, CONV_S32, LAYOUT_SAME, CONV_CPU_FLAG_SSE2, conv_f32_to_s32_sse2),
+#endif
+	CONV(CONV_U8, CONV_F32, LAYOUT_ANY, 0, conv_u8_to_f32),
+	CONV(CONV_S16, CONV_F32, LAYOUT_ANY, 0, conv_s16_to_f32),
+	CONV(CONV_S24, CONV_F32, LAYOUT_ANY, 0, conv_s24_to_f32),
+	CONV(CONV_S24_32, CONV_F32, LAYOUT_ANY, 0, conv_s24_32_to_f32),
+	CONV(CONV_S32, CONV_F32, LAYOUT_ANY, 0, conv_s32_to_f32),
+	CONV(CONV_F64, CONV_F32, LAYOUT_ANY, 0, conv_f64_to_f32),
+
+	CONV(CONV_F32, CONV_U8, LAYOUT_ANY, 0, conv_f32_to_u8),
+	CONV(CONV_F32, CONV_S16, LAYOUT_ANY, 0, conv_f32_to_s16),
+	CONV(CONV_F32, CONV_S24, LAYOUT_ANY, 0, conv_f32_to_s24),
+	CONV(CONV_F32, CONV_S24_32, LAYOUT_ANY, 0, conv_f32_to_s24_32),
+	CONV(CONV_F32, CONV_S32, LAYOUT_ANY, 0, conv_f32_to_s32),
+	CONV(CONV_F32, CONV_F64, LAYOUT_ANY, 0, conv_f32_to_f64),
+
+	CONV(CONV_U8, CONV_F64, LAYOUT_ANY, 0, conv_u8_to_f64),
+	CONV(CONV_S16, CONV_F64, LAYOUT_ANY, 0, conv_s16_to_f64),
+	CONV(CONV_S24, CONV_F64, LAYOUT_ANY, 0, conv_s24_to_f64),
+	CONV(CONV_S24_32, CONV_F64, LAYOUT_ANY, 0, conv_s24_32_to_f64),
+	CONV(CONV_S32, CONV_F64, LAYOUT_ANY, 0, conv_s32_to_f64),
+
+	CONV(CONV_F64, CONV_U8, LAYOUT_ANY, 0, conv_f64_to_u8),
+	CONV(CONV_F64, CONV_S16, LAYOUT_ANY, 0, conv_f64_to_s16),
+	CONV(CONV_F64, CONV_S24, LAYOUT_ANY, 0, conv_f64_to_s24),
+	CONV(CONV_F64, CONV_S24_32, LAYOUT_ANY, 0, conv_f64_to_s24_32),
+	CONV(CONV_F64, CONV_S32, LAYOUT_ANY, 0, conv_f64_to_s32),
+
+	CONV(CONV_U8, CONV_U8, LAYOUT_ANY, 0, conv_copy8),
+	CONV(CONV_S16, CONV_S16, LAYOUT_ANY, 0, conv_copy16),
+	CONV(CONV_S24, CONV_S24, LAYOUT_ANY, 0, conv_copy24),
+	CONV(CONV_S24_32, CONV_S24_32, LAYOUT_ANY, 0, conv_copy32),
+	CONV(CONV_S32, CONV_S32, LAYOUT_ANY, 0, conv_copy32),
+	CONV(CONV_F32, CONV_F32, LAYOUT_ANY, 0, conv_copy32),
+	CONV(CONV_F64, CONV_F64, LAYOUT_ANY, 0, conv_copy64),
+};
+
+static const struct conv_info *
+find_conv_info(uint32_t src_fmt, uint32_t dst_fmt, uint32_t cpu_flags)
+{
+	bool same = CONV_IS_PLANAR(src_fmt) == CONV_IS_PLANAR(dst_fmt);
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(conv_table); i++) {
+		const struct conv_info *info = &conv_table[i];
+
+		if (info->src_fmt == CONV_FORMAT(src_fmt) &&
+		    info->dst_fmt == CONV_FORMAT(dst_fmt) &&
+		    (info->layout == LAYOUT_ANY || same) &&
+		    (info->cpu_flags & cpu_flags) == info->cpu_flags)
+			return info;
+	}
+	return NULL;
+}
+
+/* point \a planes at sample \a offset of \a data */
+static void
+offset_planes(void *planes[], const void *data[], uint32_t fmt, uint32_t n_channels,
+	      uint32_t offset)
+{
+	uint32_t c, size = convert_sample_size(fmt);
+
+	if (CONV_IS_PLANAR(fmt)) {
+		for (c = 0; c < n_channels; c++)
+			planes[c] = SPA_MEMBER(data[c], offset * size, void);
+	} else {
+		planes[0] = SPA_MEMBER(data[0], offset * size * n_channels, void);
+	}
+}
+
+/* convert to the planar intermediate format and from there to the
+ * destination, one chunk at a time so that the samples stay in the cache */
+static void
+conv_two_steps(struct convert *conv, void *dst[], const void *src[], uint32_t n_samples)
+{
+	void *s[CONV_MAX_CHANNELS], *d[CONV_MAX_CHANNELS], *tmp[CONV_MAX_CHANNELS];
+	uint32_t c, i, n, n_channels = conv->n_channels;
+	uint32_t size = convert_sample_size(conv->steps[0].dst_fmt);
+
+	for (c = 0; c < n_channels; c++)
+		tmp[c] = SPA_MEMBER(conv->tmp, c * CONV_CHUNK * size, void);
+
+	for (i = 0; i < n_samples; i += n) {
+		n = SPA_MIN(n_samples - i, CONV_CHUNK);
+
+		offset_planes(s, src, conv->src_fmt, n_channels, i);
+		offset_planes(d, (const void **) dst, conv->dst_fmt, n_channels, i);
+
+		convert_process(&conv->steps[0], tmp, (const void **) s, n);
+		convert_process(&conv->steps[1], d, (const void **) tmp, n);
+	}
+}
+
+uint32_t convert_get_cpu_flags(void)
+{
+	uint32_t flags = 0;
+
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		flags |= CONV_CPU_FLAG_SSE2;
+#endif
+	return flags;
+}
+
+uint32_t convert_sample_size(uint32_t fmt)
+{
+	static const uint32_t sizes[] = {
+		[CONV_U8] = sizeof(uint8_t),
+		[CONV_S16] = sizeof(int16_t),
+		[CONV_S24] = sizeof(s24_t),
+		[CONV_S24_32] = sizeof(int32_t),
+		[CONV_S32] = sizeof(int32_t),
+		[CONV_F32] = sizeof(float),
+		[CONV_F64] = sizeof(double),
+	};
+	return sizes[CONV_FORMAT(fmt)];
+}
+
+static void
+init_step(struct convert *step, uint32_t src_fmt, uint32_t dst_fmt, uint32_t n_channels,
+	  const struct conv_info *info)
+{
+	memset(step, 0, sizeof(*step));
+	step->src_fmt = src_fmt;
+	step->dst_fmt = dst_fmt;
+	step->n_channels = n_channels;
+	step->func = info->func;
+	step->name = info->name;
+}
+
+int convert_init(struct convert *conv, uint32_t src_fmt, uint32_t dst_fmt,
+		 uint32_t n_channels, uint32_t cpu_flags)
+{
+	const struct conv_info *info, *to, *from;
+	uint32_t tmp_fmt = CONV_F32 | CONV_PLANAR;
+
+	if (CONV_FORMAT(src_fmt) >= CONV_MAX || CONV_FORMAT(dst_fmt) >= CONV_MAX ||
+	    n_channels == 0 || n_channels > CONV_MAX_CHANNELS)
+		return -EINVAL;
+
+	/* F32 can't hold all the bits of these */
+	if (CONV_FORMAT(src_fmt) == CONV_S32 || CONV_FORMAT(src_fmt) == CONV_F64 ||
+	    CONV_FORMAT(dst_fmt) == CONV_S32 || CONV_FORMAT(dst_fmt) == CONV_F64)
+		tmp_fmt = CONV_F64 | CONV_PLANAR;
+
+	if ((info = find_conv_info(src_fmt, dst_fmt, cpu_flags)) != NULL) {
+		init_step(conv, src_fmt, dst_fmt, n_channels, info);
+		conv->cpu_flags = cpu_flags;
+		return 0;
+	}
+
+	to = find_conv_info(src_fmt, tmp_fmt, cpu_flags);
+	from = find_conv_info(tmp_fmt, dst_fmt, cpu_flags);
+	if (to == NULL || from == NULL)
+		return -ENOTSUP;
+
+	memset(conv, 0, sizeof(*conv));
+	conv->src_fmt = src_fmt;
+	conv->dst_fmt = dst_fmt;
+	conv->n_channels = n_channels;
+	conv->cpu_flags = cpu_flags;
+	conv->func = conv_two_steps;
+	conv->name = "conv_two_steps";
+
+	conv->steps = calloc(2, sizeof(struct convert));
+	conv->tmp = malloc(n_channels * CONV_CHUNK * convert_sample_size(tmp_fmt));
+	if (conv->steps == NULL || conv->tmp == NULL) {
+		convert_free(conv);
+		return -ENOMEM;
+	}
+	init_step(&conv->steps[0], src_fmt, tmp_fmt, n_channels, to);
+	init_step(&conv->steps[1], tmp_fmt, dst_fmt, n_channels, from);
+
+	return 0;
+}
+
+void convert_free(struct convert *conv)
+{
+	free(conv->steps);
+	free(conv->tmp);
+	conv->steps = NULL;
+	conv->tmp = NULL;
+}
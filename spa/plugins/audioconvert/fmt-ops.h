@@ -0,0 +1,90 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+
+#define CONV_MAX_CHANNELS	64
+
+/* samples of each channel that are converted at a time when the
+ * conversion goes through F32 or F64 */
+#define CONV_CHUNK		256
+
+enum {
+	CONV_U8,
+	CONV_S16,
+	CONV_S24,	/**< packed in 3 bytes */
+	CONV_S24_32,	/**< 24 bits in the lower bits of 32 */
+	CONV_S32,
+	CONV_F32,
+	CONV_F64,
+	CONV_MAX,
+};
+
+/** added to the CONV_ format for non-interleaved audio */
+#define CONV_PLANAR		(1 << 8)
+#define CONV_FORMAT(f)		((f) & ~CONV_PLANAR)
+#define CONV_IS_PLANAR(f)	(((f) & CONV_PLANAR) != 0)
+
+#define CONV_CPU_FLAG_SSE2	(1 << 0)
+
+struct convert;
+
+/** convert \a n_samples of each channel, \a src and \a dst have one pointer
+ * for each plane, interleaved audio has one plane */
+typedef void (*convert_func_t) (struct convert *conv, void *dst[], const void *src[],
+				uint32_t n_samples);
+
+struct convert {
+	uint32_t src_fmt;		/**< CONV_ format with CONV_PLANAR */
+	uint32_t dst_fmt;
+	uint32_t n_channels;
+	uint32_t cpu_flags;
+
+	convert_func_t func;
+	const char *name;		/**< of the conversion, for debugging */
+
+	/* when there is no direct conversion, the steps to planar F32 or F64
+	 * and from there to the destination */
+	struct convert *steps;
+	void *tmp;			/**< CONV_CHUNK samples for each channel */
+};
+
+/** The CONV_CPU_FLAG_ of the cpu we run on */
+uint32_t convert_get_cpu_flags(void);
+
+/** Bytes of one sample of the CONV_ format \a fmt */
+uint32_t convert_sample_size(uint32_t fmt);
+
+/** Set up \a conv to go from \a src_fmt to \a dst_fmt with the fastest
+ * functions for \a cpu_flags, 0 gives the C versions */
+int convert_init(struct convert *conv, uint32_t src_fmt, uint32_t dst_fmt,
+		 uint32_t n_channels, uint32_t cpu_flags);
+
+void convert_free(struct convert *conv);
+
+#define convert_process(conv,dst,src,n_samples)	(conv)->func(conv, dst, src, n_samples)
+
+/* the vector versions, used from the table of fmt-ops.c */
+void conv_s16_to_f32_sse2(struct convert *conv, void *dst[], const void *src[], uint32_t n_samples);
+void conv_f32_to_s16_sse2(struct convert *conv, void *dst[], const void *src[], uint32_t n_samples);
+void conv_s32_to_f32_sse2(struct convert *conv, void *dst[], const void *src[], uint32_t n_samples);
+void conv_f32_to_s32_sse2(struct convert *conv, void *dst[], const void *src[], uint32_t n_samples);
@@ -40,6 +40,10 @@
 #define MAX_BUFFERS     64
 #define MAX_PORTS       128
 
+/* bytes of output that are mixed with all the inputs at a time, small
+ * enough to stay in the cache while the inputs are added */
+#define MIX_BLOCK	4096
+
 #define PORT_DEFAULT_VOLUME	1.0
 #define PORT_DEFAULT_MUTE	false
 
@@ -84,6 +88,18 @@ struct port {
 	size_t queued_bytes;
 };
 
+/* the queued data of an input port that goes in the current output */
+struct mix_input {
+	struct port *port;
+	struct buffer *buffer;
+	struct spa_data *datas;	/**< one for each plane */
+	uint32_t maxsize;
+	uint32_t offset;	/**< offset of the first byte in the datas */
+	uint32_t size;		/**< bytes to mix */
+	double volume;
+	bool scale;		/**< volume needs to be applied */
+};
+
 struct type {
 	uint32_t node;
 	uint32_t format;
@@ -148,7 +164,8 @@ struct impl {
 	bool have_format;
 	int n_formats;
 	struct spa_audio_info format;
-	uint32_t bpf;
+	uint32_t bpf;		/**< bytes per frame in one plane */
+	uint32_t n_planes;	/**< channels when non-interleaved, else 1 */
 
 	mix_clear_func_t clear;
 	mix_func_t copy;
@@ -156,6 +173,8 @@ struct impl {
 	mix_scale_func_t copy_scale;
 	mix_scale_func_t add_scale;
 
+	struct mix_input inputs[MAX_PORTS];
+
 	bool started;
 };
 
@@ -376,6 +395,7 @@ static int port_enum_formats(struct spa_node *node,
 				"I", t->media_type.audio,
 				"I", t->media_subtype.raw,
 				":", t->format_audio.format,   "I", this->format.info.raw.format,
+				":", t->format_audio.layout,   "i", this->format.info.raw.layout,
 				":", t->format_audio.rate,     "i", this->format.info.raw.rate,
 				":", t->format_audio.channels, "i", this->format.info.raw.channels);
 		} else {
@@ -384,8 +404,14 @@ static int port_enum_formats(struct spa_node *node,
 				"I", t->media_type.audio,
 				"I", t->media_subtype.raw,
 				":", t->format_audio.format,   "Ieu", t->audio_format.S16,
-									2, t->audio_format.S16,
+									5, t->audio_format.S16,
 									   t->audio_format.F32,
+									   t->audio_format.S24_32,
+									   t->audio_format.S32,
+									   t->audio_format.F64,
+				":", t->format_audio.layout,   "ieu", SPA_AUDIO_LAYOUT_INTERLEAVED,
+									2, SPA_AUDIO_LAYOUT_INTERLEAVED,
+									   SPA_AUDIO_LAYOUT_NON_INTERLEAVED,
 				":", t->format_audio.rate,     "iru", 44100,
 									2, 1, INT32_MAX,
 				":", t->format_audio.channels, "iru", 2,
@@ -418,6 +444,7 @@ static int port_get_format(struct spa_node *node,
 		"I", t->media_type.audio,
 		"I", t->media_subtype.raw,
 		":", t->format_audio.format,   "I", this->format.info.raw.format,
+		":", t->format_audio.layout,   "i", this->format.info.raw.layout,
 		":", t->format_audio.rate,     "i", this->format.info.raw.rate,
 		":", t->format_audio.channels, "i", this->format.info.raw.channels);
 
@@ -617,25 +644,50 @@ static int port_set_format(struct spa_node *node,
 			if (memcmp(&info, &this->format, sizeof(struct spa_audio_info)))
 				return -EINVAL;
 		} else {
+			uint32_t fmt, sample_size;
+
 			if (info.info.raw.format == t->audio_format.S16) {
-				this->clear = this->ops.clear[FMT_S16];
-				this->copy = this->ops.copy[FMT_S16];
-				this->add = this->ops.add[FMT_S16];
-				this->copy_scale = this->ops.copy_scale[FMT_S16];
-				this->add_scale = this->ops.add_scale[FMT_S16];
-				this->bpf = sizeof(int16_t) * info.info.raw.channels;
+				fmt = FMT_S16;
+				sample_size = sizeof(int16_t);
 			}
 			else if (info.info.raw.format == t->audio_format.F32) {
-				this->clear = this->ops.clear[FMT_F32];
-				this->copy = this->ops.copy[FMT_F32];
-				this->add = this->ops.add[FMT_F32];
-				this->copy_scale = this->ops.copy_scale[FMT_F32];
-				this->add_scale = this->ops.add_scale[FMT_F32];
-				this->bpf = sizeof(float) * info.info.raw.channels;
+				fmt = FMT_F32;
+				sample_size = sizeof(float);
+			}
+			else if (info.info.raw.format == t->audio_format.S24_32) {
+				fmt = FMT_S24_32;
+				sample_size = sizeof(int32_t);
+			}
+			else if (info.info.raw.format == t->audio_format.S32) {
+				fmt = FMT_S32;
+				sample_size = sizeof(int32_t);
+			}
+			else if (info.info.raw.format == t->audio_format.F64) {
+				fmt = FMT_F64;
+				sample_size = sizeof(double);
 			}
 			else
 				return -EINVAL;
 
+			if (info.info.raw.channels == 0)
+				return -EINVAL;
+
+			this->clear = this->ops.clear[fmt];
+			this->copy = this->ops.copy[fmt];
+			this->add = this->ops.add[fmt];
+			this->copy_scale = this->ops.copy_scale[fmt];
+			this->add_scale = this->ops.add_scale[fmt];
+
+			/* every plane of non-interleaved audio is mixed as a
+			 * mono stream */
+			if (info.info.raw.layout == SPA_AUDIO_LAYOUT_NON_INTERLEAVED) {
+				this->n_planes = info.info.raw.channels;
+				this->bpf = sample_size;
+			} else {
+				this->n_planes = 1;
+				this->bpf = sample_size * info.info.raw.channels;
+			}
+
 			this->have_format = true;
 			this->format = info;
 		}
@@ -703,18 +755,27 @@ impl_node_port_use_buffers(struct spa_node *node,
 	for (i = 0; i < n_buffers; i++) {
 		struct buffer *b;
 		struct spa_data *d = buffers[i]->datas;
+		uint32_t j;
+
+		if (buffers[i]->n_datas < this->n_planes) {
+			spa_log_error(this->log, NAME " %p: buffer %p has %u datas, need %u",
+				      this, buffers[i], buffers[i]->n_datas, this->n_planes);
+			return -EINVAL;
+		}
 
 		b = &port->buffers[i];
 		b->outbuf = buffers[i];
 		b->outstanding = (direction == SPA_DIRECTION_INPUT);
 		b->h = spa_buffer_find_meta(buffers[i], t->meta.Header);
 
-		if (!((d[0].type == t->data.MemPtr ||
-		       d[0].type == t->data.MemFd ||
-		       d[0].type == t->data.DmaBuf) && d[0].data != NULL)) {
-			spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
-				      buffers[i]);
-			return -EINVAL;
+		for (j = 0; j < this->n_planes; j++) {
+			if (!((d[j].type == t->data.MemPtr ||
+			       d[j].type == t->data.MemFd ||
+			       d[j].type == t->data.DmaBuf) && d[j].data != NULL)) {
+				spa_log_error(this->log, NAME " %p: invalid memory on buffer %p",
+					      this, buffers[i]);
+				return -EINVAL;
+			}
 		}
 		if (!b->outstanding)
 			spa_list_append(&port->queue, &b->link);
@@ -817,74 +878,115 @@ impl_node_port_send_command(struct spa_node *node,
 	return -ENOTSUP;
 }
 
-static inline void
-add_port_data(struct impl *this, void *out, size_t outsize, struct port *port, int layer)
+/* collect the data that \a port has for \a n_bytes of output, returns
+ * false when the port is silent */
+static bool
+get_input(struct impl *this, struct port *port, size_t n_bytes, struct mix_input *in)
 {
-	size_t insize;
 	struct buffer *b;
-	uint32_t index, offset, len1, len2, maxsize;
 	struct spa_data *d;
-	void *data;
+	uint32_t insize;
 	double volume = *port->io_volume;
-	bool mute = *port->io_mute;
 
 	b = spa_list_first(&port->queue, struct buffer, link);
-
 	d = b->outbuf->datas;
 
-	maxsize = d[0].maxsize;
-	data = d[0].data;
-
-	insize = SPA_MIN(d[0].chunk->size, maxsize);
-	outsize = SPA_MIN(outsize, insize);
+	in->port = port;
+	in->buffer = b;
+	in->datas = d;
+	in->maxsize = d[0].maxsize;
 
-	index = d[0].chunk->offset + (insize - port->queued_bytes);
-	offset = index % maxsize;
-
-	len1 = SPA_MIN(outsize, maxsize - offset);
-	len2 = outsize - len1;
-
-	if (volume < 0.001 || mute) {
-		/* silence, for the first layer clear, otherwise do nothing */
-		if (layer == 0) {
-			this->clear(out, len1);
-			if (len2 > 0)
-				this->clear(out + len1, len2);
-		}
-	}
-	else if (volume < 0.999 || volume > 1.001) {
-		mix_scale_func_t mix = layer == 0 ? this->copy_scale : this->add_scale;
+	insize = SPA_MIN(d[0].chunk->size, d[0].maxsize);
+	in->offset = (d[0].chunk->offset + (insize - port->queued_bytes)) % in->maxsize;
+	in->size = SPA_MIN(n_bytes, port->queued_bytes);
+	in->volume = volume;
+	in->scale = volume < 0.999 || volume > 1.001;
 
-		mix(out, SPA_MEMBER(data, offset, void), volume, len1);
-		if (len2 > 0)
-			mix(out + len1, data, volume, len2);
-	}
-	else {
-		mix_func_t mix = layer == 0 ? this->copy : this->add;
+	return !(volume < 0.001 || *port->io_mute);
+}
 
-		mix(out, SPA_MEMBER(data, offset, void), len1);
-		if (len2 > 0)
-			mix(out + len1, data, len2);
-	}
+static void consume_input(struct impl *this, struct mix_input *in)
+{
+	struct port *port = in->port;
+	struct buffer *b = in->buffer;
 
-	port->queued_bytes -= outsize;
+	port->queued_bytes -= in->size;
 
 	if (port->queued_bytes == 0) {
-		spa_log_trace(this->log, NAME " %p: return buffer %d on port %p %zd",
-			      this, b->outbuf->id, port, outsize);
+		spa_log_trace(this->log, NAME " %p: return buffer %d on port %p %u",
+			      this, b->outbuf->id, port, in->size);
 		port->io->buffer_id = b->outbuf->id;
 		spa_list_remove(&b->link);
 		b->outstanding = true;
 	} else {
-		spa_log_trace(this->log, NAME " %p: keeping buffer %d on port %p %zd %zd",
-			      this, b->outbuf->id, port, port->queued_bytes, outsize);
+		spa_log_trace(this->log, NAME " %p: keeping buffer %d on port %p %zd %u",
+			      this, b->outbuf->id, port, port->queued_bytes, in->size);
+	}
+}
+
+/* mix \a len bytes of \a plane of \a in, starting at byte \a pos of the output */
+static inline void
+mix_input(struct impl *this, void *out, struct mix_input *in, uint32_t plane,
+	  uint32_t pos, uint32_t len, bool first)
+{
+	uint32_t offset, len1;
+	const void *base, *data;
+
+	base = in->datas[plane].data;
+	offset = (in->offset + pos) % in->maxsize;
+	data = SPA_MEMBER(base, offset, void);
+	len1 = SPA_MIN(len, in->maxsize - offset);
+
+	if (in->scale) {
+		mix_scale_func_t mix = first ? this->copy_scale : this->add_scale;
+
+		mix(out, data, in->volume, len1);
+		if (len1 < len)
+			mix(out + len1, base, in->volume, len - len1);
+	} else {
+		mix_func_t mix = first ? this->copy : this->add;
+
+		mix(out, data, len1);
+		if (len1 < len)
+			mix(out + len1, base, len - len1);
+	}
+}
+
+/* mix \a plane of all the inputs into \a len bytes of output, one block at
+ * a time so that the output is only read and written from the cache */
+static void
+mix_inputs(struct impl *this, void *out, uint32_t plane, uint32_t pos, uint32_t len,
+	   struct mix_input *inputs, uint32_t n_inputs)
+{
+	uint32_t i, block, blen, l;
+	bool first;
+
+	for (block = 0; block < len; block += blen) {
+		blen = SPA_MIN(len - block, MIX_BLOCK);
+
+		for (first = true, i = 0; i < n_inputs; i++) {
+			struct mix_input *in = &inputs[i];
+
+			if (pos + block >= in->size)
+				continue;
+
+			l = SPA_MIN(blen, in->size - (pos + block));
+			if (first && l < blen)
+				this->clear(out + block + l, blen - l);
+
+			mix_input(this, out + block, in, plane, pos + block, l, first);
+			first = false;
+		}
+		if (first)
+			this->clear(out + block, blen);
 	}
 }
 
 static int mix_output(struct impl *this, size_t n_bytes)
 {
 	struct buffer *outbuf;
-	int i, layer;
+	int i;
+	uint32_t n_inputs, n_mix, p;
 	struct port *outport;
 	struct spa_io_buffers *outio;
 	struct spa_data *od;
@@ -916,8 +1018,12 @@ static int mix_output(struct impl *this, size_t n_bytes)
 	spa_log_trace(this->log, NAME " %p: dequeue output buffer %d %zd %d %d %d",
 		      this, outbuf->outbuf->id, n_bytes, offset, len1, len2);
 
-	for (layer = 0, i = 0; i < this->last_port; i++) {
+	/* gather the inputs, the silent ones are consumed but not mixed and
+	 * are kept at the end of the array */
+	n_inputs = n_mix = 0;
+	for (i = 0; i < this->last_port; i++) {
 		struct port *in_port = GET_IN_PORT(this, i);
+		struct mix_input in;
 
 		if (in_port->io == NULL || in_port->n_buffers == 0)
 			continue;
@@ -927,15 +1033,29 @@ static int mix_output(struct impl *this, size_t n_bytes)
 			continue;
 		}
 
-		add_port_data(this, SPA_MEMBER(od[0].data, offset, void), len1, in_port, layer);
+		if (get_input(this, in_port, n_bytes, &in)) {
+			if (n_mix < n_inputs)
+				this->inputs[n_inputs] = this->inputs[n_mix];
+			this->inputs[n_mix++] = in;
+		} else {
+			this->inputs[n_inputs] = in;
+		}
+		n_inputs++;
+	}
+
+	for (p = 0; p < this->n_planes; p++) {
+		mix_inputs(this, SPA_MEMBER(od[p].data, offset, void), p, 0, len1,
+			   this->inputs, n_mix);
 		if (len2 > 0)
-			add_port_data(this, od[0].data, len2, in_port, layer);
-		layer++;
+			mix_inputs(this, od[p].data, p, len1, len2, this->inputs, n_mix);
+
+		od[p].chunk->offset = index;
+		od[p].chunk->size = n_bytes;
+		od[p].chunk->stride = 0;
 	}
 
-	od[0].chunk->offset = index;
-	od[0].chunk->size = n_bytes;
-	od[0].chunk->stride = 0;
+	for (i = 0; i < n_inputs; i++)
+		consume_input(this, &this->inputs[i]);
 
 	outio->buffer_id = outbuf->outbuf->id;
 	outio->status = SPA_STATUS_HAVE_BUFFER;
@@ -1147,7 +1267,7 @@ impl_init(const struct spa_handle_factory *factory,
 	    SPA_PORT_INFO_FLAG_NO_REF;
 	spa_list_init(&port->queue);
 
-	spa_audiomixer_get_ops(&this->ops);
+	spa_audiomixer_get_ops(&this->ops, spa_audiomixer_get_cpu_flags());
 
 	return 0;
 }
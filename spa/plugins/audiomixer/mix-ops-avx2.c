@@ -0,0 +1,185 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <pthread.h>
+#include <immintrin.h>
+
+#include "mix-ops.h"
+
+static struct spa_audiomixer_ops fallback;
+static pthread_once_t fallback_once = PTHREAD_ONCE_INIT;
+
+static void init_fallback(void)
+{
+	spa_audiomixer_get_ops(&fallback, 0);
+}
+
+/* like the SSE2 version, the unpack and pack work on each 128 bits lane so
+ * the samples stay in order */
+static inline void
+mul_s16(__m256i s, __m256i v, __m256i *p0, __m256i *p1)
+{
+	__m256i lo = _mm256_mullo_epi16(s, v), hi = _mm256_mulhi_epi16(s, v);
+
+	*p0 = _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 11);
+	*p1 = _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 11);
+}
+
+static void
+add_s16_avx2(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t t;
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		__m256i in = _mm256_loadu_si256((const __m256i *) &s[n]);
+		__m256i out = _mm256_loadu_si256((const __m256i *) &d[n]);
+		_mm256_storeu_si256((__m256i *) &d[n], _mm256_adds_epi16(out, in));
+	}
+	for (; n < n_samples; n++) {
+		t = d[n] + s[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_f32_avx2(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		_mm256_storeu_ps(&d[n], _mm256_add_ps(_mm256_loadu_ps(&d[n]),
+						      _mm256_loadu_ps(&s[n])));
+	for (; n < n_samples; n++)
+		d[n] += s[n];
+}
+
+static void
+copy_scale_s16_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t v = scale * (1 << 11), t;
+	__m256i vv, p0, p1;
+
+	if (v < INT16_MIN || v > INT16_MAX) {
+		fallback.copy_scale[FMT_S16](dst, src, scale, n_bytes);
+		return;
+	}
+	vv = _mm256_set1_epi16(v);
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		mul_s16(_mm256_loadu_si256((const __m256i *) &s[n]), vv, &p0, &p1);
+		_mm256_storeu_si256((__m256i *) &d[n], _mm256_packs_epi32(p0, p1));
+	}
+	for (; n < n_samples; n++) {
+		t = (s[n] * v) >> 11;
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+copy_scale_f32_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = scale;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m256 vv = _mm256_set1_ps(v);
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		_mm256_storeu_ps(&d[n], _mm256_mul_ps(_mm256_loadu_ps(&s[n]), vv));
+	for (; n < n_samples; n++)
+		d[n] = s[n] * v;
+}
+
+static void
+add_scale_s16_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t v = scale * (1 << 11), t;
+	__m256i vv, p0, p1, out;
+
+	if (v < INT16_MIN || v > INT16_MAX) {
+		fallback.add_scale[FMT_S16](dst, src, scale, n_bytes);
+		return;
+	}
+	vv = _mm256_set1_epi16(v);
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		mul_s16(_mm256_loadu_si256((const __m256i *) &s[n]), vv, &p0, &p1);
+		out = _mm256_loadu_si256((const __m256i *) &d[n]);
+		p0 = _mm256_add_epi32(p0, _mm256_srai_epi32(_mm256_unpacklo_epi16(out, out), 16));
+		p1 = _mm256_add_epi32(p1, _mm256_srai_epi32(_mm256_unpackhi_epi16(out, out), 16));
+		_mm256_storeu_si256((__m256i *) &d[n], _mm256_packs_epi32(p0, p1));
+	}
+	for (; n < n_samples; n++) {
+		t = d[n] + ((s[n] * v) >> 11);
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+/* no FMA, the results are the same as the C version */
+static void
+add_scale_f32_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = scale;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m256 vv = _mm256_set1_ps(v);
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		_mm256_storeu_ps(&d[n], _mm256_add_ps(_mm256_loadu_ps(&d[n]),
+						      _mm256_mul_ps(_mm256_loadu_ps(&s[n]), vv)));
+	for (; n < n_samples; n++)
+		d[n] += s[n] * v;
+}
+
+MIX_I(add_s16_i_avx2, add_s16_avx2, add_i, FMT_S16)
+MIX_I(add_f32_i_avx2, add_f32_avx2, add_i, FMT_F32)
+MIX_SCALE_I(copy_scale_s16_i_avx2, copy_scale_s16_avx2, copy_scale_i, FMT_S16)
+MIX_SCALE_I(copy_scale_f32_i_avx2, copy_scale_f32_avx2, copy_scale_i, FMT_F32)
+MIX_SCALE_I(add_scale_s16_i_avx2, add_scale_s16_avx2, add_scale_i, FMT_S16)
+MIX_SCALE_I(add_scale_f32_i_avx2, add_scale_f32_avx2, add_scale_i, FMT_F32)
+
+void spa_audiomixer_init_ops_avx2(struct spa_audiomixer_ops *ops)
+{
+	pthread_once(&fallback_once, init_fallback);
+
+	ops->add[FMT_S16] = add_s16_avx2;
+	ops->add[FMT_F32] = add_f32_avx2;
+	ops->copy_scale[FMT_S16] = copy_scale_s16_avx2;
+	ops->copy_scale[FMT_F32] = copy_scale_f32_avx2;
+	ops->add_scale[FMT_S16] = add_scale_s16_avx2;
+	ops->add_scale[FMT_F32] = add_scale_f32_avx2;
+	ops->add_i[FMT_S16] = add_s16_i_avx2;
+	ops->add_i[FMT_F32] = add_f32_i_avx2;
+	ops->copy_scale_i[FMT_S16] = copy_scale_s16_i_avx2;
+	ops->copy_scale_i[FMT_F32] = copy_scale_f32_i_avx2;
+	ops->add_scale_i[FMT_S16] = add_scale_s16_i_avx2;
+	ops->add_scale_i[FMT_F32] = add_scale_f32_i_avx2;
+}
@@ -0,0 +1,185 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <pthread.h>
+#include <emmintrin.h>
+
+#include "mix-ops.h"
+
+/* the C ops, used for the strides we don't handle. They are filled once
+ * and only read after that, the data threads of the mixers use them */
+static struct spa_audiomixer_ops fallback;
+static pthread_once_t fallback_once = PTHREAD_ONCE_INIT;
+
+static void init_fallback(void)
+{
+	spa_audiomixer_get_ops(&fallback, 0);
+}
+
+/* (s * v) >> 11 of 8 samples as two vectors of 32 bits */
+static inline void
+mul_s16(__m128i s, __m128i v, __m128i *p0, __m128i *p1)
+{
+	__m128i lo = _mm_mullo_epi16(s, v), hi = _mm_mulhi_epi16(s, v);
+
+	*p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 11);
+	*p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 11);
+}
+
+static void
+add_s16_sse2(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t t;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m128i in = _mm_loadu_si128((const __m128i *) &s[n]);
+		__m128i out = _mm_loadu_si128((const __m128i *) &d[n]);
+		_mm_storeu_si128((__m128i *) &d[n], _mm_adds_epi16(out, in));
+	}
+	for (; n < n_samples; n++) {
+		t = d[n] + s[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_f32_sse2(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		_mm_storeu_ps(&d[n], _mm_add_ps(_mm_loadu_ps(&d[n]), _mm_loadu_ps(&s[n])));
+	for (; n < n_samples; n++)
+		d[n] += s[n];
+}
+
+static void
+copy_scale_s16_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t v = scale * (1 << 11), t;
+	__m128i vv, p0, p1;
+
+	/* the products are made of 16 bit factors */
+	if (v < INT16_MIN || v > INT16_MAX) {
+		fallback.copy_scale[FMT_S16](dst, src, scale, n_bytes);
+		return;
+	}
+	vv = _mm_set1_epi16(v);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		mul_s16(_mm_loadu_si128((const __m128i *) &s[n]), vv, &p0, &p1);
+		_mm_storeu_si128((__m128i *) &d[n], _mm_packs_epi32(p0, p1));
+	}
+	for (; n < n_samples; n++) {
+		t = (s[n] * v) >> 11;
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+copy_scale_f32_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = scale;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m128 vv = _mm_set1_ps(v);
+
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		_mm_storeu_ps(&d[n], _mm_mul_ps(_mm_loadu_ps(&s[n]), vv));
+	for (; n < n_samples; n++)
+		d[n] = s[n] * v;
+}
+
+static void
+add_scale_s16_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t v = scale * (1 << 11), t;
+	__m128i vv, p0, p1, out;
+
+	if (v < INT16_MIN || v > INT16_MAX) {
+		fallback.add_scale[FMT_S16](dst, src, scale, n_bytes);
+		return;
+	}
+	vv = _mm_set1_epi16(v);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		mul_s16(_mm_loadu_si128((const __m128i *) &s[n]), vv, &p0, &p1);
+		out = _mm_loadu_si128((const __m128i *) &d[n]);
+		p0 = _mm_add_epi32(p0, _mm_srai_epi32(_mm_unpacklo_epi16(out, out), 16));
+		p1 = _mm_add_epi32(p1, _mm_srai_epi32(_mm_unpackhi_epi16(out, out), 16));
+		_mm_storeu_si128((__m128i *) &d[n], _mm_packs_epi32(p0, p1));
+	}
+	for (; n < n_samples; n++) {
+		t = d[n] + ((s[n] * v) >> 11);
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_scale_f32_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = scale;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m128 vv = _mm_set1_ps(v);
+
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		_mm_storeu_ps(&d[n], _mm_add_ps(_mm_loadu_ps(&d[n]),
+						_mm_mul_ps(_mm_loadu_ps(&s[n]), vv)));
+	for (; n < n_samples; n++)
+		d[n] += s[n] * v;
+}
+
+MIX_I(add_s16_i_sse2, add_s16_sse2, add_i, FMT_S16)
+MIX_I(add_f32_i_sse2, add_f32_sse2, add_i, FMT_F32)
+MIX_SCALE_I(copy_scale_s16_i_sse2, copy_scale_s16_sse2, copy_scale_i, FMT_S16)
+MIX_SCALE_I(copy_scale_f32_i_sse2, copy_scale_f32_sse2, copy_scale_i, FMT_F32)
+MIX_SCALE_I(add_scale_s16_i_sse2, add_scale_s16_sse2, add_scale_i, FMT_S16)
+MIX_SCALE_I(add_scale_f32_i_sse2, add_scale_f32_sse2, add_scale_i, FMT_F32)
+
+void spa_audiomixer_init_ops_sse2(struct spa_audiomixer_ops *ops)
+{
+	pthread_once(&fallback_once, init_fallback);
+
+	ops->add[FMT_S16] = add_s16_sse2;
+	ops->add[FMT_F32] = add_f32_sse2;
+	ops->copy_scale[FMT_S16] = copy_scale_s16_sse2;
+	ops->copy_scale[FMT_F32] = copy_scale_f32_sse2;
+	ops->add_scale[FMT_S16] = add_scale_s16_sse2;
+	ops->add_scale[FMT_F32] = add_scale_f32_sse2;
+	ops->add_i[FMT_S16] = add_s16_i_sse2;
+	ops->add_i[FMT_F32] = add_f32_i_sse2;
+	ops->copy_scale_i[FMT_S16] = copy_scale_s16_i_sse2;
+	ops->copy_scale_i[FMT_F32] = copy_scale_f32_i_sse2;
+	ops->add_scale_i[FMT_S16] = add_scale_s16_i_sse2;
+	ops->add_scale_i[FMT_F32] = add_scale_f32_i_sse2;
+}
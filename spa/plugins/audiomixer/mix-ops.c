@@ -19,6 +19,16 @@
 
 #include "mix-ops.h"
 
+#define S24_MIN	(-8388608)
+#define S24_MAX	8388607
+
+/* S24_32 samples carry 24 significant bits in the low bits of a 32 bit word,
+ * the upper byte is not guaranteed to hold the sign */
+static inline int32_t s24_32_extend(int32_t v)
+{
+	return (int32_t) ((uint32_t) v << 8) >> 8;
+}
+
 static void
 clear_s16(void *dst, int n_bytes)
 {
@@ -255,24 +265,435 @@ add_scale_f32_i(void *dst, int dst_stride, const void *src, int src_stride, cons
 	}
 }
 
-void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops)
+static void
+clear_s24_32(void *dst, int n_bytes)
+{
+	memset(dst, 0, n_bytes);
+}
+
+static void
+copy_s24_32(void *dst, const void *src, int n_bytes)
+{
+	memcpy(dst, src, n_bytes);
+}
+
+static void
+clear_s32(void *dst, int n_bytes)
+{
+	memset(dst, 0, n_bytes);
+}
+
+static void
+copy_s32(void *dst, const void *src, int n_bytes)
+{
+	memcpy(dst, src, n_bytes);
+}
+
+static void
+clear_f64(void *dst, int n_bytes)
+{
+	memset(dst, 0, n_bytes);
+}
+
+static void
+copy_f64(void *dst, const void *src, int n_bytes)
+{
+	memcpy(dst, src, n_bytes);
+}
+
+static void
+add_s24_32(void *dst, const void *src, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (int64_t) s24_32_extend(*d) + s24_32_extend(*s);
+		*d = SPA_CLAMP(t, S24_MIN, S24_MAX);
+		d++;
+		s++;
+	}
+}
+
+static void
+add_s32(void *dst, const void *src, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (int64_t) *d + *s;
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d++;
+		s++;
+	}
+}
+
+static void
+add_f64(void *dst, const void *src, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d += *s;
+		d++;
+		s++;
+	}
+}
+
+static void
+copy_scale_s24_32(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 11), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (s24_32_extend(*s) * v) >> 11;
+		*d = SPA_CLAMP(t, S24_MIN, S24_MAX);
+		d++;
+		s++;
+	}
+}
+
+static void
+copy_scale_s32(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 11), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (*s * v) >> 11;
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d++;
+		s++;
+	}
+}
+
+static void
+copy_scale_f64(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	double v = scale;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d = *s * v;
+		d++;
+		s++;
+	}
+}
+
+static void
+add_scale_s24_32(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 11), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = s24_32_extend(*d) + ((s24_32_extend(*s) * v) >> 11);
+		*d = SPA_CLAMP(t, S24_MIN, S24_MAX);
+		d++;
+		s++;
+	}
+}
+
+static void
+add_scale_s32(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 11), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = *d + ((*s * v) >> 11);
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d++;
+		s++;
+	}
+}
+
+static void
+add_scale_f64(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	double v = scale;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d += *s * v;
+		d++;
+		s++;
+	}
+}
+
+static void
+copy_s24_32_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		*d = *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+copy_s32_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		*d = *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+copy_f64_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d = *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+add_s24_32_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (int64_t) s24_32_extend(*d) + s24_32_extend(*s);
+		*d = SPA_CLAMP(t, S24_MIN, S24_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+add_s32_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (int64_t) *d + *s;
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+add_f64_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d += *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+copy_scale_s24_32_i(void *dst, int dst_stride, const void *src, int src_stride, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 11), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (s24_32_extend(*s) * v) >> 11;
+		*d = SPA_CLAMP(t, S24_MIN, S24_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+copy_scale_s32_i(void *dst, int dst_stride, const void *src, int src_stride, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 11), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (*s * v) >> 11;
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+copy_scale_f64_i(void *dst, int dst_stride, const void *src, int src_stride, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	double v = scale;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d = *s * v;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+add_scale_s24_32_i(void *dst, int dst_stride, const void *src, int src_stride, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 11), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = s24_32_extend(*d) + ((s24_32_extend(*s) * v) >> 11);
+		*d = SPA_CLAMP(t, S24_MIN, S24_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+add_scale_s32_i(void *dst, int dst_stride, const void *src, int src_stride, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 11), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = *d + ((*s * v) >> 11);
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+add_scale_f64_i(void *dst, int dst_stride, const void *src, int src_stride, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	double v = scale;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d += *s * v;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+uint32_t spa_audiomixer_get_cpu_flags(void)
+{
+	uint32_t flags = 0;
+
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		flags |= MIX_CPU_FLAG_SSE2;
+	if (__builtin_cpu_supports("avx2"))
+		flags |= MIX_CPU_FLAG_AVX2;
+#endif
+	return flags;
+}
+
+void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops, uint32_t cpu_flags)
 {
 	ops->clear[FMT_S16] = clear_s16;
 	ops->clear[FMT_F32] = clear_f32;
 	ops->copy[FMT_S16] = copy_s16;
 	ops->copy[FMT_F32] = copy_f32;
-        ops->add[FMT_S16] = add_s16;
-        ops->add[FMT_F32] = add_f32;
-        ops->copy_scale[FMT_S16] = copy_scale_s16;
-        ops->copy_scale[FMT_F32] = copy_scale_f32;
-        ops->add_scale[FMT_S16] = add_scale_s16;
-        ops->add_scale[FMT_F32] = add_scale_f32;
-        ops->copy_i[FMT_S16] = copy_s16_i;
-        ops->copy_i[FMT_F32] = copy_f32_i;
-        ops->add_i[FMT_S16] = add_s16_i;
-        ops->add_i[FMT_F32] = add_f32_i;
-        ops->copy_scale_i[FMT_S16] = copy_scale_s16_i;
-        ops->copy_scale_i[FMT_F32] = copy_scale_f32_i;
-        ops->add_scale_i[FMT_S16] = add_scale_s16_i;
-        ops->add_scale_i[FMT_F32] = add_scale_f32_i;
+	ops->add[FMT_S16] = add_s16;
+	ops->add[FMT_F32] = add_f32;
+	ops->copy_scale[FMT_S16] = copy_scale_s16;
+	ops->copy_scale[FMT_F32] = copy_scale_f32;
+	ops->add_scale[FMT_S16] = add_scale_s16;
+	ops->add_scale[FMT_F32] = add_scale_f32;
+	ops->copy_i[FMT_S16] = copy_s16_i;
+	ops->copy_i[FMT_F32] = copy_f32_i;
+	ops->add_i[FMT_S16] = add_s16_i;
+	ops->add_i[FMT_F32] = add_f32_i;
+	ops->copy_scale_i[FMT_S16] = copy_scale_s16_i;
+	ops->copy_scale_i[FMT_F32] = copy_scale_f32_i;
+	ops->add_scale_i[FMT_S16] = add_scale_s16_i;
+	ops->add_scale_i[FMT_F32] = add_scale_f32_i;
+
+	ops->clear[FMT_S24_32] = clear_s24_32;
+	ops->clear[FMT_S32] = clear_s32;
+	ops->clear[FMT_F64] = clear_f64;
+	ops->copy[FMT_S24_32] = copy_s24_32;
+	ops->copy[FMT_S32] = copy_s32;
+	ops->copy[FMT_F64] = copy_f64;
+	ops->add[FMT_S24_32] = add_s24_32;
+	ops->add[FMT_S32] = add_s32;
+	ops->add[FMT_F64] = add_f64;
+	ops->copy_scale[FMT_S24_32] = copy_scale_s24_32;
+	ops->copy_scale[FMT_S32] = copy_scale_s32;
+	ops->copy_scale[FMT_F64] = copy_scale_f64;
+	ops->add_scale[FMT_S24_32] = add_scale_s24_32;
+	ops->add_scale[FMT_S32] = add_scale_s32;
+	ops->add_scale[FMT_F64] = add_scale_f64;
+	ops->copy_i[FMT_S24_32] = copy_s24_32_i;
+	ops->copy_i[FMT_S32] = copy_s32_i;
+	ops->copy_i[FMT_F64] = copy_f64_i;
+	ops->add_i[FMT_S24_32] = add_s24_32_i;
+	ops->add_i[FMT_S32] = add_s32_i;
+	ops->add_i[FMT_F64] = add_f64_i;
+	ops->copy_scale_i[FMT_S24_32] = copy_scale_s24_32_i;
+	ops->copy_scale_i[FMT_S32] = copy_scale_s32_i;
+	ops->copy_scale_i[FMT_F64] = copy_scale_f64_i;
+	ops->add_scale_i[FMT_S24_32] = add_scale_s24_32_i;
+	ops->add_scale_i[FMT_S32] = add_scale_s32_i;
+	ops->add_scale_i[FMT_F64] = add_scale_f64_i;
+
+	/* the vector versions replace what they implement, clear and copy
+	 * are left to the C library */
+#if defined(HAVE_SSE2)
+	if (cpu_flags & MIX_CPU_FLAG_SSE2)
+		spa_audiomixer_init_ops_sse2(ops);
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & MIX_CPU_FLAG_AVX2)
+		spa_audiomixer_init_ops_avx2(ops);
+#endif
 }
@@ -30,9 +30,14 @@ typedef void (*mix_i_func_t) (void *dst, int dst_stride,
 typedef void (*mix_scale_i_func_t) (void *dst, int dst_stride,
 				    const void *src, int src_stride, const double scale, int n_bytes);
 
+/* the sample formats, the ops work on contiguous samples of one format and
+ * are also used for the planes of non-interleaved audio */
 enum {
 	FMT_S16,
 	FMT_F32,
+	FMT_S24_32,	/**< 24 bits in the lower bits of 32 */
+	FMT_S32,
+	FMT_F64,
 	FMT_MAX,
 };
 
@@ -48,4 +53,40 @@ struct spa_audiomixer_ops {
 	mix_scale_i_func_t add_scale_i[FMT_MAX];
 };
 
-void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops);
+#define MIX_CPU_FLAG_SSE2	(1 << 0)
+#define MIX_CPU_FLAG_AVX2	(1 << 1)
+
+/** The MIX_CPU_FLAG_ of the cpu we run on */
+uint32_t spa_audiomixer_get_cpu_flags(void);
+
+/** Fill \a ops with the fastest implementations for \a cpu_flags, 0 gives
+ * the C versions */
+void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops, uint32_t cpu_flags);
+
+void spa_audiomixer_init_ops_sse2(struct spa_audiomixer_ops *ops);
+void spa_audiomixer_init_ops_avx2(struct spa_audiomixer_ops *ops);
+
+/* strided ops of the vector versions, contiguous samples go to \a op, the
+ * others to \a fallback_op of the static fallback ops of the file */
+#define MIX_I(name,op,fallback_op,fmt)							\
+static void										\
+name(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)		\
+{											\
+	if (dst_stride == 1 && src_stride == 1)						\
+		op(dst, src, n_bytes);							\
+	else										\
+		fallback.fallback_op[fmt](dst, dst_stride, src, src_stride, n_bytes);	\
+}
+
+#define MIX_SCALE_I(name,op,fallback_op,fmt)						\
+static void										\
+name(void *dst, int dst_stride, const void *src, int src_stride,			\
+     const double scale, int n_bytes)							\
+{											\
+	if (dst_stride == 1 && src_stride == 1)						\
+		op(dst, src, scale, n_bytes);						\
+	else										\
+		fallback.fallback_op[fmt](dst, dst_stride, src, src_stride,		\
+					  scale, n_bytes);				\
+}
+
@@ -160,6 +160,7 @@ struct impl {
 	struct spa_port_info info;
 	struct spa_io_buffers *io;
 	struct spa_io_control_range *io_range;
+	struct spa_io_control_quantum *io_quantum;
 
 	uint32_t *io_wave;
 	double *io_freq;
@@ -357,6 +358,7 @@ static int make_buffer(struct impl *this)
 	struct buffer *b;
 	struct spa_io_buffers *io = this->io;
 	struct spa_io_control_range *range = this->io_range;
+	struct spa_io_control_quantum *quantum = this->io_quantum;
 	int n_bytes, n_samples;
 	uint32_t maxsize;
 	void *data;
@@ -380,6 +382,8 @@ static int make_buffer(struct impl *this)
 	data = d[0].data;
 
 	n_bytes = maxsize;
+	if (quantum && quantum->size != 0)
+		n_bytes = SPA_MIN(n_bytes, quantum->size * this->bpf);
 	if (range && range->min_size != 0) {
 		n_bytes = SPA_MIN(n_bytes, range->min_size);
 		if (range->max_size < n_bytes)
@@ -725,6 +729,12 @@ impl_node_port_enum_params(struct spa_node *node,
 				":", t->param_io.id, "I", t->io.ControlRange,
 				":", t->param_io.size, "i", sizeof(struct spa_io_control_range));
 			break;
+		case 1:
+			param = spa_pod_builder_object(&b,
+				id, t->param_io.Control,
+				":", t->param_io.id, "I", t->io.ControlQuantum,
+				":", t->param_io.size, "i", sizeof(struct spa_io_control_quantum));
+			break;
 		default:
 			return 0;
 		}
@@ -948,6 +958,8 @@ impl_node_port_set_io(struct spa_node *node,
 		this->io = data;
 	else if (id == t->io.ControlRange)
 		this->io_range = data;
+	else if (id == t->io.ControlQuantum)
+		this->io_quantum = data;
 	else if (id == t->io_prop_wave) {
 		if (data && size >= sizeof(struct spa_pod_id))
 			this->io_wave = &SPA_POD_VALUE(struct spa_pod_id, data);
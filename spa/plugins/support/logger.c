@@ -23,6 +23,8 @@
 #include <errno.h>
 #include <stdio.h>
 #include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 #include <spa/support/type-map.h>
 #include <spa/support/log.h>
@@ -35,6 +37,11 @@
 #define DEFAULT_LOG_LEVEL SPA_LOG_LEVEL_INFO
 
 #define TRACE_BUFFER (16*1024)
+#define TRACE_MAX_MESSAGE 1024
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
 
 struct type {
 	uint32_t log;
@@ -52,8 +59,9 @@ struct impl {
 	struct type type;
 	struct spa_type_map *map;
 
-	struct spa_ringbuffer trace_rb;
-	uint8_t trace_data[TRACE_BUFFER];
+	struct spa_ringbuffer_padded trace_rb;
+	uint8_t *trace_data;		/**< mapped twice, see map_mirrored() */
+	uint32_t trace_size;		/**< TRACE_BUFFER rounded up to pages */
 
 	bool have_source;
 	struct spa_source source;
@@ -69,7 +77,7 @@ impl_log_logv(struct spa_log *log,
 	      va_list args)
 {
 	struct impl *impl = SPA_CONTAINER_OF(log, struct impl, log);
-	char text[512], location[1024];
+	char text[512], location[TRACE_MAX_MESSAGE];
 	static const char *levels[] = { "-", "E", "W", "I", "D", "T", "*T*" };
 	int size;
 	bool do_trace;
@@ -78,22 +86,31 @@ impl_log_logv(struct spa_log *log,
 		level++;
 
 	vsnprintf(text, sizeof(text), fmt, args);
-	size = snprintf(location, sizeof(location), "[%s][%s:%i %s()] %s\n",
-		levels[level], strrchr(file, '/') + 1, line, func, text);
 
 	if (SPA_UNLIKELY(do_trace)) {
 		uint32_t index;
 		uint64_t count = 1;
+		char *p;
+
+		/* format the message in place, drop it when the reader is
+		 * too far behind */
+		p = spa_ringbuffer_padded_write_reserve(&impl->trace_rb, impl->trace_data,
+							impl->trace_size, TRACE_MAX_MESSAGE, &index);
+		if (p == NULL)
+			return;
 
-		spa_ringbuffer_get_write_index(&impl->trace_rb, &index);
-		spa_ringbuffer_write_data(&impl->trace_rb, impl->trace_data, TRACE_BUFFER,
-					  index & (TRACE_BUFFER - 1), location, size);
-		spa_ringbuffer_write_update(&impl->trace_rb, index + size);
+		size = snprintf(p, TRACE_MAX_MESSAGE, "[%s][%s:%i %s()] %s\n",
+			levels[level], strrchr(file, '/') + 1, line, func, text);
+		spa_ringbuffer_padded_write_commit(&impl->trace_rb, index,
+						   SPA_MIN(size, TRACE_MAX_MESSAGE - 1));
 
 		if (write(impl->source.fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
 			fprintf(stderr, "error signaling eventfd: %s\n", strerror(errno));
-	} else
+	} else {
+		snprintf(location, sizeof(location), "[%s][%s:%i %s()] %s\n",
+			levels[level], strrchr(file, '/') + 1, line, func, text);
 		fputs(location, stderr);
+	}
 }
 
 
@@ -114,6 +131,7 @@ impl_log_log(struct spa_log *log,
 static void on_trace_event(struct spa_source *source)
 {
 	struct impl *impl = source->data;
+	const void *data;
 	int32_t avail;
 	uint32_t index;
 	uint64_t count;
@@ -121,22 +139,39 @@ static void on_trace_event(struct spa_source *source)
 	if (read(source->fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
 		fprintf(stderr, "failed to read event fd: %s", strerror(errno));
 
-	while ((avail = spa_ringbuffer_get_read_index(&impl->trace_rb, &index)) > 0) {
-		uint32_t offset, first;
-
-		if (avail > TRACE_BUFFER) {
-			index += avail - TRACE_BUFFER;
-			avail = TRACE_BUFFER;
-		}
-		offset = index & (TRACE_BUFFER - 1);
-		first = SPA_MIN(avail, TRACE_BUFFER - offset);
-
-		fwrite(impl->trace_data + offset, first, 1, stderr);
-		if (SPA_UNLIKELY(avail > first)) {
-			fwrite(impl->trace_data, avail - first, 1, stderr);
-		}
-		spa_ringbuffer_read_update(&impl->trace_rb, index + avail);
-        }
+	while ((data = spa_ringbuffer_padded_read_peek(&impl->trace_rb, impl->trace_data,
+						       impl->trace_size, 1, &index, &avail)) != NULL) {
+		fwrite(data, avail, 1, stderr);
+		spa_ringbuffer_padded_read_release(&impl->trace_rb, index, avail);
+	}
+}
+
+/* map \a size bytes twice back to back, \a size is a multiple of the page size */
+static void *map_mirrored(size_t size)
+{
+	void *ptr;
+	int fd;
+
+	if ((fd = syscall(SYS_memfd_create, "spa-logger", MFD_CLOEXEC)) < 0)
+		return NULL;
+	if (ftruncate(fd, size) < 0)
+		goto error_close;
+
+	ptr = mmap(NULL, size << 1, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		goto error_close;
+	if (mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, 0) != ptr ||
+	    mmap(ptr + size, size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, 0) != ptr + size)
+		goto error_unmap;
+
+	close(fd);
+	return ptr;
+
+      error_unmap:
+	munmap(ptr, size << 1);
+      error_close:
+	close(fd);
+	return NULL;
 }
 
 static const struct spa_log impl_log = {
@@ -177,6 +212,8 @@ static int impl_clear(struct spa_handle *handle)
 		close(this->source.fd);
 		this->have_source = false;
 	}
+	if (this->trace_data)
+		munmap(this->trace_data, this->trace_size << 1);
 	return 0;
 }
 
@@ -213,7 +250,14 @@ impl_init(const struct spa_handle_factory *factory,
 	}
 	init_type(&this->type, this->map);
 
-	if (loop) {
+	/* the halves of the mirror are mapped at page granularity, both sizes
+	 * are powers of 2 so this stays a valid ringbuffer size */
+	this->trace_size = SPA_ROUND_UP_N(TRACE_BUFFER, sysconf(_SC_PAGESIZE));
+
+	if (loop && (this->trace_data = map_mirrored(this->trace_size)) == NULL)
+		fprintf(stderr, NAME " %p: can't map trace buffer: %s\n", this, strerror(errno));
+
+	if (loop && this->trace_data) {
 		this->source.func = on_trace_event;
 		this->source.data = this;
 		this->source.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
@@ -223,7 +267,7 @@ impl_init(const struct spa_handle_factory *factory,
 		this->have_source = true;
 	}
 
-	spa_ringbuffer_init(&this->trace_rb);
+	spa_ringbuffer_padded_init(&this->trace_rb);
 
 	spa_log_debug(&this->log, NAME " %p: initialized", this);
 
@@ -0,0 +1,568 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include <spa/utils/list.h>
+
+#include "loop-uring.h"
+
+#define NAME "loop-uring"
+
+/** \cond */
+
+enum poll_state {
+	POLL_IDLE,		/**< no request, the fd had an error */
+	POLL_ARMED,		/**< a poll request is queued or pending */
+	POLL_REAPED,		/**< completed, waiting for dispatch */
+	POLL_PENDING,		/**< waiting for room in the submission queue */
+};
+
+/* one registered source, this is the user_data of its poll requests */
+struct uring_poll {
+	struct spa_list link;
+	struct spa_source *source;
+	enum poll_state state;
+	bool removed;		/**< freed when the last request completes */
+	int res;		/**< result of the last poll */
+	bool pending;		/**< in the pending list, a poll when the state is
+				  *  POLL_PENDING, a cancel when it is POLL_ARMED */
+	struct spa_list pending_link;
+};
+
+struct uring {
+	struct spa_log *log;
+	int fd;
+
+	pthread_mutex_t lock;	/**< protects the submission queue and polls */
+	uint32_t to_submit;
+	struct spa_list polls;
+	struct spa_list pending;	/**< requests that did not fit in the queue */
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	uint32_t *sq_head;
+	uint32_t *sq_tail;
+	uint32_t sq_mask;
+	uint32_t *sq_array;
+	uint32_t sq_entries;
+
+	uint32_t *cq_head;
+	uint32_t *cq_tail;
+	uint32_t cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/* completions of the last wait */
+	struct uring_poll **reaped;
+	uint32_t n_reaped;
+	uint32_t max_reaped;
+};
+/** \endcond */
+
+static inline int sys_io_uring_setup(uint32_t entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int sys_io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete,
+				     uint32_t flags, void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static inline uint32_t io_to_poll(enum spa_io mask)
+{
+	uint32_t events = 0;
+
+	if (mask & SPA_IO_IN)
+		events |= POLLIN;
+	if (mask & SPA_IO_OUT)
+		events |= POLLOUT;
+	if (mask & SPA_IO_ERR)
+		events |= POLLERR;
+	if (mask & SPA_IO_HUP)
+		events |= POLLHUP;
+
+	return events;
+}
+
+static inline enum spa_io poll_to_io(uint32_t events)
+{
+	enum spa_io mask = 0;
+
+	if (events & POLLIN)
+		mask |= SPA_IO_IN;
+	if (events & POLLOUT)
+		mask |= SPA_IO_OUT;
+	if (events & POLLHUP)
+		mask |= SPA_IO_HUP;
+	if (events & POLLERR)
+		mask |= SPA_IO_ERR;
+
+	return mask;
+}
+
+/* call with the lock */
+static int submit(struct uring *uring)
+{
+	int res;
+
+	if (uring->to_submit == 0)
+		return 0;
+
+	if ((res = sys_io_uring_enter(uring->fd, uring->to_submit, 0, 0, NULL, 0)) < 0) {
+		spa_log_warn(uring->log, NAME " %p: submit failed: %s", uring, strerror(errno));
+		return -errno;
+	}
+	/* what was not consumed goes with the next submit */
+	uring->to_submit -= SPA_MIN((uint32_t) res, uring->to_submit);
+	return 0;
+}
+
+/* call with the lock */
+static struct io_uring_sqe *get_sqe(struct uring *uring)
+{
+	uint32_t tail = *uring->sq_tail, index;
+	struct io_uring_sqe *sqe;
+
+	if (tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE) >= uring->sq_entries) {
+		submit(uring);
+		if (tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE) >= uring->sq_entries)
+			return NULL;
+	}
+	index = tail & uring->sq_mask;
+	sqe = &uring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	uring->sq_array[index] = index;
+	return sqe;
+}
+
+/* call with the lock */
+static inline void queue_sqe(struct uring *uring)
+{
+	__atomic_store_n(uring->sq_tail, *uring->sq_tail + 1, __ATOMIC_RELEASE);
+	uring->to_submit++;
+}
+
+static int queue_poll(struct uring *uring, struct uring_poll *p)
+{
+	struct io_uring_sqe *sqe;
+
+	if ((sqe = get_sqe(uring)) == NULL)
+		return -EBUSY;
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = p->source->fd;
+	sqe->poll32_events = io_to_poll(p->source->mask);
+	sqe->user_data = (uint64_t)(uintptr_t) p;
+	queue_sqe(uring);
+
+	p->state = POLL_ARMED;
+	return 0;
+}
+
+static int queue_cancel(struct uring *uring, struct uring_poll *p)
+{
+	struct io_uring_sqe *sqe;
+
+	if ((sqe = get_sqe(uring)) == NULL)
+		return -EBUSY;
+
+	/* the result of the cancel itself is ignored, the poll completes
+	 * with -ECANCELED or with its events */
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->addr = (uint64_t)(uintptr_t) p;
+	sqe->user_data = 0;
+	queue_sqe(uring);
+	return 0;
+}
+
+/* call with the lock, the request is retried on the next wait when the
+ * submission queue is full */
+static void add_pending(struct uring *uring, struct uring_poll *p)
+{
+	if (!p->pending) {
+		spa_list_append(&uring->pending, &p->pending_link);
+		p->pending = true;
+	}
+}
+
+static void remove_pending(struct uring_poll *p)
+{
+	if (p->pending) {
+		spa_list_remove(&p->pending_link);
+		p->pending = false;
+	}
+}
+
+static void rearm_poll(struct uring *uring, struct uring_poll *p)
+{
+	if (queue_poll(uring, p) < 0) {
+		p->state = POLL_PENDING;
+		add_pending(uring, p);
+	}
+}
+
+static void cancel_poll(struct uring *uring, struct uring_poll *p)
+{
+	if (p->pending || queue_cancel(uring, p) < 0)
+		add_pending(uring, p);
+}
+
+/* call with the lock, in order until the queue is full again */
+static void queue_pending(struct uring *uring)
+{
+	struct uring_poll *p, *t;
+	int res;
+
+	spa_list_for_each_safe(p, t, &uring->pending, pending_link) {
+		if (p->state == POLL_PENDING)
+			res = queue_poll(uring, p);
+		else
+			res = queue_cancel(uring, p);
+		if (res < 0)
+			break;
+		remove_pending(p);
+	}
+}
+
+struct uring *uring_new(struct spa_log *log, uint32_t entries)
+{
+	struct uring *uring;
+	struct io_uring_params p;
+
+	uring = calloc(1, sizeof(struct uring));
+	if (uring == NULL)
+		return NULL;
+
+	uring->log = log;
+
+	spa_zero(p);
+	if ((uring->fd = sys_io_uring_setup(entries, &p)) < 0) {
+		spa_log_info(log, NAME " %p: can't setup: %s", uring, strerror(errno));
+		goto error_free;
+	}
+	if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+		spa_log_info(log, NAME " %p: kernel is too old", uring);
+		goto error_close;
+	}
+
+	uring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	uring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	uring->sq_ring_size = SPA_MAX(uring->sq_ring_size, uring->cq_ring_size);
+	uring->sq_ring = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQ_RING);
+	if (uring->sq_ring == MAP_FAILED)
+		goto error_close;
+	uring->cq_ring = uring->sq_ring;
+
+	uring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQES);
+	if (uring->sqes == MAP_FAILED)
+		goto error_unmap;
+
+	uring->sq_head = SPA_MEMBER(uring->sq_ring, p.sq_off.head, uint32_t);
+	uring->sq_tail = SPA_MEMBER(uring->sq_ring, p.sq_off.tail, uint32_t);
+	uring->sq_mask = *SPA_MEMBER(uring->sq_ring, p.sq_off.ring_mask, uint32_t);
+	uring->sq_array = SPA_MEMBER(uring->sq_ring, p.sq_off.array, uint32_t);
+	uring->sq_entries = p.sq_entries;
+
+	uring->cq_head = SPA_MEMBER(uring->cq_ring, p.cq_off.head, uint32_t);
+	uring->cq_tail = SPA_MEMBER(uring->cq_ring, p.cq_off.tail, uint32_t);
+	uring->cq_mask = *SPA_MEMBER(uring->cq_ring, p.cq_off.ring_mask, uint32_t);
+	uring->cqes = SPA_MEMBER(uring->cq_ring, p.cq_off.cqes, struct io_uring_cqe);
+
+	uring->max_reaped = p.cq_entries;
+	uring->reaped = calloc(uring->max_reaped, sizeof(struct uring_poll *));
+	if (uring->reaped == NULL)
+		goto error_unmap_sqes;
+
+	pthread_mutex_init(&uring->lock, NULL);
+	spa_list_init(&uring->polls);
+	spa_list_init(&uring->pending);
+
+	spa_log_info(log, NAME " %p: %u entries", uring, p.sq_entries);
+
+	return uring;
+
+      error_unmap_sqes:
+	munmap(uring->sqes, uring->sqes_size);
+      error_unmap:
+	munmap(uring->sq_ring, uring->sq_ring_size);
+      error_close:
+	close(uring->fd);
+      error_free:
+	free(uring);
+	return NULL;
+}
+
+static void free_poll(struct uring_poll *p)
+{
+	remove_pending(p);
+	spa_list_remove(&p->link);
+	free(p);
+}
+
+void uring_destroy(struct uring *uring)
+{
+	struct uring_poll *p, *t;
+
+	/* polls of removed sources that did not complete yet */
+	spa_list_for_each_safe(p, t, &uring->polls, link)
+		free_poll(p);
+
+	pthread_mutex_destroy(&uring->lock);
+	free(uring->reaped);
+	munmap(uring->sqes, uring->sqes_size);
+	munmap(uring->sq_ring, uring->sq_ring_size);
+	close(uring->fd);
+	free(uring);
+}
+
+int uring_get_fd(struct uring *uring)
+{
+	return uring->fd;
+}
+
+int uring_add_source(struct uring *uring, struct spa_source *source, bool do_submit)
+{
+	struct uring_poll *p;
+
+	source->priv = NULL;
+	if (source->fd == -1)
+		return 0;
+
+	p = calloc(1, sizeof(struct uring_poll));
+	if (p == NULL)
+		return -ENOMEM;
+
+	p->source = source;
+
+	pthread_mutex_lock(&uring->lock);
+	/* when the submit fails, the request goes with the next wait */
+	spa_list_append(&uring->polls, &p->link);
+	rearm_poll(uring, p);
+	if (do_submit)
+		submit(uring);
+	pthread_mutex_unlock(&uring->lock);
+
+	source->priv = p;
+	return 0;
+}
+
+int uring_update_source(struct uring *uring, struct spa_source *source, bool do_submit)
+{
+	struct uring_poll *p = source->priv;
+
+	if (p == NULL)
+		return 0;
+
+	pthread_mutex_lock(&uring->lock);
+	switch (p->state) {
+	case POLL_ARMED:
+		/* rearmed with the new mask when the cancel completes */
+		cancel_poll(uring, p);
+		break;
+	case POLL_IDLE:
+		rearm_poll(uring, p);
+		break;
+	case POLL_REAPED:
+		/* rearmed with the new mask after dispatch */
+	case POLL_PENDING:
+		/* queued with the new mask on the next wait */
+		break;
+	}
+	if (do_submit)
+		submit(uring);
+	pthread_mutex_unlock(&uring->lock);
+
+	return 0;
+}
+
+void uring_remove_source(struct uring *uring, struct spa_source *source, bool do_submit)
+{
+	struct uring_poll *p = source->priv;
+
+	if (p == NULL)
+		return;
+
+	/* the loop thread looks at the poll under the lock when it dispatches */
+	pthread_mutex_lock(&uring->lock);
+	source->priv = NULL;
+	p->source = NULL;
+	p->removed = true;
+
+	switch (p->state) {
+	case POLL_ARMED:
+		/* freed when the poll completes, the kernel can still complete
+		 * it until then. When the cancel does not fit in the queue it
+		 * is retried on the next wait. */
+		cancel_poll(uring, p);
+		if (do_submit)
+			submit(uring);
+		break;
+	case POLL_IDLE:
+	case POLL_PENDING:
+		free_poll(p);
+		break;
+	case POLL_REAPED:
+		/* freed after dispatch */
+		break;
+	}
+	pthread_mutex_unlock(&uring->lock);
+}
+
+int uring_wait(struct uring *uring, int timeout)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	uint32_t to_submit, head, tail, flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+	int res;
+
+	spa_zero(arg);
+	if (timeout >= 0) {
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
+		arg.ts = (uint64_t)(uintptr_t) &ts;
+	}
+
+	pthread_mutex_lock(&uring->lock);
+	queue_pending(uring);
+	to_submit = uring->to_submit;
+	uring->to_submit = 0;
+	pthread_mutex_unlock(&uring->lock);
+
+	res = sys_io_uring_enter(uring->fd, to_submit, timeout == 0 ? 0 : 1,
+			flags, &arg, sizeof(arg));
+	if (res < 0 && errno != ETIME)
+		return -errno;
+
+	head = *uring->cq_head;
+	tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+
+	pthread_mutex_lock(&uring->lock);
+	uring->n_reaped = 0;
+	while (head != tail && uring->n_reaped < uring->max_reaped) {
+		struct io_uring_cqe *cqe = &uring->cqes[head & uring->cq_mask];
+		struct uring_poll *p = (struct uring_poll *)(uintptr_t) cqe->user_data;
+
+		head++;
+		if (p == NULL)
+			continue;
+
+		/* a cancel that did not fit in the queue is not needed anymore */
+		remove_pending(p);
+		p->state = POLL_REAPED;
+		p->res = cqe->res;
+		uring->reaped[uring->n_reaped++] = p;
+	}
+	pthread_mutex_unlock(&uring->lock);
+	__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+
+	return uring->n_reaped;
+}
+
+static inline int poll_priority(const struct uring_poll *p)
+{
+	return p->removed ? SPA_SOURCE_PRIORITY_DEFAULT : p->source->priority;
+}
+
+static int compare_polls(const void *p1, const void *p2)
+{
+	return poll_priority(*(struct uring_poll * const *) p2) -
+		poll_priority(*(struct uring_poll * const *) p1);
+}
+
+void uring_dispatch(struct uring *uring)
+{
+	uint32_t i;
+
+	/* sources can be removed from other threads */
+	pthread_mutex_lock(&uring->lock);
+
+	/* like the epoll loop, dispatch in the order of the priorities */
+	for (i = 1; i < uring->n_reaped; i++) {
+		if (compare_polls(&uring->reaped[i - 1], &uring->reaped[i]) != 0) {
+			qsort(uring->reaped, uring->n_reaped, sizeof(struct uring_poll *),
+					compare_polls);
+			break;
+		}
+	}
+
+	/* like the epoll loop, first set all the rmasks, then call the
+	 * callbacks */
+	for (i = 0; i < uring->n_reaped; i++) {
+		struct uring_poll *p = uring->reaped[i];
+
+		if (p->removed)
+			continue;
+		if (p->res >= 0)
+			p->source->rmask = poll_to_io(p->res);
+		else if (p->res == -ECANCELED)
+			p->source->rmask = 0;
+		else
+			p->source->rmask = SPA_IO_ERR;
+	}
+	pthread_mutex_unlock(&uring->lock);
+
+	for (i = 0; i < uring->n_reaped; i++) {
+		struct uring_poll *p = uring->reaped[i];
+		struct spa_source *s;
+
+		/* the callbacks can remove the sources of the next polls */
+		pthread_mutex_lock(&uring->lock);
+		s = p->removed ? NULL : p->source;
+		pthread_mutex_unlock(&uring->lock);
+
+		if (s && s->rmask && s->fd != -1)
+			s->func(s);
+	}
+
+	pthread_mutex_lock(&uring->lock);
+	for (i = 0; i < uring->n_reaped; i++) {
+		struct uring_poll *p = uring->reaped[i];
+
+		if (p->removed)
+			free_poll(p);
+		else if (p->res >= 0 || p->res == -ECANCELED)
+			rearm_poll(uring, p);
+		else {
+			spa_log_warn(uring->log, NAME " %p: poll on fd %d failed: %s", uring,
+					p->source->fd, strerror(-p->res));
+			p->state = POLL_IDLE;
+		}
+	}
+	pthread_mutex_unlock(&uring->lock);
+
+	uring->n_reaped = 0;
+}
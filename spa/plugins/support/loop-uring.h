@@ -0,0 +1,50 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_LOOP_URING_H__
+#define __SPA_LOOP_URING_H__
+
+#include <spa/support/loop.h>
+#include <spa/support/log.h>
+
+/* io_uring backend of the loop. Sources are polled with one-shot poll
+ * requests that are rearmed after dispatch, the requests of one
+ * iteration are submitted together with the wait for new events.
+ *
+ * Requests that are made from the thread of the loop are only submitted
+ * with the next wait, other threads pass submit = true. */
+struct uring;
+
+struct uring *uring_new(struct spa_log *log, uint32_t entries);
+void uring_destroy(struct uring *uring);
+
+int uring_get_fd(struct uring *uring);
+
+int uring_add_source(struct uring *uring, struct spa_source *source, bool submit);
+int uring_update_source(struct uring *uring, struct spa_source *source, bool submit);
+void uring_remove_source(struct uring *uring, struct spa_source *source, bool submit);
+
+/* submit the queued requests and wait \a timeout msec for events,
+ * returns < 0 on error */
+int uring_wait(struct uring *uring, int timeout);
+
+/* call the sources that have events */
+void uring_dispatch(struct uring *uring);
+
+#endif /* __SPA_LOOP_URING_H__ */
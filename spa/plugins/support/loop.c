@@ -27,6 +27,8 @@
 #include <sys/timerfd.h>
 #include <sys/eventfd.h>
 #include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <pthread.h>
 
 #include <spa/support/loop.h>
@@ -34,23 +36,47 @@
 #include <spa/support/type-map.h>
 #include <spa/support/plugin.h>
 #include <spa/utils/list.h>
-#include <spa/utils/ringbuffer.h>
+
+#ifdef HAVE_IO_URING
+#include "loop-uring.h"
+#endif
 
 #define NAME "loop"
 
-#define DATAS_SIZE (4096 * 8)
+#define URING_ENTRIES	256
+
+#define MIN_EVENTS		32
+#define MAX_EVENTS		4096
+
+#define SOURCES_PER_SLAB	32
+#define MAX_FREE_FDS		16
+#define INVOKE_ITEMS		64
+#define INVOKE_DATA_SIZE	128
 
 /** \cond */
 
+/* Blocking invokes queue an item on the stack of the caller and pass the
+ * data without copying it, the caller sleeps on \a done until the loop
+ * has called the function. Other invokes take a preallocated slot for the
+ * item and a copy of the data, the loop gives it back. Only when the slots
+ * run out or the data doesn't fit, the item is allocated. */
 struct invoke_item {
-	size_t item_size;
+	struct invoke_item *next;
 	spa_invoke_func_t func;
 	uint32_t seq;
 	void *data;
 	size_t size;
 	bool block;
+	bool pooled;			/**< the item is in a slot */
+	uint32_t free_next;		/**< next free slot */
 	void *user_data;
 	int res;
+	int done;
+};
+
+struct invoke_slot {
+	struct invoke_item item;
+	uint8_t data[INVOKE_DATA_SIZE];
 };
 
 struct type {
@@ -60,6 +86,10 @@ struct type {
 };
 
 static void loop_signal_event(struct spa_source *source);
+static void source_io_func(struct spa_source *source);
+static void source_idle_func(struct spa_source *source);
+static void source_event_func(struct spa_source *source);
+static void source_signal_func(struct spa_source *source);
 
 static inline void init_type(struct type *type, struct spa_type_map *map)
 {
@@ -82,14 +112,59 @@ struct impl {
 	struct spa_list destroy_list;
 	struct spa_hook_list hooks_list;
 
+	/* sources are allocated from slabs and recycled through free_list,
+	 * eventfds of destroyed event and idle sources are kept in free_fds.
+	 * Sources can be added and destroyed from other threads so these and
+	 * destroy_list are protected with pool_lock */
+	pthread_mutex_t pool_lock;
+	struct source_slab *slabs;
+	struct spa_list free_list;
+	int free_fds[MAX_FREE_FDS];
+	uint32_t n_free_fds;
+
+	/* when profiling, the epoll data of the sources points to their
+	 * source_profile, removed profiles are freed after dispatching.
+	 * The lists are protected with pool_lock */
+	bool profile;
+	struct spa_list profile_list;
+	struct spa_list profile_destroy_list;
+	struct source_profile *stats_last;	/**< returned by the last get_stats */
+	uint32_t stats_index;			/**< index of stats_last */
+
 	int epoll_fd;
+	/* the events of one epoll_wait, grown with the number of sources so
+	 * that a burst is dispatched in one iteration */
+	struct epoll_event *events;
+	uint32_t max_events;
+	int n_sources;			/**< sources registered with epoll */
+#ifdef HAVE_IO_URING
+	struct uring *uring;		/**< used instead of epoll when set */
+#endif
 	pthread_t thread;
 
 	struct spa_source *wakeup;
-	int ack_fd;
 
-	struct spa_ringbuffer buffer;
-	uint8_t buffer_data[DATAS_SIZE];
+	/* multi-producer single-consumer queue of invoke items, producers
+	 * swap themselves into head, the loop pops from tail */
+	struct invoke_item *head;
+	struct invoke_item *tail;
+	struct invoke_item stub;
+
+	/* stack of free slots, the index of the first slot in the low 32 bits
+	 * and a count of the updates in the high bits against ABA */
+	uint64_t free_slots;
+	struct invoke_slot slots[INVOKE_ITEMS];
+
+	/* all timers share one timerfd that is armed for the first timer
+	 * in the heap. Timers can be updated and destroyed from other threads
+	 * so the heap and the timer fields of the sources are protected with
+	 * timer_lock */
+	pthread_mutex_t timer_lock;
+	struct spa_source timer_source;
+	struct source_impl **timers;
+	uint32_t n_timers;
+	uint32_t max_timers;
+	uint64_t timer_armed;		/**< expiration the timerfd is armed for */
 };
 
 struct source_impl {
@@ -108,6 +183,24 @@ struct source_impl {
 	} func;
 	int signal_number;
 	bool enabled;
+
+	bool armed;			/**< the timer is in the heap */
+	uint32_t heap_index;		/**< index in the timer heap */
+	uint64_t expire;		/**< absolute expiration in nsec */
+	uint64_t interval;		/**< interval in nsec or 0 */
+
+	struct source_profile *profile;	/**< profile of a timer */
+};
+
+struct source_profile {
+	struct spa_list link;
+	struct spa_source *source;	/**< NULL when removed */
+	struct spa_loop_source_stats stats;
+};
+
+struct source_slab {
+	struct source_slab *next;
+	struct source_impl sources[SOURCES_PER_SLAB];
 };
 /** \endcond */
 
@@ -143,12 +236,102 @@ static inline enum spa_io spa_epoll_to_io(uint32_t events)
 	return mask;
 }
 
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+/* the callback of the user, sources of the utils dispatch through a
+ * wrapper */
+static const void *source_callback(struct spa_source *source)
+{
+	struct source_impl *s = SPA_CONTAINER_OF(source, struct source_impl, source);
+
+	if (source->func == source_io_func ||
+	    source->func == source_idle_func ||
+	    source->func == source_event_func ||
+	    source->func == source_signal_func)
+		return s->func.io;
+
+	return source->func;
+}
+
+static struct source_profile *add_profile(struct impl *impl, struct spa_source *source,
+					  const void *func)
+{
+	struct source_profile *prof;
+
+	prof = calloc(1, sizeof(struct source_profile));
+	if (prof == NULL)
+		return NULL;
+
+	prof->source = source;
+	prof->stats.source = source;
+	prof->stats.func = func;
+	prof->stats.data = source->data;
+
+	pthread_mutex_lock(&impl->pool_lock);
+	spa_list_append(&impl->profile_list, &prof->link);
+	pthread_mutex_unlock(&impl->pool_lock);
+
+	return prof;
+}
+
+static struct source_profile *find_profile(struct impl *impl, struct spa_source *source)
+{
+	struct source_profile *prof, *res = NULL;
+
+	pthread_mutex_lock(&impl->pool_lock);
+	spa_list_for_each(prof, &impl->profile_list, link) {
+		if (prof->source == source) {
+			res = prof;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&impl->pool_lock);
+
+	return res;
+}
+
+/* the profile can still be referenced by the events of the current
+ * iteration, it is freed after dispatching */
+static void remove_profile(struct impl *impl, struct source_profile *prof)
+{
+	pthread_mutex_lock(&impl->pool_lock);
+	prof->source = NULL;
+	if (impl->stats_last == prof)
+		impl->stats_last = NULL;
+	spa_list_remove(&prof->link);
+	spa_list_append(&impl->profile_destroy_list, &prof->link);
+	pthread_mutex_unlock(&impl->pool_lock);
+}
+
+static inline void profile_update(struct source_profile *prof, uint64_t delay, uint64_t time)
+{
+	struct spa_loop_source_stats *stats = &prof->stats;
+
+	stats->n_dispatch++;
+	stats->total_time += time;
+	stats->total_delay += delay;
+	if (time > stats->max_time)
+		stats->max_time = time;
+	if (delay > stats->max_delay)
+		stats->max_delay = delay;
+}
+
 static int loop_add_source(struct spa_loop *loop, struct spa_source *source)
 {
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 
 	source->loop = loop;
 
+#ifdef HAVE_IO_URING
+	if (impl->uring)
+		return -uring_add_source(impl->uring, source,
+				!pthread_equal(impl->thread, pthread_self()));
+#endif
 	if (source->fd != -1) {
 		struct epoll_event ep;
 
@@ -156,8 +339,18 @@ static int loop_add_source(struct spa_loop *loop, struct spa_source *source)
 		ep.events = spa_io_to_epoll(source->mask);
 		ep.data.ptr = source;
 
+		if (impl->profile) {
+			struct source_profile *prof;
+
+			if ((prof = add_profile(impl, source, source_callback(source))) == NULL)
+				return -ENOMEM;
+			ep.data.ptr = prof;
+		}
+
 		if (epoll_ctl(impl->epoll_fd, EPOLL_CTL_ADD, source->fd, &ep) < 0)
 			return errno;
+
+		__atomic_fetch_add(&impl->n_sources, 1, __ATOMIC_RELAXED);
 	}
 	return 0;
 }
@@ -167,6 +360,11 @@ static int loop_update_source(struct spa_source *source)
 	struct spa_loop *loop = source->loop;
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 
+#ifdef HAVE_IO_URING
+	if (impl->uring)
+		return -uring_update_source(impl->uring, source,
+				!pthread_equal(impl->thread, pthread_self()));
+#endif
 	if (source->fd != -1) {
 		struct epoll_event ep;
 
@@ -174,6 +372,9 @@ static int loop_update_source(struct spa_source *source)
 		ep.events = spa_io_to_epoll(source->mask);
 		ep.data.ptr = source;
 
+		if (impl->profile)
+			ep.data.ptr = find_profile(impl, source);
+
 		if (epoll_ctl(impl->epoll_fd, EPOLL_CTL_MOD, source->fd, &ep) < 0)
 			return errno;
 	}
@@ -185,12 +386,119 @@ static void loop_remove_source(struct spa_source *source)
 	struct spa_loop *loop = source->loop;
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 
-	if (source->fd != -1)
-		epoll_ctl(impl->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+#ifdef HAVE_IO_URING
+	if (impl->uring)
+		uring_remove_source(impl->uring, source,
+				!pthread_equal(impl->thread, pthread_self()));
+	else
+#endif
+	if (source->fd != -1) {
+		if (epoll_ctl(impl->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL) == 0)
+			__atomic_fetch_sub(&impl->n_sources, 1, __ATOMIC_RELAXED);
+
+		if (impl->profile) {
+			struct source_profile *prof = find_profile(impl, source);
+			if (prof)
+				remove_profile(impl, prof);
+		}
+	}
 
 	source->loop = NULL;
 }
 
+static inline void futex_wait(int *addr, int val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static inline void futex_wake(int *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static inline void queue_push(struct impl *impl, struct invoke_item *item)
+{
+	struct invoke_item *prev;
+
+	item->next = NULL;
+	prev = __atomic_exchange_n(&impl->head, item, __ATOMIC_ACQ_REL);
+	/* until this store the loop can't see item or the items after it */
+	__atomic_store_n(&prev->next, item, __ATOMIC_RELEASE);
+}
+
+/* returns NULL when the queue is empty or when a producer is still
+ * linking its item, that producer signals the loop again when done */
+static inline struct invoke_item *queue_pop(struct impl *impl)
+{
+	struct invoke_item *tail = impl->tail, *next;
+
+	next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	if (tail == &impl->stub) {
+		if (next == NULL)
+			return NULL;
+		impl->tail = tail = next;
+		next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	}
+	if (next == NULL) {
+		if (tail != __atomic_load_n(&impl->head, __ATOMIC_ACQUIRE))
+			return NULL;
+		queue_push(impl, &impl->stub);
+		next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+		if (next == NULL)
+			return NULL;
+	}
+	impl->tail = next;
+	return tail;
+}
+
+#define SLOT_INDEX(v)	((uint32_t) (v))
+#define SLOT_NEXT(v,i)	((((v) >> 32) + 1) << 32 | (i))
+
+static struct invoke_item *alloc_item(struct impl *impl, size_t size)
+{
+	struct invoke_item *item;
+	uint64_t head, next;
+
+	head = __atomic_load_n(&impl->free_slots, __ATOMIC_ACQUIRE);
+	while (size <= INVOKE_DATA_SIZE && SLOT_INDEX(head) != SPA_ID_INVALID) {
+		struct invoke_slot *slot = &impl->slots[SLOT_INDEX(head)];
+
+		/* free_next can be stale when the slot was taken meanwhile, the
+		 * count in head makes the exchange fail then */
+		next = SLOT_NEXT(head, __atomic_load_n(&slot->item.free_next, __ATOMIC_RELAXED));
+		if (__atomic_compare_exchange_n(&impl->free_slots, &head, next, false,
+						__ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+			item = &slot->item;
+			item->data = slot->data;
+			item->pooled = true;
+			return item;
+		}
+	}
+
+	if ((item = malloc(sizeof(struct invoke_item) + size)) == NULL)
+		return NULL;
+	item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
+	item->pooled = false;
+	return item;
+}
+
+static void free_item(struct impl *impl, struct invoke_item *item)
+{
+	uint32_t index;
+	uint64_t head;
+
+	if (!item->pooled) {
+		free(item);
+		return;
+	}
+	index = SPA_CONTAINER_OF(item, struct invoke_slot, item) - impl->slots;
+	head = __atomic_load_n(&impl->free_slots, __ATOMIC_RELAXED);
+	do {
+		__atomic_store_n(&item->free_next, SLOT_INDEX(head), __ATOMIC_RELAXED);
+	} while (!__atomic_compare_exchange_n(&impl->free_slots, &head, SLOT_NEXT(head, index),
+					      false, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
 static int
 loop_invoke(struct spa_loop *loop,
 	    spa_invoke_func_t func,
@@ -207,60 +515,45 @@ loop_invoke(struct spa_loop *loop,
 
 	if (in_thread) {
 		res = func(loop, false, seq, data, size, user_data);
-	} else {
-		int32_t filled, avail;
-		uint32_t idx, offset, l0;
-
-		filled = spa_ringbuffer_get_write_index(&impl->buffer, &idx);
-		if (filled < 0 || filled > DATAS_SIZE) {
-			spa_log_warn(impl->log, NAME " %p: queue xrun %d", impl, filled);
-			return -EPIPE;
-		}
-		avail = DATAS_SIZE - filled;
-		if (avail < sizeof(struct invoke_item)) {
-			spa_log_warn(impl->log, NAME " %p: queue full %d", impl, avail);
-			return -EPIPE;
-		}
-		offset = idx & (DATAS_SIZE - 1);
+	} else if (block) {
+		struct invoke_item stack_item;
 
-		l0 = DATAS_SIZE - offset;
-
-		item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
+		item = &stack_item;
 		item->func = func;
 		item->seq = seq;
+		item->data = (void *) data;
 		item->size = size;
-		item->block = block;
+		item->block = true;
 		item->user_data = user_data;
+		item->done = 0;
 
-		if (l0 > sizeof(struct invoke_item) + size) {
-			item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
-			item->item_size = sizeof(struct invoke_item) + size;
-			if (l0 < sizeof(struct invoke_item) + item->item_size)
-				item->item_size = l0;
-		} else {
-			item->data = impl->buffer_data;
-			item->item_size = l0 + size;
-		}
-		memcpy(item->data, data, size);
+		queue_push(impl, item);
+		spa_loop_utils_signal_event(&impl->utils, impl->wakeup);
 
-		spa_ringbuffer_write_update(&impl->buffer, idx + item->item_size);
+		while (__atomic_load_n(&item->done, __ATOMIC_ACQUIRE) == 0)
+			futex_wait(&item->done, 0);
 
-		spa_loop_utils_signal_event(&impl->utils, impl->wakeup);
+		res = item->res;
+	} else {
+		item = alloc_item(impl, size);
+		if (item == NULL)
+			return -ENOMEM;
 
-		if (block) {
-			uint64_t count = 1;
-			if (read(impl->ack_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
-				spa_log_warn(impl->log, NAME " %p: failed to read event fd: %s",
-						impl, strerror(errno));
+		item->func = func;
+		item->seq = seq;
+		item->size = size;
+		item->block = false;
+		item->user_data = user_data;
+		if (size > 0)
+			memcpy(item->data, data, size);
 
-			res = item->res;
-		}
-		else {
-			if (seq != SPA_ID_INVALID)
-				res = SPA_RESULT_RETURN_ASYNC(seq);
-			else
-				res = 0;
-		}
+		queue_push(impl, item);
+		spa_loop_utils_signal_event(&impl->utils, impl->wakeup);
+
+		if (seq != SPA_ID_INVALID)
+			res = SPA_RESULT_RETURN_ASYNC(seq);
+		else
+			res = 0;
 	}
 	return res;
 }
@@ -268,20 +561,19 @@ loop_invoke(struct spa_loop *loop,
 static void wakeup_func(void *data, uint64_t count)
 {
 	struct impl *impl = data;
-	uint32_t index;
-
-	while (spa_ringbuffer_get_read_index(&impl->buffer, &index) > 0) {
-		struct invoke_item *item =
-		    SPA_MEMBER(impl->buffer_data, index & (DATAS_SIZE - 1), struct invoke_item);
-		item->res = item->func(&impl->loop, true, item->seq, item->data, item->size,
-			   item->user_data);
-		spa_ringbuffer_read_update(&impl->buffer, index + item->item_size);
+	struct invoke_item *item;
 
+	while ((item = queue_pop(impl)) != NULL) {
+		int res = item->func(&impl->loop, true, item->seq, item->data, item->size,
+				     item->user_data);
 		if (item->block) {
-			uint64_t count = 1;
-			if (write(impl->ack_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
-				spa_log_warn(impl->log, NAME " %p: failed to write event fd: %s",
-						impl, strerror(errno));
+			/* the item lives on the stack of the caller, don't
+			 * touch it after done is set */
+			item->res = res;
+			__atomic_store_n(&item->done, 1, __ATOMIC_RELEASE);
+			futex_wake(&item->done);
+		} else {
+			free_item(impl, item);
 		}
 	}
 }
@@ -290,6 +582,10 @@ static int loop_get_fd(struct spa_loop_control *ctrl)
 {
 	struct impl *impl = SPA_CONTAINER_OF(ctrl, struct impl, control);
 
+#ifdef HAVE_IO_URING
+	if (impl->uring)
+		return uring_get_fd(impl->uring);
+#endif
 	return impl->epoll_fd;
 }
 
@@ -316,22 +612,261 @@ static void loop_leave(struct spa_loop_control *ctrl)
 	impl->thread = 0;
 }
 
+static struct source_impl *alloc_source(struct impl *impl)
+{
+	struct source_impl *source = NULL;
+	int i;
+
+	pthread_mutex_lock(&impl->pool_lock);
+	if (spa_list_is_empty(&impl->free_list)) {
+		struct source_slab *slab = malloc(sizeof(struct source_slab));
+		if (slab != NULL) {
+			slab->next = impl->slabs;
+			impl->slabs = slab;
+			for (i = 0; i < SOURCES_PER_SLAB; i++)
+				spa_list_append(&impl->free_list, &slab->sources[i].link);
+		}
+	}
+	if (!spa_list_is_empty(&impl->free_list)) {
+		source = spa_list_first(&impl->free_list, struct source_impl, link);
+		spa_list_remove(&source->link);
+	}
+	pthread_mutex_unlock(&impl->pool_lock);
+
+	if (source != NULL)
+		memset(source, 0, sizeof(struct source_impl));
+
+	return source;
+}
+
+static void free_source(struct impl *impl, struct source_impl *source)
+{
+	pthread_mutex_lock(&impl->pool_lock);
+	spa_list_append(&impl->free_list, &source->link);
+	pthread_mutex_unlock(&impl->pool_lock);
+}
+
+/* sources can still be referenced by the events of the current iteration,
+ * they are only recycled after dispatching */
+static void free_destroyed(struct impl *impl)
+{
+	struct source_profile *prof, *tmp;
+
+	if (spa_list_is_empty(&impl->destroy_list) &&
+	    spa_list_is_empty(&impl->profile_destroy_list))
+		return;
+
+	pthread_mutex_lock(&impl->pool_lock);
+	if (!spa_list_is_empty(&impl->destroy_list)) {
+		spa_list_insert_list(&impl->free_list, &impl->destroy_list);
+		spa_list_init(&impl->destroy_list);
+	}
+	spa_list_for_each_safe(prof, tmp, &impl->profile_destroy_list, link)
+		free(prof);
+	spa_list_init(&impl->profile_destroy_list);
+	pthread_mutex_unlock(&impl->pool_lock);
+}
+
+static int get_eventfd(struct impl *impl)
+{
+	int fd = -1;
+
+	pthread_mutex_lock(&impl->pool_lock);
+	if (impl->n_free_fds > 0)
+		fd = impl->free_fds[--impl->n_free_fds];
+	pthread_mutex_unlock(&impl->pool_lock);
+
+	if (fd == -1)
+		fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	return fd;
+}
+
+/* reset the counter and keep the eventfd for the next event or idle source */
+static void release_eventfd(struct impl *impl, int fd)
+{
+	uint64_t count;
+
+	if (read(fd, &count, sizeof(uint64_t)) != sizeof(uint64_t) && errno != EAGAIN) {
+		close(fd);
+		return;
+	}
+
+	pthread_mutex_lock(&impl->pool_lock);
+	if (impl->n_free_fds < MAX_FREE_FDS) {
+		impl->free_fds[impl->n_free_fds++] = fd;
+		fd = -1;
+	}
+	pthread_mutex_unlock(&impl->pool_lock);
+
+	if (fd != -1)
+		close(fd);
+}
+
+#ifdef HAVE_IO_URING
+static int loop_iterate_uring(struct impl *impl, int timeout)
+{
+	int res;
+
+	spa_hook_list_call(&impl->hooks_list, struct spa_loop_control_hooks, before);
+
+	res = uring_wait(impl->uring, timeout);
+
+	spa_hook_list_call(&impl->hooks_list, struct spa_loop_control_hooks, after);
+
+	if (SPA_UNLIKELY(res < 0))
+		return res;
+
+	uring_dispatch(impl->uring);
+	free_destroyed(impl);
+
+	return res;
+}
+#endif
+
+/* like the dispatch in loop_iterate but the epoll data are the profiles
+ * of the sources */
+static void dispatch_profile(struct impl *impl, struct epoll_event *ep, int nfds)
+{
+	uint64_t wakeup = get_time_ns(), start, end;
+	int i;
+
+	for (i = 0; i < nfds; i++) {
+		struct source_profile *prof = ep[i].data.ptr;
+		if (prof->source)
+			prof->source->rmask = spa_epoll_to_io(ep[i].events);
+	}
+	for (i = 0; i < nfds; i++) {
+		struct source_profile *prof = ep[i].data.ptr;
+		struct spa_source *s = prof->source;
+
+		if (s && s->rmask && s->fd != -1) {
+			start = get_time_ns();
+			s->func(s);
+			end = get_time_ns();
+			profile_update(prof, start - wakeup, end - start);
+		}
+	}
+}
+
+static int loop_get_stats(struct spa_loop_control *ctrl, uint32_t *index,
+			  struct spa_loop_source_stats *stats)
+{
+	struct impl *impl = SPA_CONTAINER_OF(ctrl, struct impl, control);
+	struct source_profile *prof;
+	struct spa_list *start;
+	uint32_t i;
+	int res = 0;
+
+	if (!impl->profile)
+		return -ENOTSUP;
+
+	pthread_mutex_lock(&impl->pool_lock);
+	/* continue after the last profile when the sources are walked in
+	 * order, so that getting all of them is not quadratic */
+	if (impl->stats_last != NULL && *index == impl->stats_index + 1) {
+		start = &impl->stats_last->link;
+		i = *index;
+	} else {
+		start = &impl->profile_list;
+		i = 0;
+	}
+	spa_list_for_each_next(prof, &impl->profile_list, start, link) {
+		if (i++ == *index) {
+			*stats = prof->stats;
+			impl->stats_last = prof;
+			impl->stats_index = *index;
+			(*index)++;
+			res = 1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&impl->pool_lock);
+
+	return res;
+}
+
+/* make room for an event of every source, up to MAX_EVENTS */
+static void ensure_events(struct impl *impl)
+{
+	uint32_t n_sources = __atomic_load_n(&impl->n_sources, __ATOMIC_RELAXED), max;
+	struct epoll_event *events;
+
+	if (SPA_LIKELY(n_sources <= impl->max_events || impl->max_events >= MAX_EVENTS))
+		return;
+
+	for (max = impl->max_events; max < n_sources && max < MAX_EVENTS; max <<= 1);
+
+	events = realloc(impl->events, max * sizeof(struct epoll_event));
+	if (events == NULL)
+		return;
+
+	impl->events = events;
+	impl->max_events = max;
+}
+
+static int compare_events(const void *p1, const void *p2)
+{
+	const struct spa_source *s1 = ((const struct epoll_event *) p1)->data.ptr;
+	const struct spa_source *s2 = ((const struct epoll_event *) p2)->data.ptr;
+	return s2->priority - s1->priority;
+}
+
+static int compare_profile_events(const void *p1, const void *p2)
+{
+	const struct source_profile *s1 = ((const struct epoll_event *) p1)->data.ptr;
+	const struct source_profile *s2 = ((const struct epoll_event *) p2)->data.ptr;
+	return (s2->source ? s2->source->priority : 0) - (s1->source ? s1->source->priority : 0);
+}
+
+/* order the events on the priority of their sources, usually all the
+ * sources have the same priority and nothing needs to be done */
+static void sort_events(struct impl *impl, struct epoll_event *ep, int nfds)
+{
+	int (*compare) (const void *, const void *);
+	int i;
+
+	compare = impl->profile ? compare_profile_events : compare_events;
+
+	for (i = 1; i < nfds; i++) {
+		if (compare(&ep[i - 1], &ep[i]) != 0)
+			break;
+	}
+	if (i < nfds)
+		qsort(ep, nfds, sizeof(struct epoll_event), compare);
+}
+
 static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
 {
 	struct impl *impl = SPA_CONTAINER_OF(ctrl, struct impl, control);
-	struct epoll_event ep[32];
+	struct epoll_event *ep;
 	int i, nfds, save_errno = 0;
-	struct source_impl *source, *tmp;
+
+#ifdef HAVE_IO_URING
+	if (impl->uring)
+		return loop_iterate_uring(impl, timeout);
+#endif
+	ensure_events(impl);
+	ep = impl->events;
 
 	spa_hook_list_call(&impl->hooks_list, struct spa_loop_control_hooks, before);
 
-	if (SPA_UNLIKELY((nfds = epoll_wait(impl->epoll_fd, ep, SPA_N_ELEMENTS(ep), timeout)) < 0))
+	if (SPA_UNLIKELY((nfds = epoll_wait(impl->epoll_fd, ep, impl->max_events, timeout)) < 0))
 		save_errno = errno;
 
 	spa_hook_list_call(&impl->hooks_list, struct spa_loop_control_hooks, after);
 
 	if (SPA_UNLIKELY(nfds < 0))
-		return save_errno;
+		return -save_errno;
+
+	if (nfds > 1)
+		sort_events(impl, ep, nfds);
+
+	if (SPA_UNLIKELY(impl->profile)) {
+		dispatch_profile(impl, ep, nfds);
+		free_destroyed(impl);
+		return nfds;
+	}
 
 	/* first we set all the rmasks, then call the callbacks. The reason is that
 	 * some callback might also want to look at other sources it manages and
@@ -346,12 +881,9 @@ static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
 			s->func(s);
 		}
 	}
-	spa_list_for_each_safe(source, tmp, &impl->destroy_list, link)
-		free(source);
+	free_destroyed(impl);
 
-	spa_list_init(&impl->destroy_list);
-
-	return 0;
+	return nfds;
 }
 
 static void source_io_func(struct spa_source *source)
@@ -368,7 +900,7 @@ static struct spa_source *loop_add_io(struct spa_loop_utils *utils,
 	struct impl *impl = SPA_CONTAINER_OF(utils, struct impl, utils);
 	struct source_impl *source;
 
-	source = calloc(1, sizeof(struct source_impl));
+	source = alloc_source(impl);
 	if (source == NULL)
 		return NULL;
 
@@ -407,14 +939,14 @@ static struct spa_source *loop_add_idle(struct spa_loop_utils *utils,
 	struct impl *impl = SPA_CONTAINER_OF(utils, struct impl, utils);
 	struct source_impl *source;
 
-	source = calloc(1, sizeof(struct source_impl));
+	source = alloc_source(impl);
 	if (source == NULL)
 		return NULL;
 
 	source->source.loop = &impl->loop;
 	source->source.func = source_idle_func;
 	source->source.data = data;
-	source->source.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	source->source.fd = get_eventfd(impl);
 	source->impl = impl;
 	source->close = true;
 	source->source.mask = SPA_IO_IN;
@@ -466,14 +998,14 @@ static struct spa_source *loop_add_event(struct spa_loop_utils *utils,
 	struct impl *impl = SPA_CONTAINER_OF(utils, struct impl, utils);
 	struct source_impl *source;
 
-	source = calloc(1, sizeof(struct source_impl));
+	source = alloc_source(impl);
 	if (source == NULL)
 		return NULL;
 
 	source->source.loop = &impl->loop;
 	source->source.func = source_event_func;
 	source->source.data = data;
-	source->source.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	source->source.fd = get_eventfd(impl);
 	source->source.mask = SPA_IO_IN;
 	source->impl = impl;
 	source->close = true;
@@ -496,16 +1028,145 @@ static void loop_signal_event(struct spa_source *source)
 				source, source->fd, strerror(errno));
 }
 
-static void source_timer_func(struct spa_source *source)
+/* the timer heap, called with timer_lock */
+static inline void heap_set(struct impl *impl, uint32_t index, struct source_impl *s)
 {
-	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
-	uint64_t expirations;
+	impl->timers[index] = s;
+	s->heap_index = index;
+}
 
-	if (read(source->fd, &expirations, sizeof(uint64_t)) != sizeof(uint64_t))
-		spa_log_warn(impl->impl->log, NAME " %p: failed to read timer fd %d: %s",
-				source, source->fd, strerror(errno));
+static void heap_up(struct impl *impl, uint32_t index)
+{
+	struct source_impl *s = impl->timers[index];
+
+	while (index > 0) {
+		uint32_t parent = (index - 1) / 2;
+		if (impl->timers[parent]->expire <= s->expire)
+			break;
+		heap_set(impl, index, impl->timers[parent]);
+		index = parent;
+	}
+	heap_set(impl, index, s);
+}
+
+static void heap_down(struct impl *impl, uint32_t index)
+{
+	struct source_impl *s = impl->timers[index];
+
+	while (true) {
+		uint32_t child = index * 2 + 1;
+		if (child >= impl->n_timers)
+			break;
+		if (child + 1 < impl->n_timers &&
+		    impl->timers[child + 1]->expire < impl->timers[child]->expire)
+			child++;
+		if (s->expire <= impl->timers[child]->expire)
+			break;
+		heap_set(impl, index, impl->timers[child]);
+		index = child;
+	}
+	heap_set(impl, index, s);
+}
+
+static int heap_insert(struct impl *impl, struct source_impl *s)
+{
+	if (impl->n_timers == impl->max_timers) {
+		uint32_t max = SPA_MAX(impl->max_timers * 2, 16u);
+		struct source_impl **timers = realloc(impl->timers, max * sizeof(*timers));
+		if (timers == NULL)
+			return -ENOMEM;
+		impl->timers = timers;
+		impl->max_timers = max;
+	}
+	impl->timers[impl->n_timers] = s;
+	s->armed = true;
+	heap_up(impl, impl->n_timers++);
+	return 0;
+}
+
+static void heap_remove(struct impl *impl, struct source_impl *s)
+{
+	uint32_t index = s->heap_index;
+	struct source_impl *last = impl->timers[--impl->n_timers];
+
+	s->armed = false;
+	if (last == s)
+		return;
+
+	heap_set(impl, index, last);
+	if (index > 0 && impl->timers[(index - 1) / 2]->expire > last->expire)
+		heap_up(impl, index);
+	else
+		heap_down(impl, index);
+}
+
+/* arm the timerfd for the first timer, only when it changed */
+static void arm_timers(struct impl *impl)
+{
+	struct itimerspec its;
+	uint64_t expire = impl->n_timers > 0 ? impl->timers[0]->expire : 0;
+
+	if (expire == impl->timer_armed)
+		return;
+
+	spa_zero(its);
+	its.it_value.tv_sec = expire / SPA_NSEC_PER_SEC;
+	its.it_value.tv_nsec = expire % SPA_NSEC_PER_SEC;
+	/* an expiration of 0 would disarm the timer */
+	if (impl->n_timers > 0 && expire == 0)
+		its.it_value.tv_nsec = 1;
+
+	if (timerfd_settime(impl->timer_source.fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+		spa_log_warn(impl->log, NAME " %p: failed to arm timer fd: %s",
+				impl, strerror(errno));
+	impl->timer_armed = expire;
+}
+
+/* dispatch all expired timers, the callbacks can add, update and destroy
+ * timers so they are called without the lock */
+static void on_timers(struct spa_source *source)
+{
+	struct impl *impl = source->data;
+	uint64_t expirations, now;
+
+	if (read(source->fd, &expirations, sizeof(uint64_t)) != sizeof(uint64_t) &&
+	    errno != EAGAIN)
+		spa_log_warn(impl->log, NAME " %p: failed to read timer fd %d: %s",
+				impl, source->fd, strerror(errno));
+
+	now = get_time_ns();
+
+	pthread_mutex_lock(&impl->timer_lock);
+	while (impl->n_timers > 0 && impl->timers[0]->expire <= now) {
+		struct source_impl *s = impl->timers[0];
+		struct source_profile *prof = s->profile;
+		spa_source_timer_func_t func = s->func.timer;
+		void *data = s->source.data;
+		uint64_t expire = s->expire;
+
+		if (s->interval > 0) {
+			expirations = (now - s->expire) / s->interval + 1;
+			s->expire += expirations * s->interval;
+			heap_down(impl, 0);
+		} else {
+			expirations = 1;
+			heap_remove(impl, s);
+		}
+		pthread_mutex_unlock(&impl->timer_lock);
+
+		if (SPA_UNLIKELY(prof)) {
+			uint64_t start = get_time_ns();
+			func(data, expirations);
+			profile_update(prof, start > expire ? start - expire : 0,
+					get_time_ns() - start);
+		} else {
+			func(data, expirations);
+		}
 
-	impl->func.timer(source->data, expirations);
+		pthread_mutex_lock(&impl->timer_lock);
+	}
+	arm_timers(impl);
+	pthread_mutex_unlock(&impl->timer_lock);
 }
 
 static struct spa_source *loop_add_timer(struct spa_loop_utils *utils,
@@ -514,20 +1175,21 @@ static struct spa_source *loop_add_timer(struct spa_loop_utils *utils,
 	struct impl *impl = SPA_CONTAINER_OF(utils, struct impl, utils);
 	struct source_impl *source;
 
-	source = calloc(1, sizeof(struct source_impl));
+	source = alloc_source(impl);
 	if (source == NULL)
 		return NULL;
 
 	source->source.loop = &impl->loop;
-	source->source.func = source_timer_func;
 	source->source.data = data;
-	source->source.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-	source->source.mask = SPA_IO_IN;
+	source->source.fd = -1;
 	source->impl = impl;
-	source->close = true;
 	source->func.timer = func;
 
-	spa_loop_add_source(&impl->loop, &source->source);
+	if (impl->profile &&
+	    (source->profile = add_profile(impl, &source->source, func)) == NULL) {
+		free_source(impl, source);
+		return NULL;
+	}
 
 	spa_list_insert(&impl->source_list, &source->link);
 
@@ -538,25 +1200,35 @@ static int
 loop_update_timer(struct spa_source *source,
 		  struct timespec *value, struct timespec *interval, bool absolute)
 {
-	struct itimerspec its;
-	int flags = 0;
+	struct source_impl *s = SPA_CONTAINER_OF(source, struct source_impl, source);
+	struct impl *impl = s->impl;
+	uint64_t expire = 0;
+	int res = 0;
 
-	spa_zero(its);
 	if (value) {
-		its.it_value = *value;
+		expire = SPA_TIMESPEC_TO_TIME(value);
 	} else if (interval) {
-		its.it_value = *interval;
+		expire = SPA_TIMESPEC_TO_TIME(interval);
 		absolute = true;
 	}
-	if (interval)
-		its.it_interval = *interval;
-	if (absolute)
-		flags |= TFD_TIMER_ABSTIME;
+	if (expire != 0 && !absolute)
+		expire += get_time_ns();
 
-	if (timerfd_settime(source->fd, flags, &its, NULL) < 0)
-		return errno;
+	pthread_mutex_lock(&impl->timer_lock);
+	s->interval = interval ? SPA_TIMESPEC_TO_TIME(interval) : 0;
 
-	return 0;
+	if (s->armed)
+		heap_remove(impl, s);
+
+	/* like timerfd, a value of 0 disarms the timer */
+	if (expire != 0) {
+		s->expire = expire;
+		res = heap_insert(impl, s);
+	}
+	arm_timers(impl);
+	pthread_mutex_unlock(&impl->timer_lock);
+
+	return res;
 }
 
 static void source_signal_func(struct spa_source *source)
@@ -581,7 +1253,7 @@ static struct spa_source *loop_add_signal(struct spa_loop_utils *utils,
 	struct source_impl *source;
 	sigset_t mask;
 
-	source = calloc(1, sizeof(struct source_impl));
+	source = alloc_source(impl);
 	if (source == NULL)
 		return NULL;
 
@@ -614,14 +1286,28 @@ static void loop_destroy_source(struct spa_source *source)
 
 	spa_list_remove(&impl->link);
 
+	pthread_mutex_lock(&loop_impl->timer_lock);
+	if (impl->armed) {
+		heap_remove(loop_impl, impl);
+		arm_timers(loop_impl);
+	}
+	pthread_mutex_unlock(&loop_impl->timer_lock);
+	if (impl->profile)
+		remove_profile(loop_impl, impl->profile);
+
 	spa_loop_remove_source(source->loop, source);
 
 	if (source->fd != -1 && impl->close) {
-		close(source->fd);
+		if (source->func == source_event_func || source->func == source_idle_func)
+			release_eventfd(loop_impl, source->fd);
+		else
+			close(source->fd);
 		source->fd = -1;
 	}
 
+	pthread_mutex_lock(&loop_impl->pool_lock);
 	spa_list_insert(&loop_impl->destroy_list, &impl->link);
+	pthread_mutex_unlock(&loop_impl->pool_lock);
 }
 
 static const struct spa_loop impl_loop = {
@@ -639,6 +1325,7 @@ static const struct spa_loop_control impl_loop_control = {
 	loop_enter,
 	loop_leave,
 	loop_iterate,
+	loop_get_stats,
 };
 
 static const struct spa_loop_utils impl_loop_utils = {
@@ -680,6 +1367,9 @@ static int impl_clear(struct spa_handle *handle)
 {
 	struct impl *impl;
 	struct source_impl *source, *tmp;
+	struct source_slab *slab;
+	struct source_profile *prof, *ptmp;
+	struct invoke_item *item;
 
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
 
@@ -687,11 +1377,36 @@ static int impl_clear(struct spa_handle *handle)
 
 	spa_list_for_each_safe(source, tmp, &impl->source_list, link)
 		loop_destroy_source(&source->source);
-	spa_list_for_each_safe(source, tmp, &impl->destroy_list, link)
-		free(source);
+	free_destroyed(impl);
 
-	close(impl->ack_fd);
+	while ((item = queue_pop(impl)) != NULL) {
+		if (!item->block)
+			free_item(impl, item);
+	}
+	spa_loop_remove_source(&impl->loop, &impl->timer_source);
+	close(impl->timer_source.fd);
+	free(impl->timers);
+
+	spa_list_for_each_safe(prof, ptmp, &impl->profile_list, link)
+		remove_profile(impl, prof);
+	free_destroyed(impl);
+
+	while (impl->n_free_fds > 0)
+		close(impl->free_fds[--impl->n_free_fds]);
+	while ((slab = impl->slabs) != NULL) {
+		impl->slabs = slab->next;
+		free(slab);
+	}
+	pthread_mutex_destroy(&impl->pool_lock);
+	pthread_mutex_destroy(&impl->timer_lock);
+
+#ifdef HAVE_IO_URING
+	if (impl->uring)
+		uring_destroy(impl->uring);
+	else
+#endif
 	close(impl->epoll_fd);
+	free(impl->events);
 
 	return 0;
 }
@@ -704,6 +1419,7 @@ impl_init(const struct spa_handle_factory *factory,
 	  uint32_t n_support)
 {
 	struct impl *impl;
+	const char *str;
 	uint32_t i;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
@@ -729,18 +1445,65 @@ impl_init(const struct spa_handle_factory *factory,
 	}
 	init_type(&impl->type, impl->map);
 
-	impl->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
-	if (impl->epoll_fd == -1)
-		return errno;
+	impl->epoll_fd = -1;
+	if (info && (str = spa_dict_lookup(info, SPA_LOOP_INFO_BACKEND)) &&
+	    strcmp(str, "io_uring") == 0) {
+#ifdef HAVE_IO_URING
+		impl->uring = uring_new(impl->log, URING_ENTRIES);
+		if (impl->uring == NULL)
+			spa_log_warn(impl->log, NAME " %p: io_uring not available, using epoll", impl);
+#else
+		spa_log_warn(impl->log, NAME " %p: built without io_uring, using epoll", impl);
+#endif
+	}
+#ifdef HAVE_IO_URING
+	if (impl->uring == NULL)
+#endif
+	{
+		impl->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (impl->epoll_fd == -1)
+			return errno;
+
+		impl->events = malloc(MIN_EVENTS * sizeof(struct epoll_event));
+		if (impl->events == NULL) {
+			close(impl->epoll_fd);
+			return -ENOMEM;
+		}
+		impl->max_events = MIN_EVENTS;
+	}
+
+	if (info && (str = spa_dict_lookup(info, SPA_LOOP_INFO_PROFILE)) &&
+	    (strcmp(str, "true") == 0 || atoi(str) == 1))
+		impl->profile = true;
+#ifdef HAVE_IO_URING
+	if (impl->profile && impl->uring) {
+		spa_log_warn(impl->log, NAME " %p: profiling is not supported with io_uring", impl);
+		impl->profile = false;
+	}
+#endif
 
 	spa_list_init(&impl->source_list);
 	spa_list_init(&impl->destroy_list);
+	spa_list_init(&impl->free_list);
+	spa_list_init(&impl->profile_list);
+	spa_list_init(&impl->profile_destroy_list);
 	spa_hook_list_init(&impl->hooks_list);
+	pthread_mutex_init(&impl->pool_lock, NULL);
+	pthread_mutex_init(&impl->timer_lock, NULL);
 
-	spa_ringbuffer_init(&impl->buffer);
+	impl->stub.next = NULL;
+	impl->head = impl->tail = &impl->stub;
+	for (i = 0; i < INVOKE_ITEMS; i++)
+		impl->slots[i].item.free_next = i + 1 < INVOKE_ITEMS ? i + 1 : SPA_ID_INVALID;
+	impl->free_slots = 0;
 
 	impl->wakeup = spa_loop_utils_add_event(&impl->utils, wakeup_func, impl);
-	impl->ack_fd = eventfd(0, EFD_CLOEXEC);
+
+	impl->timer_source.func = on_timers;
+	impl->timer_source.data = impl;
+	impl->timer_source.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	impl->timer_source.mask = SPA_IO_IN;
+	spa_loop_add_source(&impl->loop, &impl->timer_source);
 
 	spa_log_info(impl->log, NAME " %p: initialized", impl);
 
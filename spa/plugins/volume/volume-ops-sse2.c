@@ -0,0 +1,129 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <math.h>
+#include <emmintrin.h>
+
+#include "volume-ops.h"
+
+/* the gains repeated over a multiple of 4 samples so that every vector of
+ * samples has a vector of gains, returns the number of gains */
+static uint32_t
+gain_pattern(float *pattern, const float *gains, uint32_t n_channels)
+{
+	uint32_t i, len = n_channels;
+
+	while (len % 4)
+		len += n_channels;
+	for (i = 0; i < len; i++)
+		pattern[i] = gains[i % n_channels];
+
+	return len;
+}
+
+static void
+apply_s16_sse2(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	float pattern[VOLUME_MAX_CHANNELS * 4] __attribute__ ((aligned (16)));
+	const int16_t *s = src;
+	int16_t *d = dst;
+	uint32_t n, p, len, n_samples = n_frames * n_channels;
+	__m128i in, lo, hi;
+	__m128 g0, g1;
+	long t;
+
+	len = gain_pattern(pattern, gains, n_channels);
+
+	for (n = 0, p = 0; n + 8 <= n_samples; n += 8) {
+		g0 = _mm_load_ps(&pattern[p]);
+		p = p + 4 == len ? 0 : p + 4;
+		g1 = _mm_load_ps(&pattern[p]);
+		p = p + 4 == len ? 0 : p + 4;
+
+		in = _mm_loadu_si128((const __m128i *) &s[n]);
+		lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+		hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+		lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), g0));
+		hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), g1));
+		_mm_storeu_si128((__m128i *) &d[n], _mm_packs_epi32(lo, hi));
+	}
+	for (; n < n_samples; n++) {
+		t = lrintf(s[n] * gains[n % n_channels]);
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+apply_s32_sse2(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	float pattern[VOLUME_MAX_CHANNELS * 4] __attribute__ ((aligned (16)));
+	const int32_t *s = src;
+	int32_t *d = dst;
+	uint32_t n, p, len, n_samples = n_frames * n_channels;
+	__m128d min = _mm_set1_pd(INT32_MIN), max = _mm_set1_pd(INT32_MAX);
+	__m128d lo, hi;
+	__m128i in;
+	__m128 g;
+	double t;
+
+	len = gain_pattern(pattern, gains, n_channels);
+
+	for (n = 0, p = 0; n + 4 <= n_samples; n += 4) {
+		g = _mm_load_ps(&pattern[p]);
+		p = p + 4 == len ? 0 : p + 4;
+
+		in = _mm_loadu_si128((const __m128i *) &s[n]);
+		lo = _mm_mul_pd(_mm_cvtepi32_pd(in), _mm_cvtps_pd(g));
+		hi = _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(in, _MM_SHUFFLE(3, 2, 3, 2))),
+				_mm_cvtps_pd(_mm_movehl_ps(g, g)));
+		lo = _mm_min_pd(_mm_max_pd(lo, min), max);
+		hi = _mm_min_pd(_mm_max_pd(hi, min), max);
+		_mm_storeu_si128((__m128i *) &d[n],
+				 _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi)));
+	}
+	for (; n < n_samples; n++) {
+		t = (double) s[n] * gains[n % n_channels];
+		d[n] = lrint(SPA_CLAMP(t, (double) INT32_MIN, (double) INT32_MAX));
+	}
+}
+
+static void
+apply_f32_sse2(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	float pattern[VOLUME_MAX_CHANNELS * 4] __attribute__ ((aligned (16)));
+	const float *s = src;
+	float *d = dst;
+	uint32_t n, p, len, n_samples = n_frames * n_channels;
+
+	len = gain_pattern(pattern, gains, n_channels);
+
+	for (n = 0, p = 0; n + 4 <= n_samples; n += 4) {
+		_mm_storeu_ps(&d[n], _mm_mul_ps(_mm_loadu_ps(&s[n]), _mm_load_ps(&pattern[p])));
+		p = p + 4 == len ? 0 : p + 4;
+	}
+	for (; n < n_samples; n++)
+		d[n] = s[n] * gains[n % n_channels];
+}
+
+void spa_volume_init_ops_sse2(struct spa_volume_ops *ops)
+{
+	ops->apply[VOL_FMT_S16] = apply_s16_sse2;
+	ops->apply[VOL_FMT_S32] = apply_s32_sse2;
+	ops->apply[VOL_FMT_F32] = apply_f32_sse2;
+}
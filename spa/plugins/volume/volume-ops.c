@@ -0,0 +1,277 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <math.h>
+
+#include "volume-ops.h"
+
+/* frames of a ramp that are done with the float steps before the gains
+ * are computed again */
+#define RAMP_STEP	128
+
+/* the integer formats round to nearest like the vector conversions do and
+ * S32 goes through doubles to keep all the bits */
+static inline int16_t
+scale_s16(int16_t s, float g)
+{
+	long t = lrintf(s * g);
+	return SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+}
+
+static inline int32_t
+scale_s32(int32_t s, float g)
+{
+	double t = (double) s * g;
+	t = SPA_CLAMP(t, (double) INT32_MIN, (double) INT32_MAX);
+	return lrint(t);
+}
+
+static void
+apply_s16(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			d[c] = scale_s16(s[c], gains[c]);
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+static void
+apply_s32(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			d[c] = scale_s32(s[c], gains[c]);
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+static void
+apply_f32(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	const float *s = src;
+	float *d = dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			d[c] = s[c] * gains[c];
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+static void
+ramp_s16(void *dst, const void *src, float *gains, const float *mul, const float *add,
+	 uint32_t n_channels, uint32_t n_frames)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++) {
+			d[c] = scale_s16(s[c], gains[c]);
+			gains[c] = gains[c] * mul[c] + add[c];
+		}
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+static void
+ramp_s32(void *dst, const void *src, float *gains, const float *mul, const float *add,
+	 uint32_t n_channels, uint32_t n_frames)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++) {
+			d[c] = scale_s32(s[c], gains[c]);
+			gains[c] = gains[c] * mul[c] + add[c];
+		}
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+static void
+ramp_f32(void *dst, const void *src, float *gains, const float *mul, const float *add,
+	 uint32_t n_channels, uint32_t n_frames)
+{
+	const float *s = src;
+	float *d = dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++) {
+			d[c] = s[c] * gains[c];
+			gains[c] = gains[c] * mul[c] + add[c];
+		}
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+uint32_t spa_volume_get_cpu_flags(void)
+{
+	uint32_t flags = 0;
+
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		flags |= VOLUME_CPU_FLAG_SSE2;
+#endif
+	return flags;
+}
+
+void spa_volume_get_ops(struct spa_volume_ops *ops, uint32_t cpu_flags)
+{
+	ops->apply[VOL_FMT_S16] = apply_s16;
+	ops->apply[VOL_FMT_S32] = apply_s32;
+	ops->apply[VOL_FMT_F32] = apply_f32;
+	ops->ramp[VOL_FMT_S16] = ramp_s16;
+	ops->ramp[VOL_FMT_S32] = ramp_s32;
+	ops->ramp[VOL_FMT_F32] = ramp_f32;
+
+	/* ramps are short, only the constant gains have vector versions */
+#if defined(HAVE_SSE2)
+	if (cpu_flags & VOLUME_CPU_FLAG_SSE2)
+		spa_volume_init_ops_sse2(ops);
+#endif
+}
+
+int spa_volume_state_init(struct spa_volume_state *state, const struct spa_volume_ops *ops,
+			  uint32_t fmt, uint32_t n_channels)
+{
+	static const uint32_t sample_sizes[] = {
+		[VOL_FMT_S16] = sizeof(int16_t),
+		[VOL_FMT_S32] = sizeof(int32_t),
+		[VOL_FMT_F32] = sizeof(float),
+	};
+	uint32_t c;
+
+	if (fmt >= VOL_FMT_MAX || n_channels == 0 || n_channels > VOLUME_MAX_CHANNELS)
+		return -EINVAL;
+
+	state->apply = ops->apply[fmt];
+	state->ramp = ops->ramp[fmt];
+	state->sample_size = sample_sizes[fmt];
+	state->n_channels = n_channels;
+
+	for (c = 0; c < n_channels; c++)
+		state->gains[c] = state->start[c] = state->target[c] = 1.0f;
+	state->curve = VOLUME_CURVE_LINEAR;
+	state->ramp_len = state->ramp_pos = 0;
+
+	return 0;
+}
+
+void spa_volume_state_set(struct spa_volume_state *state, const float *gains,
+			  enum spa_volume_curve curve, uint32_t ramp_frames)
+{
+	uint32_t c, n_channels = state->n_channels;
+
+	memcpy(state->start, state->gains, n_channels * sizeof(float));
+	memcpy(state->target, gains, n_channels * sizeof(float));
+	state->curve = curve;
+	state->ramp_len = ramp_frames;
+	state->ramp_pos = 0;
+
+	if (ramp_frames == 0) {
+		memcpy(state->gains, gains, n_channels * sizeof(float));
+		return;
+	}
+	for (c = 0; c < n_channels; c++)
+		if (state->start[c] != state->target[c])
+			return;
+
+	/* nothing to ramp */
+	state->ramp_len = 0;
+}
+
+/* set the gains to their exact value at the current position of the ramp
+ * and get the per frame steps from there, so that the rounding errors of
+ * the steps don't pile up */
+static void
+ramp_setup(struct spa_volume_state *state, float *mul, float *add)
+{
+	uint32_t c;
+	double pos = (double) state->ramp_pos / state->ramp_len;
+
+	for (c = 0; c < state->n_channels; c++) {
+		double from = state->start[c], to = state->target[c];
+
+		if (state->curve == VOLUME_CURVE_EXPONENTIAL) {
+			double ratio;
+
+			from = SPA_MAX(from, VOLUME_MIN_GAIN);
+			to = SPA_MAX(to, VOLUME_MIN_GAIN);
+			ratio = to / from;
+
+			state->gains[c] = from * pow(ratio, pos);
+			mul[c] = pow(ratio, 1.0 / state->ramp_len);
+			add[c] = 0.0f;
+		} else {
+			state->gains[c] = from + (to - from) * pos;
+			mul[c] = 1.0f;
+			add[c] = (to - from) / state->ramp_len;
+		}
+	}
+}
+
+void spa_volume_state_process(struct spa_volume_state *state, void *dst, const void *src,
+			      uint32_t n_frames)
+{
+	float mul[VOLUME_MAX_CHANNELS], add[VOLUME_MAX_CHANNELS];
+	uint32_t n, stride = state->sample_size * state->n_channels;
+
+	while (n_frames > 0) {
+		if (state->ramp_pos < state->ramp_len) {
+			n = SPA_MIN(n_frames, state->ramp_len - state->ramp_pos);
+			n = SPA_MIN(n, RAMP_STEP);
+
+			ramp_setup(state, mul, add);
+			state->ramp(dst, src, state->gains, mul, add, state->n_channels, n);
+
+			if ((state->ramp_pos += n) == state->ramp_len)
+				memcpy(state->gains, state->target,
+				       state->n_channels * sizeof(float));
+		} else {
+			n = n_frames;
+			state->apply(dst, src, state->gains, state->n_channels, n);
+		}
+		dst = SPA_MEMBER(dst, n * stride, void);
+		src = SPA_MEMBER(src, n * stride, void);
+		n_frames -= n;
+	}
+}
@@ -0,0 +1,94 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+
+#define VOLUME_MAX_CHANNELS	64
+
+/** the lowest gain of exponential ramps, about -100dB */
+#define VOLUME_MIN_GAIN		0.00001f
+
+/** apply \a gains, one for each of the \a n_channels, to \a n_frames
+ * interleaved frames */
+typedef void (*volume_func_t) (void *dst, const void *src, const float *gains,
+			       uint32_t n_channels, uint32_t n_frames);
+/** apply \a gains to \a n_frames interleaved frames and update the gains
+ * after every frame with gains[c] = gains[c] * mul[c] + add[c] */
+typedef void (*volume_ramp_func_t) (void *dst, const void *src, float *gains,
+				    const float *mul, const float *add,
+				    uint32_t n_channels, uint32_t n_frames);
+
+enum {
+	VOL_FMT_S16,
+	VOL_FMT_S32,
+	VOL_FMT_F32,
+	VOL_FMT_MAX,
+};
+
+struct spa_volume_ops {
+	volume_func_t apply[VOL_FMT_MAX];
+	volume_ramp_func_t ramp[VOL_FMT_MAX];
+};
+
+#define VOLUME_CPU_FLAG_SSE2	(1 << 0)
+
+/** The VOLUME_CPU_FLAG_ of the cpu we run on */
+uint32_t spa_volume_get_cpu_flags(void);
+
+/** Fill \a ops with the fastest implementations for \a cpu_flags, 0 gives
+ * the C versions */
+void spa_volume_get_ops(struct spa_volume_ops *ops, uint32_t cpu_flags);
+
+void spa_volume_init_ops_sse2(struct spa_volume_ops *ops);
+
+enum spa_volume_curve {
+	VOLUME_CURVE_LINEAR,		/**< gains change by the same amount each frame */
+	VOLUME_CURVE_EXPONENTIAL,	/**< gains change by the same ratio each frame */
+};
+
+/** The gains of a stream and the ramp to new gains */
+struct spa_volume_state {
+	volume_func_t apply;
+	volume_ramp_func_t ramp;
+	uint32_t sample_size;
+	uint32_t n_channels;
+
+	float gains[VOLUME_MAX_CHANNELS];	/**< gains of the next frame */
+	float start[VOLUME_MAX_CHANNELS];	/**< gains at the start of the ramp */
+	float target[VOLUME_MAX_CHANNELS];	/**< gains at the end of the ramp */
+	uint32_t curve;
+	uint32_t ramp_len;			/**< frames in the ramp */
+	uint32_t ramp_pos;			/**< frames done of the ramp */
+};
+
+/** Set up \a state for \a n_channels of VOL_FMT_ \a fmt with unity gain */
+int spa_volume_state_init(struct spa_volume_state *state, const struct spa_volume_ops *ops,
+			  uint32_t fmt, uint32_t n_channels);
+
+/** Go from the current gains to \a gains in \a ramp_frames frames along
+ * \a curve, a ramp in progress continues from where it is */
+void spa_volume_state_set(struct spa_volume_state *state, const float *gains,
+			  enum spa_volume_curve curve, uint32_t ramp_frames);
+
+/** Process \a n_frames from \a src into \a dst, which can be the same */
+void spa_volume_state_process(struct spa_volume_state *state, void *dst, const void *src,
+			      uint32_t n_frames);
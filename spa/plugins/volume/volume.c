@@ -33,20 +33,31 @@
 
 #include <lib/pod.h>
 
+#include "volume-ops.h"
+
 #define NAME "volume"
 
 #define DEFAULT_VOLUME 1.0
 #define DEFAULT_MUTE false
+#define DEFAULT_RAMP_DURATION 512
+#define DEFAULT_RAMP_CURVE VOLUME_CURVE_LINEAR
 
 struct props {
 	double volume;
 	bool mute;
+	float channel_volumes[VOLUME_MAX_CHANNELS];
+	uint32_t n_channel_volumes;
+	int32_t ramp_duration;		/**< frames to go to a new volume */
+	uint32_t ramp_curve;
 };
 
 static void reset_props(struct props *props)
 {
 	props->volume = DEFAULT_VOLUME;
 	props->mute = DEFAULT_MUTE;
+	props->n_channel_volumes = 0;
+	props->ramp_duration = DEFAULT_RAMP_DURATION;
+	props->ramp_curve = DEFAULT_RAMP_CURVE;
 }
 
 #define MAX_BUFFERS     16
@@ -79,6 +90,9 @@ struct type {
 	uint32_t props;
 	uint32_t prop_volume;
 	uint32_t prop_mute;
+	uint32_t prop_channel_volumes;
+	uint32_t prop_ramp_duration;
+	uint32_t prop_ramp_curve;
 	struct spa_type_io io;
 	struct spa_type_param param;
 	struct spa_type_meta meta;
@@ -101,6 +115,9 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
 	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
 	type->prop_mute = spa_type_map_get_id(map, SPA_TYPE_PROPS__mute);
+	type->prop_channel_volumes = spa_type_map_get_id(map, SPA_TYPE_PROPS__channelVolumes);
+	type->prop_ramp_duration = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampDuration);
+	type->prop_ramp_curve = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampCurve);
 	spa_type_io_map(map, &type->io);
 	spa_type_param_map(map, &type->param);
 	spa_type_meta_map(map, &type->meta);
@@ -125,6 +142,7 @@ struct impl {
 	struct spa_log *log;
 
 	struct props props;
+	bool props_changed;
 
 	const struct spa_node_callbacks *callbacks;
 	void *callbacks_data;
@@ -132,6 +150,9 @@ struct impl {
 	struct spa_audio_info current_format;
 	int bpf;
 
+	struct spa_volume_ops ops;
+	struct spa_volume_state state;
+
 	struct port in_ports[1];
 	struct port out_ports[1];
 
@@ -195,6 +216,32 @@ static int impl_node_enum_params(struct spa_node *node,
 				":", t->param.propName, "s", "Mute",
 				":", t->param.propType, "b", p->mute);
 			break;
+		case 2:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId,   "I", t->prop_channel_volumes,
+				":", t->param.propName, "s", "The volume of each channel",
+				":", t->param.propType, "a", (int) sizeof(float), SPA_POD_TYPE_FLOAT,
+								p->n_channel_volumes,
+								p->channel_volumes);
+			break;
+		case 3:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId,   "I", t->prop_ramp_duration,
+				":", t->param.propName, "s", "Frames to go to a new volume",
+				":", t->param.propType, "ir", p->ramp_duration, 2, 0, INT32_MAX);
+			break;
+		case 4:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId,   "I", t->prop_ramp_curve,
+				":", t->param.propName, "s", "The shape of the volume ramps",
+				":", t->param.propType, "i", p->ramp_curve,
+				":", t->param.propLabels, "[-i",
+					"i", VOLUME_CURVE_LINEAR, "s", "Linear",
+					"i", VOLUME_CURVE_EXPONENTIAL, "s", "Exponential", "]");
+			break;
 		default:
 			return 0;
 		}
@@ -204,8 +251,13 @@ static int impl_node_enum_params(struct spa_node *node,
 		case 0:
 			param = spa_pod_builder_object(&b,
 				id, t->props,
-				":", t->prop_volume, "d", p->volume,
-				":", t->prop_mute,   "b", p->mute);
+				":", t->prop_volume,          "d", p->volume,
+				":", t->prop_mute,            "b", p->mute,
+				":", t->prop_channel_volumes, "a", (int) sizeof(float), SPA_POD_TYPE_FLOAT,
+								p->n_channel_volumes,
+								p->channel_volumes,
+				":", t->prop_ramp_duration,   "i", p->ramp_duration,
+				":", t->prop_ramp_curve,      "i", p->ramp_curve);
 			break;
 		default:
 			return 0;
@@ -235,14 +287,42 @@ static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flag
 
 	if (id == t->param.idProps) {
 		struct props *p = &this->props;
+		struct spa_pod *channel_volumes = NULL;
 
 		if (param == NULL) {
 			reset_props(p);
+			this->props_changed = true;
 			return 0;
 		}
 		spa_pod_object_parse(param,
-			":", t->prop_volume, "?d", &p->volume,
-			":", t->prop_mute,   "?b", &p->mute, NULL);
+			":", t->prop_volume,          "?d", &p->volume,
+			":", t->prop_mute,            "?b", &p->mute,
+			":", t->prop_channel_volumes, "?P", &channel_volumes,
+			":", t->prop_ramp_duration,   "?i", &p->ramp_duration,
+			":", t->prop_ramp_curve,      "?i", &p->ramp_curve, NULL);
+
+		if (channel_volumes != NULL &&
+		    SPA_POD_TYPE(channel_volumes) == SPA_POD_TYPE_ARRAY) {
+			struct spa_pod_array_body *body = SPA_POD_BODY(channel_volumes);
+			float *v;
+
+			if (body->child.type != SPA_POD_TYPE_FLOAT)
+				return -EINVAL;
+
+			p->n_channel_volumes = 0;
+			SPA_POD_ARRAY_BODY_FOREACH(body, SPA_POD_BODY_SIZE(channel_volumes), v) {
+				if (p->n_channel_volumes == VOLUME_MAX_CHANNELS)
+					break;
+				p->channel_volumes[p->n_channel_volumes++] = *v;
+			}
+		}
+		p->ramp_duration = SPA_MAX(p->ramp_duration, 0);
+		if (p->ramp_curve > VOLUME_CURVE_EXPONENTIAL)
+			p->ramp_curve = DEFAULT_RAMP_CURVE;
+
+		/* picked up by the next process, so that the ramp starts at
+		 * the gains that are playing */
+		this->props_changed = true;
 	}
 	else
 		return -ENOENT;
@@ -375,8 +455,9 @@ static int port_enum_formats(struct spa_node *node,
 			"I", t->media_type.audio,
 			"I", t->media_subtype.raw,
 			":", t->format_audio.format,  "Ieu", t->audio_format.S16,
-									2, t->audio_format.S16,
-								           t->audio_format.S32,
+									3, t->audio_format.S16,
+									   t->audio_format.S32,
+									   t->audio_format.F32,
 			":", t->format_audio.rate,    "iru", 44100,	2, 1, INT32_MAX,
 			":", t->format_audio.channels,"iru", 2,		2, 1, INT32_MAX);
 		break;
@@ -540,6 +621,21 @@ static int clear_buffers(struct impl *this, struct port *port)
 	return 0;
 }
 
+/* go to the gains of the props in \a ramp_frames */
+static void update_volume(struct impl *this, uint32_t ramp_frames)
+{
+	struct props *p = &this->props;
+	float gains[VOLUME_MAX_CHANNELS];
+	uint32_t c;
+
+	for (c = 0; c < this->state.n_channels; c++) {
+		float v = c < p->n_channel_volumes ? p->channel_volumes[c] : 1.0f;
+		gains[c] = p->mute ? 0.0f : p->volume * v;
+	}
+	spa_volume_state_set(&this->state, gains, p->ramp_curve, ramp_frames);
+	this->props_changed = false;
+}
+
 static int port_set_format(struct spa_node *node,
 			   enum spa_direction direction, uint32_t port_id,
 			   uint32_t flags,
@@ -547,6 +643,8 @@ static int port_set_format(struct spa_node *node,
 {
 	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
 	struct port *port;
+	uint32_t fmt;
+	int res;
 
 	port = GET_PORT(this, direction, port_id);
 
@@ -567,9 +665,25 @@ static int port_set_format(struct spa_node *node,
 		if (spa_format_audio_raw_parse(format, &info.info.raw, &this->type.format_audio) < 0)
 			return -EINVAL;
 
-		this->bpf = 2 * info.info.raw.channels;
+		if (info.info.raw.format == this->type.audio_format.S16)
+			fmt = VOL_FMT_S16;
+		else if (info.info.raw.format == this->type.audio_format.S32)
+			fmt = VOL_FMT_S32;
+		else if (info.info.raw.format == this->type.audio_format.F32)
+			fmt = VOL_FMT_F32;
+		else
+			return -EINVAL;
+
+		if ((res = spa_volume_state_init(&this->state, &this->ops, fmt,
+						 info.info.raw.channels)) < 0)
+			return res;
+
+		this->bpf = this->state.sample_size * info.info.raw.channels;
 		this->current_format = info;
 		port->have_format = true;
+
+		/* a new stream starts at the volume without a ramp */
+		update_volume(this, 0);
 	}
 
 	return 0;
@@ -753,14 +867,14 @@ static struct spa_buffer *find_free_buffer(struct impl *this, struct port *port)
 
 static void do_volume(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
 {
-	uint32_t i, n_samples, n_bytes;
+	uint32_t n_frames, n_bytes;
 	struct spa_data *sd, *dd;
-	int16_t *src, *dst;
-	double volume;
+	void *src, *dst;
 	uint32_t written, towrite, savail, davail;
 	uint32_t sindex, dindex;
 
-	volume = this->props.volume;
+	if (this->props_changed)
+		update_volume(this, this->props.ramp_duration);
 
 	sd = sbuf->datas;
 	dd = dbuf->datas;
@@ -772,21 +886,25 @@ static void do_volume(struct impl *this, struct spa_buffer *dbuf, struct spa_buf
 	davail = dd[0].maxsize - davail;
 
 	towrite = SPA_MIN(savail, davail);
+	towrite -= towrite % this->bpf;
 	written = 0;
 
 	while (written < towrite) {
 		uint32_t soffset = sindex % sd[0].maxsize;
 		uint32_t doffset = dindex % dd[0].maxsize;
 
-		src = SPA_MEMBER(sd[0].data, soffset, int16_t);
-		dst = SPA_MEMBER(dd[0].data, doffset, int16_t);
+		src = SPA_MEMBER(sd[0].data, soffset, void);
+		dst = SPA_MEMBER(dd[0].data, doffset, void);
 
-		n_bytes = SPA_MIN(towrite, sd[0].maxsize - soffset);
+		n_bytes = SPA_MIN(towrite - written, sd[0].maxsize - soffset);
 		n_bytes = SPA_MIN(n_bytes, dd[0].maxsize - doffset);
 
-		n_samples = n_bytes / sizeof(int16_t);
-		for (i = 0; i < n_samples; i++)
-			dst[i] = src[i] * volume;
+		/* the ring only wraps on whole frames */
+		if ((n_frames = n_bytes / this->bpf) == 0)
+			break;
+		n_bytes = n_frames * this->bpf;
+
+		spa_volume_state_process(&this->state, dst, src, n_frames);
 
 		sindex += n_bytes;
 		dindex += n_bytes;
@@ -954,6 +1072,8 @@ impl_init(const struct spa_handle_factory *factory,
 	this->node = impl_node;
 	reset_props(&this->props);
 
+	spa_volume_get_ops(&this->ops, spa_volume_get_cpu_flags());
+
 	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
 	    SPA_PORT_INFO_FLAG_IN_PLACE;
 	spa_list_init(&this->in_ports[0].empty);
@@ -0,0 +1,69 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Compiled once for every scheduler, selected with -DSCHEDULER=<n>.
+ * graph-scheduler2.h, graph-scheduler4.h and graph-scheduler5.h no
+ * longer build against the current graph API and are skipped. */
+
+#if SCHEDULER == 1
+#include <spa/graph/graph-scheduler1.h>
+#elif SCHEDULER == 3
+#include <spa/graph/graph-scheduler3.h>
+#define NO_GRAPH_DATA
+#elif SCHEDULER == 6
+#include <spa/graph/graph-scheduler6.h>
+#elif SCHEDULER == 7
+#include <spa/graph/graph-scheduler7.h>
+#define HAVE_GRAPH_DATA_CLEAR
+#else
+#error "unknown SCHEDULER"
+#endif
+
+#include "bench-graph.h"
+
+#define BENCH_SCHEDULER_NAME(n)	BENCH_SCHEDULER_NAME_(n)
+#define BENCH_SCHEDULER_NAME_(n)	bench_scheduler ## n
+
+static void setup(struct spa_graph *graph, void *data)
+{
+#ifdef NO_GRAPH_DATA
+	spa_graph_set_callbacks(graph, &spa_graph_impl_default, NULL);
+#else
+	spa_graph_data_init(data, graph);
+	spa_graph_set_callbacks(graph, &spa_graph_impl_default, data);
+#endif
+}
+
+static void clear(void *data)
+{
+#ifdef HAVE_GRAPH_DATA_CLEAR
+	spa_graph_data_clear(data);
+#endif
+}
+
+const struct bench_scheduler BENCH_SCHEDULER_NAME(SCHEDULER) = {
+	.name = "scheduler" SPA_STRINGIFY(SCHEDULER),
+#ifdef NO_GRAPH_DATA
+	.data_size = 0,
+#else
+	.data_size = sizeof(struct spa_graph_data),
+#endif
+	.setup = setup,
+	.clear = clear,
+};
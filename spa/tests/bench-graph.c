@@ -0,0 +1,758 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <setjmp.h>
+
+#include <spa/support/log-impl.h>
+#include <spa/support/loop.h>
+#include <spa/support/type-map-impl.h>
+#include <spa/node/node.h>
+#include <spa/node/io.h>
+#include <spa/param/param.h>
+#include <spa/param/format-utils.h>
+
+#include "bench-graph.h"
+
+/* Runs synthetic graphs of fakesrc and fakesink nodes on all graph
+ * schedulers. The nodes in between are simple pass-through nodes that
+ * forward a buffer when all their inputs have one, like the mix and tee
+ * nodes of pipewire ports.
+ *
+ * Each cycle, every source produces a buffer and the graph pushes it to
+ * the sinks. The time of every cycle is measured, so the numbers
+ * include the overhead of clock_gettime. A run is aborted when a cycle
+ * makes too many process calls, some schedulers never finish a cycle
+ * on some graphs. */
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+struct type {
+	uint32_t node;
+	uint32_t format;
+	struct spa_type_io io;
+	struct spa_type_param param;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_command_node command_node;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	spa_type_io_map(map, &type->io);
+	spa_type_param_map(map, &type->param);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_command_node_map(map, &type->command_node);
+}
+
+#define BUFFER_SIZE	64
+#define MAX_CALLS	64	/**< max process calls per node in a cycle */
+
+struct buffer {
+	struct spa_buffer buffer;
+	struct spa_meta metas[1];
+	struct spa_meta_header header;
+	struct spa_data datas[1];
+	struct spa_chunk chunks[1];
+	uint8_t data[BUFFER_SIZE];
+};
+
+struct bench_node {
+	struct spa_node node;		/**< counting wrapper or pass-through */
+	struct spa_node *impl;		/**< fakesrc or fakesink */
+	struct spa_handle *handle;
+
+	struct spa_graph_node gnode;
+	struct spa_graph_port *in;
+	uint32_t n_in;
+	struct spa_graph_port *out;
+	uint32_t n_out;
+
+	struct buffer buffer;
+	struct spa_buffer *buffers[1];
+
+	uint64_t calls;			/**< process calls */
+	uint64_t received;		/**< buffers received by sinks */
+};
+
+struct data {
+	struct spa_type_map *map;
+	struct spa_log *log;
+	struct spa_loop data_loop;
+	struct type type;
+
+	struct spa_support support[4];
+	uint32_t n_support;
+
+	void *hnd;
+
+	struct spa_graph graph;
+	const struct bench_scheduler *scheduler;
+	void *graph_data;
+
+	struct bench_node *nodes;
+	uint32_t n_nodes;
+	struct spa_io_buffers *ios;
+	uint32_t n_ios;
+	struct bench_node **sources;
+	uint32_t n_sources;
+	struct bench_node **sinks;
+	uint32_t n_sinks;
+
+	int64_t *times;
+
+	uint64_t cycle_calls;		/**< process calls left in the cycle */
+	jmp_buf abort_cycle;
+};
+
+struct topology {
+	const char *name;
+	uint32_t (*n_nodes) (uint32_t size);
+	int (*build) (struct data *data, uint32_t size);
+};
+
+static int do_add_source(struct spa_loop *loop, struct spa_source *source)
+{
+	return 0;
+}
+
+static int do_update_source(struct spa_source *source)
+{
+	return 0;
+}
+
+static void do_remove_source(struct spa_source *source)
+{
+}
+
+static int
+do_invoke(struct spa_loop *loop,
+	  spa_invoke_func_t func, uint32_t seq, const void *data, size_t size, bool block, void *user_data)
+{
+	return func(loop, false, seq, data, size, user_data);
+}
+
+static int make_handle(struct data *data, struct bench_node *n, const char *name)
+{
+	int res;
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t i;
+
+	if (data->hnd == NULL) {
+		if ((data->hnd = dlopen("build/spa/plugins/test/libspa-test.so", RTLD_NOW)) == NULL) {
+			printf("can't load libspa-test.so: %s\n", dlerror());
+			return -errno;
+		}
+	}
+	if ((enum_func = dlsym(data->hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return -errno;
+	}
+
+	for (i = 0;;) {
+		const struct spa_handle_factory *factory;
+		void *iface;
+
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			if (res != 0)
+				printf("can't enumerate factories: %s\n", spa_strerror(res));
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		n->handle = calloc(1, factory->size);
+		if ((res = spa_handle_factory_init(factory, n->handle, NULL,
+						   data->support, data->n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return res;
+		}
+		if ((res = spa_handle_get_interface(n->handle, data->type.node, &iface)) < 0) {
+			printf("can't get interface %d\n", res);
+			return res;
+		}
+		n->impl = iface;
+		return 0;
+	}
+	return -EBADF;
+}
+
+static void init_buffer(struct data *data, struct bench_node *n)
+{
+	struct buffer *b = &n->buffer;
+
+	n->buffers[0] = &b->buffer;
+
+	b->buffer.id = 0;
+	b->buffer.metas = b->metas;
+	b->buffer.n_metas = 1;
+	b->buffer.datas = b->datas;
+	b->buffer.n_datas = 1;
+
+	b->metas[0].type = data->type.meta.Header;
+	b->metas[0].data = &b->header;
+	b->metas[0].size = sizeof(b->header);
+
+	b->datas[0].type = data->type.data.MemPtr;
+	b->datas[0].flags = 0;
+	b->datas[0].fd = -1;
+	b->datas[0].mapoffset = 0;
+	b->datas[0].maxsize = BUFFER_SIZE;
+	b->datas[0].data = b->data;
+	b->datas[0].chunk = &b->chunks[0];
+	b->datas[0].chunk->offset = 0;
+	b->datas[0].chunk->size = BUFFER_SIZE;
+	b->datas[0].chunk->stride = 0;
+}
+
+static struct data *current;
+
+static inline void count_call(struct bench_node *n)
+{
+	n->calls++;
+	if (--current->cycle_calls == 0)
+		longjmp(current->abort_cycle, 1);
+}
+
+static int wrap_process_input(struct spa_node *node)
+{
+	struct bench_node *n = SPA_CONTAINER_OF(node, struct bench_node, node);
+	struct spa_io_buffers *io = n->in[0].io;
+
+	count_call(n);
+	if (io->status == SPA_STATUS_HAVE_BUFFER)
+		n->received++;
+	return spa_node_process_input(n->impl);
+}
+
+static int wrap_process_output(struct spa_node *node)
+{
+	struct bench_node *n = SPA_CONTAINER_OF(node, struct bench_node, node);
+
+	count_call(n);
+	return spa_node_process_output(n->impl);
+}
+
+static const struct spa_node wrap_node = {
+	SPA_VERSION_NODE,
+	NULL,
+	.process_input = wrap_process_input,
+	.process_output = wrap_process_output,
+};
+
+static int pass_process_input(struct spa_node *node)
+{
+	struct bench_node *n = SPA_CONTAINER_OF(node, struct bench_node, node);
+	uint32_t i;
+
+	count_call(n);
+	for (i = 0; i < n->n_in; i++) {
+		if (n->in[i].io->status != SPA_STATUS_HAVE_BUFFER)
+			return SPA_STATUS_OK;
+	}
+	/* the buffer ids stay on the inputs so that they are recycled */
+	for (i = 0; i < n->n_in; i++)
+		n->in[i].io->status = SPA_STATUS_NEED_BUFFER;
+	for (i = 0; i < n->n_out; i++) {
+		n->out[i].io->status = SPA_STATUS_HAVE_BUFFER;
+		n->out[i].io->buffer_id = 0;
+	}
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
+static int pass_process_output(struct spa_node *node)
+{
+	struct bench_node *n = SPA_CONTAINER_OF(node, struct bench_node, node);
+
+	/* data is only pushed, nothing to do when pulled */
+	count_call(n);
+	return SPA_STATUS_OK;
+}
+
+static const struct spa_node pass_node = {
+	SPA_VERSION_NODE,
+	NULL,
+	.process_input = pass_process_input,
+	.process_output = pass_process_output,
+};
+
+static struct bench_node *add_node(struct data *data, uint32_t n_in, uint32_t n_out)
+{
+	struct bench_node *n = &data->nodes[data->n_nodes++];
+	uint32_t i;
+
+	n->in = calloc(n_in, sizeof(struct spa_graph_port));
+	n->n_in = n_in;
+	n->out = calloc(n_out, sizeof(struct spa_graph_port));
+	n->n_out = n_out;
+
+	spa_graph_reserve(&data->graph, 1, n_in + n_out);
+	spa_graph_node_init(&n->gnode);
+	spa_graph_node_set_implementation(&n->gnode, &n->node);
+	spa_graph_node_add(&data->graph, &n->gnode);
+
+	for (i = 0; i < n_in; i++) {
+		spa_graph_port_init(&n->in[i], SPA_DIRECTION_INPUT, i, 0, NULL);
+		spa_graph_port_add(&n->gnode, &n->in[i]);
+	}
+	for (i = 0; i < n_out; i++) {
+		spa_graph_port_init(&n->out[i], SPA_DIRECTION_OUTPUT, i, 0, NULL);
+		spa_graph_port_add(&n->gnode, &n->out[i]);
+	}
+	return n;
+}
+
+static struct bench_node *add_fake(struct data *data, const char *name,
+				   enum spa_direction direction)
+{
+	struct bench_node *n;
+	struct spa_pod *format;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[256];
+	struct spa_command cmd = SPA_COMMAND_INIT(data->type.command_node.Start);
+	int res;
+
+	if (direction == SPA_DIRECTION_OUTPUT) {
+		n = add_node(data, 0, 1);
+		data->sources[data->n_sources++] = n;
+	} else {
+		n = add_node(data, 1, 0);
+		data->sinks[data->n_sinks++] = n;
+	}
+	n->node = wrap_node;
+
+	if ((res = make_handle(data, n, name)) < 0)
+		return NULL;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	format = spa_pod_builder_object(&b,
+			0, data->type.format,
+			"I", data->type.media_type.binary,
+			"I", data->type.media_subtype.raw);
+
+	if ((res = spa_node_port_set_param(n->impl, direction, 0,
+					   data->type.param.idFormat, 0, format)) < 0)
+		return NULL;
+
+	init_buffer(data, n);
+	if ((res = spa_node_port_use_buffers(n->impl, direction, 0, n->buffers, 1)) < 0)
+		return NULL;
+
+	if ((res = spa_node_send_command(n->impl, &cmd)) < 0)
+		return NULL;
+
+	return n;
+}
+
+static struct bench_node *add_source(struct data *data)
+{
+	return add_fake(data, "fakesrc", SPA_DIRECTION_OUTPUT);
+}
+
+static struct bench_node *add_sink(struct data *data)
+{
+	return add_fake(data, "fakesink", SPA_DIRECTION_INPUT);
+}
+
+static struct bench_node *add_pass(struct data *data, uint32_t n_in, uint32_t n_out)
+{
+	struct bench_node *n = add_node(data, n_in, n_out);
+	n->node = pass_node;
+	return n;
+}
+
+static void link_nodes(struct data *data,
+		       struct bench_node *out, uint32_t out_port,
+		       struct bench_node *in, uint32_t in_port)
+{
+	struct spa_io_buffers *io = &data->ios[data->n_ios++];
+
+	*io = SPA_IO_BUFFERS_INIT;
+	io->status = SPA_STATUS_NEED_BUFFER;
+
+	out->out[out_port].io = io;
+	in->in[in_port].io = io;
+
+	if (out->impl)
+		spa_node_port_set_io(out->impl, SPA_DIRECTION_OUTPUT, 0,
+				     data->type.io.Buffers, io, sizeof(*io));
+	if (in->impl)
+		spa_node_port_set_io(in->impl, SPA_DIRECTION_INPUT, 0,
+				     data->type.io.Buffers, io, sizeof(*io));
+
+	spa_graph_port_link(&out->out[out_port], &in->in[in_port]);
+}
+
+/* src -> pass x size -> sink */
+static uint32_t chain_n_nodes(uint32_t size)
+{
+	return size + 2;
+}
+
+static int chain_build(struct data *data, uint32_t size)
+{
+	struct bench_node *prev, *n;
+	uint32_t i;
+
+	if ((prev = add_source(data)) == NULL)
+		return -EIO;
+	for (i = 0; i < size; i++) {
+		n = add_pass(data, 1, 1);
+		link_nodes(data, prev, 0, n, 0);
+		prev = n;
+	}
+	if ((n = add_sink(data)) == NULL)
+		return -EIO;
+	link_nodes(data, prev, 0, n, 0);
+	return 0;
+}
+
+/* src x size -> mix -> sink */
+static uint32_t fan_in_n_nodes(uint32_t size)
+{
+	return size + 2;
+}
+
+static int fan_in_build(struct data *data, uint32_t size)
+{
+	struct bench_node *mix, *n;
+	uint32_t i;
+
+	mix = add_pass(data, size, 1);
+	for (i = 0; i < size; i++) {
+		if ((n = add_source(data)) == NULL)
+			return -EIO;
+		link_nodes(data, n, 0, mix, i);
+	}
+	if ((n = add_sink(data)) == NULL)
+		return -EIO;
+	link_nodes(data, mix, 0, n, 0);
+	return 0;
+}
+
+/* src -> tee -> sink x size */
+static uint32_t fan_out_n_nodes(uint32_t size)
+{
+	return size + 2;
+}
+
+static int fan_out_build(struct data *data, uint32_t size)
+{
+	struct bench_node *tee, *n;
+	uint32_t i;
+
+	if ((n = add_source(data)) == NULL)
+		return -EIO;
+	tee = add_pass(data, 1, size);
+	link_nodes(data, n, 0, tee, 0);
+	for (i = 0; i < size; i++) {
+		if ((n = add_sink(data)) == NULL)
+			return -EIO;
+		link_nodes(data, tee, i, n, 0);
+	}
+	return 0;
+}
+
+/* src -> tee -> pass x size -> mix -> sink */
+static uint32_t diamond_n_nodes(uint32_t size)
+{
+	return size + 4;
+}
+
+static int diamond_build(struct data *data, uint32_t size)
+{
+	struct bench_node *tee, *mix, *n;
+	uint32_t i;
+
+	if ((n = add_source(data)) == NULL)
+		return -EIO;
+	tee = add_pass(data, 1, size);
+	link_nodes(data, n, 0, tee, 0);
+	mix = add_pass(data, size, 1);
+	for (i = 0; i < size; i++) {
+		n = add_pass(data, 1, 1);
+		link_nodes(data, tee, i, n, 0);
+		link_nodes(data, n, 0, mix, i);
+	}
+	if ((n = add_sink(data)) == NULL)
+		return -EIO;
+	link_nodes(data, mix, 0, n, 0);
+	return 0;
+}
+
+/* (src -> pass -> sink) x size */
+static uint32_t parallel_n_nodes(uint32_t size)
+{
+	return size * 3;
+}
+
+static int parallel_build(struct data *data, uint32_t size)
+{
+	struct bench_node *src, *pass, *sink;
+	uint32_t i;
+
+	for (i = 0; i < size; i++) {
+		if ((src = add_source(data)) == NULL)
+			return -EIO;
+		pass = add_pass(data, 1, 1);
+		if ((sink = add_sink(data)) == NULL)
+			return -EIO;
+		link_nodes(data, src, 0, pass, 0);
+		link_nodes(data, pass, 0, sink, 0);
+	}
+	return 0;
+}
+
+static const struct topology topologies[] = {
+	{ "chain", chain_n_nodes, chain_build },
+	{ "fan-in", fan_in_n_nodes, fan_in_build },
+	{ "fan-out", fan_out_n_nodes, fan_out_build },
+	{ "diamond", diamond_n_nodes, diamond_build },
+	{ "parallel", parallel_n_nodes, parallel_build },
+};
+
+static const struct bench_scheduler *schedulers[] = {
+	&bench_scheduler1,
+	&bench_scheduler3,
+	&bench_scheduler6,
+	&bench_scheduler7,
+};
+
+static void clear_graph(struct data *data)
+{
+	uint32_t i;
+
+	for (i = 0; i < data->n_nodes; i++) {
+		struct bench_node *n = &data->nodes[i];
+		if (n->handle) {
+			spa_handle_clear(n->handle);
+			free(n->handle);
+		}
+		free(n->in);
+		free(n->out);
+	}
+	free(data->nodes);
+	free(data->ios);
+	free(data->sources);
+	free(data->sinks);
+	if (data->graph_data)
+		data->scheduler->clear(data->graph_data);
+	free(data->graph_data);
+}
+
+static int setup_graph(struct data *data, const struct bench_scheduler *s,
+		       const struct topology *t, uint32_t size)
+{
+	uint32_t n_nodes = t->n_nodes(size);
+
+	/* every node has at most one link on each port */
+	data->nodes = calloc(n_nodes, sizeof(struct bench_node));
+	data->n_nodes = 0;
+	data->ios = calloc(n_nodes * 2, sizeof(struct spa_io_buffers));
+	data->n_ios = 0;
+	data->sources = calloc(n_nodes, sizeof(struct bench_node *));
+	data->n_sources = 0;
+	data->sinks = calloc(n_nodes, sizeof(struct bench_node *));
+	data->n_sinks = 0;
+	data->scheduler = s;
+	data->graph_data = s->data_size ? calloc(1, s->data_size) : NULL;
+
+	spa_graph_init(&data->graph);
+	s->setup(&data->graph, data->graph_data);
+
+	return t->build(data, size);
+}
+
+static inline void run_cycle(struct data *data)
+{
+	uint32_t i;
+
+	data->cycle_calls = MAX_CALLS * data->n_nodes;
+
+	for (i = 0; i < data->n_sources; i++) {
+		struct bench_node *n = data->sources[i];
+		if (spa_node_process_output(&n->node) == SPA_STATUS_HAVE_BUFFER)
+			spa_graph_have_output(&data->graph, &n->gnode);
+	}
+}
+
+static int compare_times(const void *a, const void *b)
+{
+	int64_t ta = *(const int64_t *) a, tb = *(const int64_t *) b;
+	return ta < tb ? -1 : ta > tb;
+}
+
+static void run_bench(struct data *data, const struct bench_scheduler *s,
+		      const struct topology *t, uint32_t size, uint32_t iterations)
+{
+	struct timespec ts;
+	int64_t start, prev, now;
+	uint64_t calls = 0, received;
+	volatile uint32_t i;
+	double ns;
+
+	if (setup_graph(data, s, t, size) < 0) {
+		printf("can't build %s graph\n", t->name);
+		clear_graph(data);
+		return;
+	}
+
+	current = data;
+	if (setjmp(data->abort_cycle)) {
+		printf("%-10s %5u %-11s %5u  cycle %u did not finish\n",
+				t->name, size, s->name, data->n_nodes, i);
+		clear_graph(data);
+		return;
+	}
+
+	/* warm up the caches and the branch predictors */
+	for (i = 0; i < iterations / 10; i++)
+		run_cycle(data);
+
+	for (i = 0; i < data->n_nodes; i++) {
+		data->nodes[i].calls = 0;
+		data->nodes[i].received = 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	start = prev = SPA_TIMESPEC_TO_TIME(&ts);
+	for (i = 0; i < iterations; i++) {
+		run_cycle(data);
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		now = SPA_TIMESPEC_TO_TIME(&ts);
+		data->times[i] = now - prev;
+		prev = now;
+	}
+
+	for (i = 0; i < data->n_nodes; i++)
+		calls += data->nodes[i].calls;
+	received = iterations;
+	for (i = 0; i < data->n_sinks; i++)
+		received = SPA_MIN(received, data->sinks[i]->received);
+
+	qsort(data->times, iterations, sizeof(int64_t), compare_times);
+
+	ns = (double) (now - start) / iterations;
+	printf("%-10s %5u %-11s %5u %10.1f %8.1f %8.1f %8" PRIi64 " %8" PRIi64 " %8" PRIi64 " %8" PRIi64 " %s\n",
+			t->name, size, s->name, data->n_nodes,
+			ns, ns / data->n_nodes,
+			(double) calls / iterations,
+			data->times[iterations / 2],
+			data->times[iterations * 90 / 100],
+			data->times[iterations * 99 / 100],
+			data->times[iterations - 1],
+			received == iterations ? "yes" : "no");
+
+	clear_graph(data);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-i iterations] [-n size] [-t topology] [-s scheduler]\n"
+			"  topologies: chain, fan-in, fan-out, diamond, parallel\n"
+			"  schedulers: scheduler1, scheduler3, scheduler6, scheduler7\n",
+			name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { NULL };
+	const char *topology = NULL, *scheduler = NULL, *str;
+	uint32_t iterations = 100000, size = 16, i, j;
+	int c;
+
+	while ((c = getopt(argc, argv, "i:n:t:s:h")) != -1) {
+		switch (c) {
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'n':
+			size = atoi(optarg);
+			break;
+		case 't':
+			topology = optarg;
+			break;
+		case 's':
+			scheduler = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : -1;
+		}
+	}
+	if (iterations == 0 || size == 0) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	data.map = &default_map.map;
+	data.log = &default_log.log;
+	data.data_loop.version = SPA_VERSION_LOOP;
+	data.data_loop.add_source = do_add_source;
+	data.data_loop.update_source = do_update_source;
+	data.data_loop.remove_source = do_remove_source;
+	data.data_loop.invoke = do_invoke;
+
+	data.log->level = SPA_LOG_LEVEL_WARN;
+	if ((str = getenv("SPA_DEBUG")))
+		data.log->level = atoi(str);
+
+	data.support[0] = SPA_SUPPORT_INIT(SPA_TYPE__TypeMap, data.map);
+	data.support[1] = SPA_SUPPORT_INIT(SPA_TYPE__Log, data.log);
+	data.support[2] = SPA_SUPPORT_INIT(SPA_TYPE_LOOP__DataLoop, &data.data_loop);
+	data.support[3] = SPA_SUPPORT_INIT(SPA_TYPE_LOOP__MainLoop, &data.data_loop);
+	data.n_support = 4;
+
+	init_type(&data.type, data.map);
+
+	data.times = calloc(iterations, sizeof(int64_t));
+
+	printf("%-10s %5s %-11s %5s %10s %8s %8s %8s %8s %8s %8s %s\n",
+			"topology", "size", "scheduler", "nodes",
+			"ns/cycle", "ns/node", "calls", "p50", "p90", "p99", "max", "ok");
+
+	for (i = 0; i < SPA_N_ELEMENTS(topologies); i++) {
+		if (topology && strcmp(topology, topologies[i].name))
+			continue;
+		for (j = 0; j < SPA_N_ELEMENTS(schedulers); j++) {
+			if (scheduler && strcmp(scheduler, schedulers[j]->name))
+				continue;
+			run_bench(&data, schedulers[j], &topologies[i], size, iterations);
+		}
+	}
+	free(data.times);
+
+	return 0;
+}
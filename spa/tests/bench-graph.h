@@ -0,0 +1,34 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <spa/graph/graph.h>
+
+/* The scheduler headers all define the same symbols, each one is built
+ * into its own object that exports one of these. */
+struct bench_scheduler {
+	const char *name;
+	size_t data_size;	/**< size of the scheduler data */
+	void (*setup) (struct spa_graph *graph, void *data);
+	void (*clear) (void *data);
+};
+
+extern const struct bench_scheduler bench_scheduler1;
+extern const struct bench_scheduler bench_scheduler3;
+extern const struct bench_scheduler bench_scheduler6;
+extern const struct bench_scheduler bench_scheduler7;
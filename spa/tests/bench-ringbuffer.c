@@ -0,0 +1,480 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/ringbuffer.h>
+
+/* Measures the ringbuffer variants between a writer and a reader thread,
+ * optionally pinned to a pair of cpus.
+ *
+ * For every variant and message size, two runs are made:
+ *  - throughput: the writer sends messages as fast as the ringbuffer
+ *    allows, the reader consumes them.
+ *  - latency: the writer sends the next message only when the reader
+ *    consumed the previous one. Each message carries the time it was
+ *    written, the reader records the time until it sees it.
+ *
+ * Both threads spin, so a pair of cpus that are otherwise idle gives
+ * the most useful numbers. The latencies are printed in nanoseconds. */
+
+#define MAX_PAIRS	16
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC	0x0001U
+#endif
+
+struct data;
+
+struct variant {
+	const char *name;
+	bool mirrored;			/**< needs mirrored memory */
+	void (*init) (struct data *data);
+	/* write one message of data->msg_size bytes stamped with \a time,
+	 * returns false when there is no space */
+	bool (*write) (struct data *data, uint64_t time);
+	/* read one message, returns false when there is none */
+	bool (*read) (struct data *data, uint64_t *time);
+	/* the number of bytes in the ringbuffer, seen from the writer */
+	int32_t (*filled) (struct data *data);
+};
+
+struct data {
+	const struct variant *variant;
+	uint32_t size;			/**< size of the ringbuffer memory */
+	uint32_t msg_size;		/**< size of one message */
+
+	struct spa_ringbuffer rb;
+	struct spa_ringbuffer_padded prb;
+	uint8_t *mem;			/**< size bytes, mapped twice */
+
+	uint8_t *in;			/**< message of the writer */
+	uint8_t *out;			/**< message of the reader */
+
+	int reader_cpu;
+	int writer_cpu;
+	bool reader_pinned;		/**< the reader runs on reader_cpu */
+	bool writer_pinned;		/**< the writer runs on writer_cpu */
+
+	uint32_t count;			/**< messages to send */
+	bool latency;			/**< wait for every message to be read */
+	uint64_t *times;		/**< latencies of the messages */
+	uint64_t start, end;
+};
+
+static inline uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static inline void relax(uint32_t *spins)
+{
+	/* give the cpu away when the other thread can't be running */
+	if (++(*spins) & 1023) {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	} else
+		sched_yield();
+}
+
+static void fill_message(struct data *data, uint8_t *p, uint64_t time)
+{
+	memcpy(p, &time, sizeof(uint64_t));
+	memset(p + sizeof(uint64_t), time & 0xff, data->msg_size - sizeof(uint64_t));
+}
+
+static void plain_init(struct data *data)
+{
+	spa_ringbuffer_init(&data->rb);
+}
+
+static bool plain_write(struct data *data, uint64_t time)
+{
+	uint32_t index;
+
+	if (data->size - spa_ringbuffer_get_write_index(&data->rb, &index) < data->msg_size)
+		return false;
+
+	fill_message(data, data->in, time);
+	spa_ringbuffer_write_data(&data->rb, data->mem, data->size,
+				  index & (data->size - 1), data->in, data->msg_size);
+	spa_ringbuffer_write_update(&data->rb, index + data->msg_size);
+	return true;
+}
+
+static bool plain_read(struct data *data, uint64_t *time)
+{
+	uint32_t index;
+
+	if (spa_ringbuffer_get_read_index(&data->rb, &index) < (int32_t) data->msg_size)
+		return false;
+
+	spa_ringbuffer_read_data(&data->rb, data->mem, data->size,
+				 index & (data->size - 1), data->out, data->msg_size);
+	spa_ringbuffer_read_update(&data->rb, index + data->msg_size);
+	memcpy(time, data->out, sizeof(uint64_t));
+	return true;
+}
+
+static int32_t plain_filled(struct data *data)
+{
+	uint32_t index;
+	return spa_ringbuffer_get_write_index(&data->rb, &index);
+}
+
+static void padded_init(struct data *data)
+{
+	spa_ringbuffer_padded_init(&data->prb);
+}
+
+static bool padded_write(struct data *data, uint64_t time)
+{
+	uint32_t index;
+
+	if (data->size - spa_ringbuffer_padded_get_write_index(&data->prb, &index,
+			data->size, data->msg_size) < data->msg_size)
+		return false;
+
+	fill_message(data, data->in, time);
+	spa_ringbuffer_padded_write_data(&data->prb, data->mem, data->size,
+					 index & (data->size - 1), data->in, data->msg_size);
+	spa_ringbuffer_padded_write_update(&data->prb, index + data->msg_size);
+	return true;
+}
+
+static bool padded_read(struct data *data, uint64_t *time)
+{
+	uint32_t index;
+
+	if (spa_ringbuffer_padded_get_read_index(&data->prb, &index,
+			data->msg_size) < (int32_t) data->msg_size)
+		return false;
+
+	spa_ringbuffer_padded_read_data(&data->prb, data->mem, data->size,
+					index & (data->size - 1), data->out, data->msg_size);
+	spa_ringbuffer_padded_read_update(&data->prb, index + data->msg_size);
+	memcpy(time, data->out, sizeof(uint64_t));
+	return true;
+}
+
+static int32_t padded_filled(struct data *data)
+{
+	uint32_t index;
+	/* ask for the whole ringbuffer so that the read index is loaded */
+	return spa_ringbuffer_padded_get_write_index(&data->prb, &index, data->size, data->size);
+}
+
+static bool mirrored_write(struct data *data, uint64_t time)
+{
+	uint32_t index;
+	uint8_t *p;
+
+	if ((p = spa_ringbuffer_padded_write_reserve(&data->prb, data->mem, data->size,
+						     data->msg_size, &index)) == NULL)
+		return false;
+
+	fill_message(data, p, time);
+	spa_ringbuffer_padded_write_commit(&data->prb, index, data->msg_size);
+	return true;
+}
+
+static bool mirrored_read(struct data *data, uint64_t *time)
+{
+	const uint8_t *p;
+	uint32_t index;
+	int32_t avail;
+
+	if ((p = spa_ringbuffer_padded_read_peek(&data->prb, data->mem, data->size,
+						 data->msg_size, &index, &avail)) == NULL)
+		return false;
+
+	memcpy(time, p, sizeof(uint64_t));
+	spa_ringbuffer_padded_read_release(&data->prb, index, data->msg_size);
+	return true;
+}
+
+static const struct variant variants[] = {
+	{ "plain", false, plain_init, plain_write, plain_read, plain_filled },
+	{ "padded", false, padded_init, padded_write, padded_read, padded_filled },
+	{ "mirrored", true, padded_init, mirrored_write, mirrored_read, padded_filled },
+};
+
+static bool set_cpu(int cpu)
+{
+	cpu_set_t set;
+	int res;
+
+	if (cpu < 0)
+		return false;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if ((res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0) {
+		fprintf(stderr, "can't run on cpu %d: %s\n", cpu, strerror(res));
+		return false;
+	}
+	return true;
+}
+
+/* if the threads of the process are allowed to run on \a cpu */
+static bool cpu_allowed(int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0)
+		return true;
+	if (cpu >= CPU_SETSIZE || sched_getaffinity(0, sizeof(set), &set) < 0)
+		return false;
+	return CPU_ISSET(cpu, &set);
+}
+
+static void *reader_start(void *arg)
+{
+	struct data *data = arg;
+	uint32_t i, spins = 0;
+	uint64_t time;
+
+	data->reader_pinned = set_cpu(data->reader_cpu);
+
+	for (i = 0; i < data->count; i++) {
+		while (!data->variant->read(data, &time))
+			relax(&spins);
+		if (data->latency)
+			data->times[i] = get_time() - time;
+	}
+	data->end = get_time();
+
+	return NULL;
+}
+
+static void *writer_start(void *arg)
+{
+	struct data *data = arg;
+	uint32_t i, spins = 0;
+
+	data->writer_pinned = set_cpu(data->writer_cpu);
+
+	data->start = get_time();
+	for (i = 0; i < data->count; i++) {
+		if (data->latency) {
+			while (data->variant->filled(data) > 0)
+				relax(&spins);
+		}
+		while (!data->variant->write(data, get_time()))
+			relax(&spins);
+	}
+	return NULL;
+}
+
+static void run(struct data *data)
+{
+	pthread_t reader, writer;
+
+	data->variant->init(data);
+	pthread_create(&reader, NULL, reader_start, data);
+	pthread_create(&writer, NULL, writer_start, data);
+	pthread_join(writer, NULL);
+	pthread_join(reader, NULL);
+}
+
+static int compare_times(const void *a, const void *b)
+{
+	uint64_t ta = *(const uint64_t *) a, tb = *(const uint64_t *) b;
+	return ta < tb ? -1 : ta > tb;
+}
+
+static void run_bench(struct data *data, const struct variant *v, uint32_t msg_size,
+		      uint32_t iterations)
+{
+	double secs;
+	char cpus[32];
+
+	data->variant = v;
+	data->msg_size = msg_size;
+
+	data->count = iterations;
+	data->latency = false;
+	run(data);
+	secs = (double) (data->end - data->start) / SPA_NSEC_PER_SEC;
+
+	data->count = iterations / 10;
+	data->latency = true;
+	run(data);
+	qsort(data->times, data->count, sizeof(uint64_t), compare_times);
+
+	/* the pinning is done again for every run, only label the row with the
+	 * cpus when the threads ran there */
+	if (data->reader_pinned && data->writer_pinned)
+		snprintf(cpus, sizeof(cpus), "%d/%d", data->reader_cpu, data->writer_cpu);
+	else
+		snprintf(cpus, sizeof(cpus), "-");
+	printf("%-9s %6u %6u %7s %12.0f %10.1f %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8" PRIu64 "\n",
+			v->name, data->size, msg_size, cpus,
+			iterations / secs, iterations * msg_size / secs / 1e6,
+			data->times[data->count / 2],
+			data->times[data->count * 90 / 100],
+			data->times[data->count * 99 / 100],
+			data->times[data->count - 1]);
+}
+
+/* map \a size bytes twice back to back, like PW_MEMBLOCK_FLAG_MAP_TWICE */
+static void *map_mirrored(size_t size)
+{
+	void *ptr;
+	int fd;
+
+	if ((fd = syscall(SYS_memfd_create, "bench-ringbuffer", MFD_CLOEXEC)) < 0)
+		return NULL;
+	if (ftruncate(fd, size) < 0)
+		goto error_close;
+
+	ptr = mmap(NULL, size << 1, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		goto error_close;
+	if (mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, 0) != ptr ||
+	    mmap(ptr + size, size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, 0) != ptr + size)
+		goto error_unmap;
+
+	close(fd);
+	return ptr;
+
+      error_unmap:
+	munmap(ptr, size << 1);
+      error_close:
+	close(fd);
+	return NULL;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-i iterations] [-s size] [-m message-size] [-c reader,writer] [-v variant]\n"
+			"  size: ringbuffer size in bytes, a power of 2 and a multiple of the page size\n"
+			"  -m and -c can be repeated, -c pins the threads to a pair of cpus\n"
+			"  variants: plain, padded, mirrored\n",
+			name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { NULL };
+	static const uint32_t default_sizes[] = { 8, 64, 256, 1024 };
+	uint32_t iterations = 1000000, msg_sizes[16], n_msg_sizes = 0, i, j, k;
+	int pairs[MAX_PAIRS][2], n_pairs = 0, p;
+	const char *variant = NULL;
+	int c;
+
+	data.size = 4096;
+
+	while ((c = getopt(argc, argv, "i:s:m:c:v:h")) != -1) {
+		switch (c) {
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 's':
+			data.size = atoi(optarg);
+			break;
+		case 'm':
+			if (n_msg_sizes < SPA_N_ELEMENTS(msg_sizes))
+				msg_sizes[n_msg_sizes++] = atoi(optarg);
+			break;
+		case 'c':
+			if (n_pairs < MAX_PAIRS &&
+			    sscanf(optarg, "%d,%d", &pairs[n_pairs][0], &pairs[n_pairs][1]) == 2)
+				n_pairs++;
+			break;
+		case 'v':
+			variant = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : -1;
+		}
+	}
+	if (iterations < 10 || data.size == 0 || (data.size & (data.size - 1))) {
+		usage(argv[0]);
+		return -1;
+	}
+	if (n_msg_sizes == 0) {
+		for (i = 0; i < SPA_N_ELEMENTS(default_sizes); i++)
+			msg_sizes[n_msg_sizes++] = default_sizes[i];
+	}
+	for (i = 0; i < n_msg_sizes; i++) {
+		if (msg_sizes[i] < sizeof(uint64_t) || msg_sizes[i] > data.size) {
+			fprintf(stderr, "message size %u not between %zd and %u\n",
+					msg_sizes[i], sizeof(uint64_t), data.size);
+			return -1;
+		}
+	}
+	if (n_pairs == 0) {
+		pairs[0][0] = pairs[0][1] = -1;
+		n_pairs = 1;
+	}
+
+	if ((data.mem = map_mirrored(data.size)) == NULL) {
+		fprintf(stderr, "can't map ringbuffer memory: %s\n", strerror(errno));
+		return -1;
+	}
+	data.in = malloc(data.size);
+	data.out = malloc(data.size);
+	data.times = calloc(iterations / 10, sizeof(uint64_t));
+
+	printf("%-9s %6s %6s %7s %12s %10s %8s %8s %8s %8s\n",
+			"variant", "size", "msg", "cpus", "msg/s", "MB/s",
+			"p50", "p90", "p99", "max");
+
+	for (p = 0; p < n_pairs; p++) {
+		if (!cpu_allowed(pairs[p][0]) || !cpu_allowed(pairs[p][1])) {
+			fprintf(stderr, "can't run on cpus %d,%d, skipping\n",
+					pairs[p][0], pairs[p][1]);
+			continue;
+		}
+		data.reader_cpu = pairs[p][0];
+		data.writer_cpu = pairs[p][1];
+
+		for (j = 0; j < SPA_N_ELEMENTS(variants); j++) {
+			if (variant && strcmp(variant, variants[j].name))
+				continue;
+			for (k = 0; k < n_msg_sizes; k++)
+				run_bench(&data, &variants[j], msg_sizes[k], iterations);
+		}
+	}
+
+	free(data.times);
+	free(data.out);
+	free(data.in);
+	munmap(data.mem, data.size << 1);
+
+	return 0;
+}
@@ -0,0 +1,255 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include <spa/support/log-impl.h>
+#include <spa/support/loop.h>
+#include <spa/support/type-map-impl.h>
+#include <spa/support/plugin.h>
+
+/* Several threads invoke on one loop at the same time, every thread
+ * alternates between blocking and async invokes. The loop checks that
+ * the items of every thread arrive in order and that none are lost. */
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+#define MAX_THREADS	64
+
+struct data {
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	struct spa_support support[2];
+	uint32_t n_support;
+
+	struct spa_handle *handle;
+	struct spa_loop *loop;
+	struct spa_loop_control *control;
+
+	uint32_t n_threads;
+	uint32_t n_items;
+
+	uint32_t next[MAX_THREADS];	/**< next expected item of each thread */
+	uint64_t n_failures;
+	bool running;
+};
+
+struct item {
+	uint32_t thread;
+	uint32_t count;
+};
+
+static int do_item(struct spa_loop *loop, bool async, uint32_t seq,
+		   const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	const struct item *item = data;
+
+	if (item->count != d->next[item->thread]) {
+		printf("thread %u: got item %u, expected %u\n",
+				item->thread, item->count, d->next[item->thread]);
+		d->n_failures++;
+	}
+	d->next[item->thread] = item->count + 1;
+	return item->count;
+}
+
+static int do_stop(struct spa_loop *loop, bool async, uint32_t seq,
+		   const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	d->running = false;
+	return 0;
+}
+
+static void *loop_start(void *arg)
+{
+	struct data *d = arg;
+
+	spa_loop_control_enter(d->control);
+	while (d->running)
+		spa_loop_control_iterate(d->control, -1);
+	spa_loop_control_leave(d->control);
+
+	return NULL;
+}
+
+struct thread {
+	struct data *data;
+	uint32_t id;
+	pthread_t thread;
+};
+
+static void *invoke_start(void *arg)
+{
+	struct thread *t = arg;
+	struct data *d = t->data;
+	struct item item;
+	uint32_t i;
+	int res;
+
+	item.thread = t->id;
+	for (i = 0; i < d->n_items; i++) {
+		item.count = i;
+		if ((i & 15) == 0) {
+			res = spa_loop_invoke(d->loop, do_item, 0, &item, sizeof(item), true, d);
+			if (res != (int) i) {
+				printf("thread %u: blocking invoke returned %d, expected %u\n",
+						t->id, res, i);
+				__atomic_add_fetch(&d->n_failures, 1, __ATOMIC_RELAXED);
+			}
+		} else {
+			res = spa_loop_invoke(d->loop, do_item, SPA_ID_INVALID,
+					&item, sizeof(item), false, d);
+			if (res < 0) {
+				printf("thread %u: invoke failed: %s\n", t->id, spa_strerror(res));
+				__atomic_add_fetch(&d->n_failures, 1, __ATOMIC_RELAXED);
+			}
+		}
+	}
+	return NULL;
+}
+
+static int make_loop(struct data *data, const char *backend)
+{
+	struct spa_dict_item items[1];
+	struct spa_dict info = SPA_DICT_INIT(items, 0);
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	void *hnd, *iface;
+	uint32_t i;
+	int res;
+
+	if ((hnd = dlopen("build/spa/plugins/support/libspa-support.so", RTLD_NOW)) == NULL) {
+		printf("can't load libspa-support.so: %s\n", dlerror());
+		return -errno;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return -errno;
+	}
+
+	for (i = 0;;) {
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			printf("can't find the loop factory\n");
+			return res == 0 ? -ENOENT : res;
+		}
+		if (strcmp(factory->name, "loop") == 0)
+			break;
+	}
+
+	if (backend)
+		items[info.n_items++] = SPA_DICT_ITEM_INIT(SPA_LOOP_INFO_BACKEND, backend);
+
+	data->handle = calloc(1, factory->size);
+	if ((res = spa_handle_factory_init(factory, data->handle, &info,
+					   data->support, data->n_support)) < 0) {
+		printf("can't make factory instance: %d\n", res);
+		return res;
+	}
+	if ((res = spa_handle_get_interface(data->handle,
+			spa_type_map_get_id(data->map, SPA_TYPE__Loop), &iface)) < 0)
+		return res;
+	data->loop = iface;
+	if ((res = spa_handle_get_interface(data->handle,
+			spa_type_map_get_id(data->map, SPA_TYPE__LoopControl), &iface)) < 0)
+		return res;
+	data->control = iface;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { NULL };
+	struct thread threads[MAX_THREADS];
+	pthread_t loop_thread;
+	struct timespec ts;
+	int64_t start, end;
+	uint32_t i;
+	int res;
+
+	data.n_threads = argc > 1 ? atoi(argv[1]) : 8;
+	data.n_items = argc > 2 ? atoi(argv[2]) : 100000;
+	if (data.n_threads == 0 || data.n_threads > MAX_THREADS) {
+		printf("usage: %s [threads (1-%d)] [items] [backend]\n", argv[0], MAX_THREADS);
+		return -1;
+	}
+
+	data.map = &default_map.map;
+	data.log = &default_log.log;
+	data.log->level = SPA_LOG_LEVEL_WARN;
+
+	data.support[0] = SPA_SUPPORT_INIT(SPA_TYPE__TypeMap, data.map);
+	data.support[1] = SPA_SUPPORT_INIT(SPA_TYPE__Log, data.log);
+	data.n_support = 2;
+
+	if ((res = make_loop(&data, argc > 3 ? argv[3] : NULL)) < 0)
+		return -1;
+
+	printf("starting loop stress test, %u threads, %u items\n",
+			data.n_threads, data.n_items);
+
+	data.running = true;
+	pthread_create(&loop_thread, NULL, loop_start, &data);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	start = SPA_TIMESPEC_TO_TIME(&ts);
+
+	for (i = 0; i < data.n_threads; i++) {
+		threads[i].data = &data;
+		threads[i].id = i;
+		pthread_create(&threads[i].thread, NULL, invoke_start, &threads[i]);
+	}
+	for (i = 0; i < data.n_threads; i++)
+		pthread_join(threads[i].thread, NULL);
+
+	/* the loop handles this after all the items */
+	spa_loop_invoke(data.loop, do_stop, 0, NULL, 0, true, &data);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	end = SPA_TIMESPEC_TO_TIME(&ts);
+
+	pthread_join(loop_thread, NULL);
+
+	for (i = 0; i < data.n_threads; i++) {
+		if (data.next[i] != data.n_items) {
+			printf("thread %u: %u of %u items arrived\n", i, data.next[i], data.n_items);
+			data.n_failures++;
+		}
+	}
+	printf("%.1f ns per invoke, %"PRIu64" failures\n",
+			(double) (end - start) / ((uint64_t) data.n_threads * data.n_items),
+			data.n_failures);
+
+	spa_handle_clear(data.handle);
+	free(data.handle);
+
+	return data.n_failures ? -1 : 0;
+}
@@ -1,8 +1,11 @@
 #define _GNU_SOURCE
 #include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <sched.h>
+#include <time.h>
 
 #include <spa/utils/ringbuffer.h>
 
@@ -10,9 +13,15 @@
 #define MAX_VALUE 0x10000
 
 struct spa_ringbuffer rb;
+struct spa_ringbuffer_padded prb;
+bool padded;
 uint32_t size;
 uint8_t *data;
 
+int reader_cpu = -1, writer_cpu = -1;
+volatile bool running;
+unsigned long n_chunks;
+
 static int fill_int_array(int *array, int start, int count)
 {
 	int i, j = start;
@@ -35,19 +44,65 @@ static int cmp_array(int *array1, int *array2, int count)
 	return 1;
 }
 
+static void set_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0)
+		return;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+		printf("can't run on cpu %d\n", cpu);
+}
+
+static inline int32_t get_read_index(uint32_t *index)
+{
+	if (padded)
+		return spa_ringbuffer_padded_get_read_index(&prb, index, ARRAY_SIZE * sizeof(int));
+	else
+		return spa_ringbuffer_get_read_index(&rb, index);
+}
+
+static inline void read_update(uint32_t index)
+{
+	if (padded)
+		spa_ringbuffer_padded_read_update(&prb, index);
+	else
+		spa_ringbuffer_read_update(&rb, index);
+}
+
+static inline int32_t get_write_index(uint32_t *index)
+{
+	if (padded)
+		return spa_ringbuffer_padded_get_write_index(&prb, index, size, ARRAY_SIZE * sizeof(int));
+	else
+		return spa_ringbuffer_get_write_index(&rb, index);
+}
+
+static inline void write_update(uint32_t index)
+{
+	if (padded)
+		spa_ringbuffer_padded_write_update(&prb, index);
+	else
+		spa_ringbuffer_write_update(&rb, index);
+}
+
 static void *reader_start(void *arg)
 {
 	int i = 0, a[ARRAY_SIZE], b[ARRAY_SIZE];
 	unsigned long j = 0, nfailures = 0;
 
+	set_cpu(reader_cpu);
 	printf("reader started on cpu: %d\n", sched_getcpu());
 
 	i = fill_int_array(a, i, ARRAY_SIZE);
 
-	while (1) {
+	while (running) {
 		uint32_t index;
 
-		if (spa_ringbuffer_get_read_index(&rb, &index) >= ARRAY_SIZE * sizeof(int)) {
+		if (get_read_index(&index) >= ARRAY_SIZE * sizeof(int)) {
 			spa_ringbuffer_read_data(&rb, data, size, index & (size - 1), b,
 						 ARRAY_SIZE * sizeof(int));
 
@@ -61,9 +116,10 @@ static void *reader_start(void *arg)
 			i = fill_int_array(a, i, ARRAY_SIZE);
 			j++;
 
-			spa_ringbuffer_read_update(&rb, index + ARRAY_SIZE * sizeof(int));
+			read_update(index + ARRAY_SIZE * sizeof(int));
 		}
 	}
+	n_chunks = j;
 
 	return NULL;
 }
@@ -71,17 +127,19 @@ static void *reader_start(void *arg)
 static void *writer_start(void *arg)
 {
 	int i = 0, a[ARRAY_SIZE];
+
+	set_cpu(writer_cpu);
 	printf("writer started on cpu: %d\n", sched_getcpu());
 
 	i = fill_int_array(a, i, ARRAY_SIZE);
 
-	while (1) {
+	while (running) {
 		uint32_t index;
 
-		if (spa_ringbuffer_get_write_index(&rb, &index) >= ARRAY_SIZE * sizeof(int)) {
+		if (size - get_write_index(&index) >= ARRAY_SIZE * sizeof(int)) {
 			spa_ringbuffer_write_data(&rb, data, size, index & (size - 1), a,
 						  ARRAY_SIZE * sizeof(int));
-			spa_ringbuffer_write_update(&rb, index + ARRAY_SIZE * sizeof(int));
+			write_update(index + ARRAY_SIZE * sizeof(int));
 
 			i = fill_int_array(a, i, ARRAY_SIZE);
 		}
@@ -90,24 +148,61 @@ static void *writer_start(void *arg)
 	return NULL;
 }
 
+static void run(bool use_padded, int seconds)
+{
+	pthread_t reader_thread, writer_thread;
+	struct timespec start, end;
+	double elapsed;
+
+	padded = use_padded;
+	spa_ringbuffer_init(&rb);
+	spa_ringbuffer_padded_init(&prb);
+	running = true;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pthread_create(&reader_thread, NULL, reader_start, NULL);
+	pthread_create(&writer_thread, NULL, writer_start, NULL);
+
+	sleep(seconds);
+	running = false;
+
+	pthread_join(writer_thread, NULL);
+	pthread_join(reader_thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%s: %.1f MB/s\n", padded ? "padded" : "plain",
+	       n_chunks * ARRAY_SIZE * sizeof(int) / elapsed / 1e6);
+}
+
 int main(int argc, char *argv[])
 {
+	int seconds = 2;
+
+	if (argc < 2) {
+		printf("usage: %s <size> [reader-cpu writer-cpu] [seconds]\n", argv[0]);
+		return -1;
+	}
+
 	printf("starting ringbuffer stress test\n");
 
 	sscanf(argv[1], "%d", &size);
+	if (argc > 3) {
+		reader_cpu = atoi(argv[2]);
+		writer_cpu = atoi(argv[3]);
+	}
+	if (argc > 4)
+		seconds = atoi(argv[4]);
 
 	printf("buffer size (bytes): %d\n", size);
 	printf("array size (bytes): %ld\n", sizeof(int) * ARRAY_SIZE);
 
-	spa_ringbuffer_init(&rb);
 	data = malloc(size);
 
-	pthread_t reader_thread, writer_thread;
-	pthread_create(&reader_thread, NULL, reader_start, NULL);
-	pthread_create(&writer_thread, NULL, writer_start, NULL);
+	run(false, seconds);
+	run(true, seconds);
 
-	while (1)
-		sleep(1);
+	free(data);
 
 	return 0;
 }
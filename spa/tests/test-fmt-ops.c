@@ -0,0 +1,286 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fmt-ops.h"
+
+#define MAX_CHANNELS	8
+#define MAX_SAMPLES	(CONV_CHUNK * 2 + 45)
+#define MAX_SIZE	(MAX_SAMPLES * MAX_CHANNELS * sizeof(double))
+
+static const uint32_t channels[] = { 1, 2, 3, 8 };
+static const uint32_t samples[] = { 0, 1, 7, CONV_CHUNK + 1, MAX_SAMPLES };
+
+static uint8_t src[MAX_SIZE], dst[MAX_SIZE], ref[MAX_SIZE], tmp[MAX_SIZE];
+
+static int n_failed;
+
+static const char *fmt_name(uint32_t fmt)
+{
+	static const char *names[] = { "u8", "s16", "s24", "s24_32", "s32", "f32", "f64" };
+	return names[CONV_FORMAT(fmt)];
+}
+
+#define CHECK(expr)							\
+({									\
+	if (!(expr)) {							\
+		printf("%s:%d: %s failed\n", __FILE__, __LINE__, #expr);\
+		n_failed++;						\
+	}								\
+})
+
+static void fill(uint32_t fmt, uint32_t n_samples)
+{
+	uint32_t i, j, size = convert_sample_size(fmt);
+
+	srandom(n_samples);
+	for (i = 0; i < n_samples; i++) {
+		switch (CONV_FORMAT(fmt)) {
+		case CONV_F32:
+			((float *) src)[i] = (random() / (float) RAND_MAX) * 2.4f - 1.2f;
+			break;
+		case CONV_F64:
+			((double *) src)[i] = (random() / (double) RAND_MAX) * 2.4 - 1.2;
+			break;
+		default:
+			for (j = 0; j < size; j++)
+				src[i * size + j] = random();
+			break;
+		}
+	}
+}
+
+/* point the planes of \a fmt at \a data */
+static void make_planes(void *planes[], void *data, uint32_t fmt, uint32_t n_channels,
+			uint32_t n_samples)
+{
+	uint32_t c;
+
+	for (c = 0; c < n_channels; c++)
+		planes[c] = SPA_MEMBER(data, c * n_samples * convert_sample_size(fmt), void);
+}
+
+/* planar \a data to interleaved in \a out */
+static void interleave(void *out, const void *data, uint32_t fmt, uint32_t n_channels,
+		       uint32_t n_samples)
+{
+	uint32_t c, i, size = convert_sample_size(fmt);
+
+	for (c = 0; c < n_channels; c++)
+		for (i = 0; i < n_samples; i++)
+			memcpy(SPA_MEMBER(out, (i * n_channels + c) * size, void),
+			       SPA_MEMBER(data, (c * n_samples + i) * size, void), size);
+}
+
+static void deinterleave(void *out, const void *data, uint32_t fmt, uint32_t n_channels,
+			 uint32_t n_samples)
+{
+	uint32_t c, i, size = convert_sample_size(fmt);
+
+	for (c = 0; c < n_channels; c++)
+		for (i = 0; i < n_samples; i++)
+			memcpy(SPA_MEMBER(out, (c * n_samples + i) * size, void),
+			       SPA_MEMBER(data, (i * n_channels + c) * size, void), size);
+}
+
+static void run(uint32_t src_fmt, uint32_t dst_fmt, uint32_t n_channels, uint32_t n_samples,
+		uint32_t cpu_flags, void *out, const void *in)
+{
+	struct convert conv;
+	void *s[CONV_MAX_CHANNELS], *d[CONV_MAX_CHANNELS];
+
+	if (CONV_IS_PLANAR(src_fmt))
+		make_planes(s, (void *) in, src_fmt, n_channels, n_samples);
+	else
+		s[0] = (void *) in;
+	if (CONV_IS_PLANAR(dst_fmt))
+		make_planes(d, out, dst_fmt, n_channels, n_samples);
+	else
+		d[0] = out;
+
+	CHECK(convert_init(&conv, src_fmt, dst_fmt, n_channels, cpu_flags) == 0);
+	convert_process(&conv, d, (const void **) s, n_samples);
+	convert_free(&conv);
+}
+
+/* every pair of formats in all the layouts gives the same samples as the
+ * interleaved conversion */
+static void test_layouts(uint32_t cpu_flags)
+{
+	uint32_t sf, df, layout, ch, k;
+
+	for (sf = 0; sf < CONV_MAX; sf++) {
+		for (df = 0; df < CONV_MAX; df++) {
+			for (ch = 0; ch < SPA_N_ELEMENTS(channels); ch++) {
+				uint32_t n_channels = channels[ch];
+
+				for (k = 0; k < SPA_N_ELEMENTS(samples); k++) {
+					uint32_t n_samples = samples[k];
+					uint32_t size = n_samples * n_channels * convert_sample_size(df);
+
+					fill(sf, n_samples * n_channels);
+					run(sf, df, n_channels, n_samples, cpu_flags, ref, src);
+
+					for (layout = 1; layout < 4; layout++) {
+						uint32_t s_fmt = sf | (layout & 1 ? CONV_PLANAR : 0);
+						uint32_t d_fmt = df | (layout & 2 ? CONV_PLANAR : 0);
+						const void *in = src;
+
+						if (CONV_IS_PLANAR(s_fmt)) {
+							deinterleave(tmp, src, sf, n_channels, n_samples);
+							in = tmp;
+						}
+						memset(dst, 0, size);
+						run(s_fmt, d_fmt, n_channels, n_samples, cpu_flags, dst, in);
+
+						if (CONV_IS_PLANAR(d_fmt)) {
+							interleave(tmp, dst, df, n_channels, n_samples);
+							memcpy(dst, tmp, size);
+						}
+						if (memcmp(dst, ref, size) != 0) {
+							printf("%s%s to %s%s: %u channels, %u samples differs\n",
+							       fmt_name(sf), CONV_IS_PLANAR(s_fmt) ? "p" : "",
+							       fmt_name(df), CONV_IS_PLANAR(d_fmt) ? "p" : "",
+							       n_channels, n_samples);
+							n_failed++;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/* the vector versions give exactly the same samples as the C versions */
+static void test_simd(uint32_t cpu_flags)
+{
+	static const uint32_t pairs[][2] = {
+		{ CONV_S16, CONV_F32 }, { CONV_F32, CONV_S16 },
+		{ CONV_S32, CONV_F32 }, { CONV_F32, CONV_S32 },
+	};
+	uint32_t i, ch, k, planar;
+
+	for (i = 0; i < SPA_N_ELEMENTS(pairs); i++) {
+		for (ch = 0; ch < SPA_N_ELEMENTS(channels); ch++) {
+			uint32_t n_channels = channels[ch];
+
+			for (k = 0; k < SPA_N_ELEMENTS(samples); k++) {
+				uint32_t n_samples = samples[k];
+				uint32_t size = n_samples * n_channels * convert_sample_size(pairs[i][1]);
+
+				for (planar = 0; planar <= CONV_PLANAR; planar += CONV_PLANAR) {
+					uint32_t s_fmt = pairs[i][0] | planar;
+					uint32_t d_fmt = pairs[i][1] | planar;
+
+					fill(s_fmt, n_samples * n_channels);
+					run(s_fmt, d_fmt, n_channels, n_samples, 0, ref, src);
+					run(s_fmt, d_fmt, n_channels, n_samples, cpu_flags, dst, src);
+
+					if (memcmp(dst, ref, size) != 0) {
+						printf("%s to %s: %u channels, %u samples differs\n",
+						       fmt_name(s_fmt), fmt_name(d_fmt),
+						       n_channels, n_samples);
+						n_failed++;
+					}
+				}
+			}
+		}
+	}
+}
+
+static void test_values(void)
+{
+	static const float in[] = { 0.0f, 0.5f, -0.5f, 1.0f, -1.0f, 2.0f, -2.0f };
+	float f32[SPA_N_ELEMENTS(in)];
+	int16_t s16[SPA_N_ELEMENTS(in)];
+	int32_t s32[SPA_N_ELEMENTS(in)];
+	uint8_t u8[SPA_N_ELEMENTS(in)], s24[SPA_N_ELEMENTS(in) * 3];
+	uint32_t n = SPA_N_ELEMENTS(in);
+
+	run(CONV_F32, CONV_S16, 1, n, 0, s16, in);
+	CHECK(s16[0] == 0 && s16[1] == 16384 && s16[2] == -16384);
+	CHECK(s16[3] == 32767 && s16[4] == -32767 && s16[5] == 32767 && s16[6] == -32767);
+
+	run(CONV_F32, CONV_S32, 1, n, 0, s32, in);
+	CHECK(s32[0] == 0 && s32[1] == 1073741824 && s32[2] == -1073741824);
+	CHECK(s32[3] == INT32_MAX && s32[4] == -INT32_MAX && s32[5] == INT32_MAX);
+
+	run(CONV_F32, CONV_S24_32, 1, n, 0, s32, in);
+	CHECK(s32[1] == 4194304 && s32[3] == 8388607 && s32[6] == -8388607);
+
+	run(CONV_F32, CONV_U8, 1, n, 0, u8, in);
+	CHECK(u8[0] == 128 && u8[1] == 192 && u8[2] == 64 && u8[3] == 255 && u8[4] == 1);
+
+	run(CONV_F32, CONV_S24, 1, n, 0, s24, in);
+	run(CONV_S24, CONV_F32, 1, n, 0, f32, s24);
+	CHECK(f32[0] == 0.0f && f32[1] == 0.5f && f32[2] == -0.5f);
+	CHECK(f32[3] > 0.9999f && f32[3] < 1.0f && f32[6] < -0.9999f && f32[6] > -1.0f);
+
+	s16[0] = INT16_MIN;
+	s16[1] = 16384;
+	run(CONV_S16, CONV_F32, 1, 2, 0, f32, s16);
+	CHECK(f32[0] == -1.0f && f32[1] == 0.5f);
+}
+
+/* S32 and F64 keep all their bits, also when converted in two steps */
+static void test_wide(void)
+{
+	static const int32_t in[] = { 0, 1, -1, 123456789, -987654321, INT32_MAX };
+	int32_t s32[SPA_N_ELEMENTS(in)], s24_32[SPA_N_ELEMENTS(in)];
+	double f64[SPA_N_ELEMENTS(in)];
+	uint32_t i, n = SPA_N_ELEMENTS(in);
+
+	run(CONV_S32, CONV_F64, 1, n, 0, f64, in);
+	run(CONV_F64, CONV_S32, 1, n, 0, s32, f64);
+	for (i = 0; i < n; i++)
+		CHECK(s32[i] == in[i] || (in[i] == INT32_MAX && s32[i] == INT32_MAX - 1));
+
+	run(CONV_S32 | CONV_PLANAR, CONV_F64, 1, n, 0, f64, in);
+	CHECK(f64[1] == 1.0 / 2147483648.0 && f64[3] == 123456789.0 / 2147483648.0);
+
+	for (i = 0; i < n; i++)
+		s24_32[i] = in[i] >> 8;
+	run(CONV_S24_32, CONV_S32, 1, n, 0, s32, s24_32);
+	run(CONV_S32, CONV_S24_32, 1, n, 0, s24_32, s32);
+	for (i = 0; i < n; i++)
+		CHECK(s24_32[i] == (in[i] >> 8) ||
+		      (in[i] == INT32_MAX && s24_32[i] == (in[i] >> 8) - 1));
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t cpu_flags = convert_get_cpu_flags();
+
+	test_values();
+	test_wide();
+	test_layouts(0);
+	printf("c: %s\n", n_failed ? "failed" : "ok");
+
+	if (cpu_flags & CONV_CPU_FLAG_SSE2) {
+		test_simd(CONV_CPU_FLAG_SSE2);
+		test_layouts(CONV_CPU_FLAG_SSE2);
+		printf("sse2: %s\n", n_failed ? "failed" : "ok");
+	} else {
+		printf("sse2: not supported\n");
+	}
+	return n_failed ? -1 : 0;
+}
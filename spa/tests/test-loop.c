@@ -0,0 +1,341 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include <spa/support/log-impl.h>
+#include <spa/support/loop.h>
+#include <spa/support/type-map-impl.h>
+#include <spa/support/plugin.h>
+
+/* Checks the timers of the loop: the order in which many timers expire,
+ * the missed expirations of periodic timers, disarming and re-arming
+ * timers from their own callbacks. */
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+#define N_TIMERS	256
+#define MSEC		(SPA_NSEC_PER_SEC / 1000)
+
+struct data {
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	struct spa_support support[2];
+	uint32_t n_support;
+
+	struct spa_handle *handle;
+	struct spa_loop_control *control;
+	struct spa_loop_utils *utils;
+
+	int n_failed;
+};
+
+struct timer {
+	struct data *data;
+	struct spa_source *source;
+	uint64_t expire;		/**< when the timer should expire */
+	uint64_t last;			/**< expiration of the previously fired timer */
+	uint32_t n_fired;
+	uint64_t expirations;
+	uint32_t n_rearm;		/**< times to re-arm from the callback */
+	struct timer *disarm;		/**< timer to disarm from the callback */
+};
+
+#define CHECK(d,name,expr)						\
+({									\
+	if (!(expr)) {							\
+		printf("%s: check failed: %s\n", name, #expr);		\
+		(d)->n_failed++;					\
+	}								\
+})
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static void set_timespec(struct timespec *ts, uint64_t nsec)
+{
+	ts->tv_sec = nsec / SPA_NSEC_PER_SEC;
+	ts->tv_nsec = nsec % SPA_NSEC_PER_SEC;
+}
+
+static int arm_timer(struct timer *t, uint64_t value, uint64_t interval, bool absolute)
+{
+	struct timespec v, i;
+
+	set_timespec(&v, value);
+	set_timespec(&i, interval);
+	return spa_loop_utils_update_timer(t->data->utils, t->source,
+			&v, interval ? &i : NULL, absolute);
+}
+
+static void iterate_until(struct data *d, uint64_t end)
+{
+	uint64_t now;
+
+	while ((now = get_time_ns()) < end)
+		spa_loop_control_iterate(d->control, (end - now + MSEC - 1) / MSEC);
+}
+
+static uint64_t last_expire;
+
+static void on_order(void *data, uint64_t expirations)
+{
+	struct timer *t = data;
+	struct data *d = t->data;
+
+	CHECK(d, "order", get_time_ns() >= t->expire);
+	CHECK(d, "order", t->expire >= last_expire);
+	CHECK(d, "order", expirations == 1);
+	last_expire = t->expire;
+	t->n_fired++;
+}
+
+/* arm the timers in a shuffled order, then move and disarm some of them so
+ * that entries are removed from the middle of the heap */
+static void test_order(struct data *d)
+{
+	static struct timer timers[N_TIMERS];
+	uint64_t start = get_time_ns() + 5 * MSEC;
+	uint32_t i, j;
+
+	for (i = 0; i < N_TIMERS; i++) {
+		timers[i].data = d;
+		timers[i].source = spa_loop_utils_add_timer(d->utils, on_order, &timers[i]);
+		/* a multiplier coprime with N_TIMERS shuffles the expirations,
+		 * make some of them collide */
+		j = (i * 97) % N_TIMERS;
+		timers[i].expire = start + (j / 2) * 100000;
+		CHECK(d, "order", arm_timer(&timers[i], timers[i].expire, 0, true) == 0);
+	}
+	for (i = 0; i < N_TIMERS; i += 3) {
+		if (i % 2) {
+			timers[i].expire = 0;
+			arm_timer(&timers[i], 0, 0, true);
+		} else {
+			timers[i].expire = start + (N_TIMERS - i) * 50000;
+			arm_timer(&timers[i], timers[i].expire, 0, true);
+		}
+	}
+
+	last_expire = 0;
+	iterate_until(d, start + N_TIMERS * 100000 + 5 * MSEC);
+
+	for (i = 0; i < N_TIMERS; i++) {
+		CHECK(d, "order", timers[i].n_fired == (timers[i].expire ? 1 : 0));
+		spa_loop_utils_destroy_source(d->utils, timers[i].source);
+	}
+}
+
+static void on_periodic(void *data, uint64_t expirations)
+{
+	struct timer *t = data;
+
+	t->n_fired++;
+	t->last = t->expirations;
+	t->expirations += expirations;
+}
+
+/* a periodic timer that is not dispatched for a while reports all the
+ * expirations it missed in one callback */
+static void test_missed(struct data *d)
+{
+	struct timer t = { d, };
+	uint64_t start = get_time_ns();
+
+	t.source = spa_loop_utils_add_timer(d->utils, on_periodic, &t);
+	arm_timer(&t, 20 * MSEC, 20 * MSEC, false);
+
+	usleep(110 * 1000);
+	iterate_until(d, start + 110 * MSEC);
+	spa_loop_control_iterate(d->control, 0);
+
+	CHECK(d, "missed", t.n_fired == 1);
+	CHECK(d, "missed", t.expirations >= 5 && t.expirations <= 6);
+
+	/* dispatched in time, it expires once per callback again */
+	iterate_until(d, start + 190 * MSEC);
+	CHECK(d, "missed", t.n_fired >= 3);
+	CHECK(d, "missed", t.expirations >= 8 && t.expirations <= 10);
+	CHECK(d, "missed", t.expirations - t.last == 1);
+
+	spa_loop_utils_destroy_source(d->utils, t.source);
+}
+
+/* a zero value disarms the timer, also a periodic one */
+static void test_disarm(struct data *d)
+{
+	struct timer t1 = { d, }, t2 = { d, }, t3 = { d, };
+	struct timespec zero = { 0, };
+
+	t1.source = spa_loop_utils_add_timer(d->utils, on_periodic, &t1);
+	t2.source = spa_loop_utils_add_timer(d->utils, on_periodic, &t2);
+	t3.source = spa_loop_utils_add_timer(d->utils, on_periodic, &t3);
+	arm_timer(&t1, 5 * MSEC, 0, false);
+	arm_timer(&t2, 5 * MSEC, 5 * MSEC, false);
+	arm_timer(&t3, 10 * MSEC, 0, false);
+
+	spa_loop_utils_update_timer(d->utils, t1.source, &zero, NULL, false);
+	spa_loop_utils_update_timer(d->utils, t2.source, NULL, NULL, false);
+
+	iterate_until(d, get_time_ns() + 30 * MSEC);
+
+	CHECK(d, "disarm", t1.n_fired == 0);
+	CHECK(d, "disarm", t2.n_fired == 0);
+	CHECK(d, "disarm", t3.n_fired == 1);
+
+	spa_loop_utils_destroy_source(d->utils, t1.source);
+	spa_loop_utils_destroy_source(d->utils, t2.source);
+	spa_loop_utils_destroy_source(d->utils, t3.source);
+}
+
+static void on_rearm(void *data, uint64_t expirations)
+{
+	struct timer *t = data;
+
+	t->n_fired++;
+	if (t->disarm) {
+		arm_timer(t->disarm, 0, 0, false);
+		t->disarm = NULL;
+	}
+	if (t->n_rearm > 0) {
+		t->n_rearm--;
+		/* a periodic timer turns into a one-shot one */
+		arm_timer(t, 2 * MSEC, 0, false);
+	}
+}
+
+/* the callbacks update timers while the loop walks the heap */
+static void test_rearm(struct data *d)
+{
+	struct timer t1 = { d, }, t2 = { d, }, t3 = { d, };
+
+	t1.source = spa_loop_utils_add_timer(d->utils, on_rearm, &t1);
+	t2.source = spa_loop_utils_add_timer(d->utils, on_rearm, &t2);
+	t3.source = spa_loop_utils_add_timer(d->utils, on_rearm, &t3);
+
+	t1.n_rearm = 4;
+	t1.disarm = &t3;
+	arm_timer(&t1, 2 * MSEC, 1 * MSEC, false);
+	/* expires in the same dispatch as t1 and re-arms to the same time */
+	t2.n_rearm = 4;
+	arm_timer(&t2, 2 * MSEC, 0, false);
+	arm_timer(&t3, 20 * MSEC, 0, false);
+
+	iterate_until(d, get_time_ns() + 40 * MSEC);
+
+	CHECK(d, "rearm", t1.n_fired == 5);
+	CHECK(d, "rearm", t2.n_fired == 5);
+	CHECK(d, "rearm", t3.n_fired == 0);
+
+	spa_loop_utils_destroy_source(d->utils, t1.source);
+	spa_loop_utils_destroy_source(d->utils, t2.source);
+	spa_loop_utils_destroy_source(d->utils, t3.source);
+}
+
+static int make_loop(struct data *data, const char *backend)
+{
+	struct spa_dict_item items[1];
+	struct spa_dict info = SPA_DICT_INIT(items, 0);
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	void *hnd, *iface;
+	uint32_t i;
+	int res;
+
+	if ((hnd = dlopen("build/spa/plugins/support/libspa-support.so", RTLD_NOW)) == NULL) {
+		printf("can't load libspa-support.so: %s\n", dlerror());
+		return -errno;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return -errno;
+	}
+
+	for (i = 0;;) {
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			printf("can't find the loop factory\n");
+			return res == 0 ? -ENOENT : res;
+		}
+		if (strcmp(factory->name, "loop") == 0)
+			break;
+	}
+
+	if (backend)
+		items[info.n_items++] = SPA_DICT_ITEM_INIT(SPA_LOOP_INFO_BACKEND, backend);
+
+	data->handle = calloc(1, factory->size);
+	if ((res = spa_handle_factory_init(factory, data->handle, &info,
+					   data->support, data->n_support)) < 0) {
+		printf("can't make factory instance: %d\n", res);
+		return res;
+	}
+	if ((res = spa_handle_get_interface(data->handle,
+			spa_type_map_get_id(data->map, SPA_TYPE__LoopControl), &iface)) < 0)
+		return res;
+	data->control = iface;
+	if ((res = spa_handle_get_interface(data->handle,
+			spa_type_map_get_id(data->map, SPA_TYPE__LoopUtils), &iface)) < 0)
+		return res;
+	data->utils = iface;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { NULL };
+
+	data.map = &default_map.map;
+	data.log = &default_log.log;
+	data.log->level = SPA_LOG_LEVEL_WARN;
+
+	data.support[0] = SPA_SUPPORT_INIT(SPA_TYPE__TypeMap, data.map);
+	data.support[1] = SPA_SUPPORT_INIT(SPA_TYPE__Log, data.log);
+	data.n_support = 2;
+
+	if (make_loop(&data, argc > 1 ? argv[1] : NULL) < 0)
+		return -1;
+
+	spa_loop_control_enter(data.control);
+	test_order(&data);
+	test_missed(&data);
+	test_disarm(&data);
+	test_rearm(&data);
+	spa_loop_control_leave(data.control);
+
+	printf("loop timers: %s\n", data.n_failed ? "failed" : "ok");
+
+	spa_handle_clear(data.handle);
+	free(data.handle);
+
+	return data.n_failed ? -1 : 0;
+}
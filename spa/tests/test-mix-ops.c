@@ -0,0 +1,198 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mix-ops.h"
+
+#define MAX_SAMPLES	1024
+#define MAX_OFFSET	3
+
+static const double scales[] = { 0.0, 0.25, 1.0, 1.7, -0.5, 20.0 };
+static const int strides[] = { 1, 2, 3 };
+
+static int16_t src_s16[MAX_SAMPLES * 3 + MAX_OFFSET];
+static int16_t dst_s16[MAX_SAMPLES * 3 + MAX_OFFSET];
+static float src_f32[MAX_SAMPLES * 3 + MAX_OFFSET];
+static float dst_f32[MAX_SAMPLES * 3 + MAX_OFFSET];
+
+static uint8_t ref[sizeof(dst_f32)];
+static int n_failed;
+
+static void fill(unsigned int seed)
+{
+	int i;
+
+	srandom(seed);
+	for (i = 0; i < SPA_N_ELEMENTS(src_s16); i++) {
+		src_s16[i] = (random() & 0xffff) - 0x8000;
+		dst_s16[i] = (random() & 0xffff) - 0x8000;
+		src_f32[i] = (random() / (float) RAND_MAX) * 2.0f - 1.0f;
+		dst_f32[i] = (random() / (float) RAND_MAX) * 2.0f - 1.0f;
+	}
+}
+
+static void *dst_of(int fmt)
+{
+	return fmt == FMT_S16 ? (void *) dst_s16 : (void *) dst_f32;
+}
+
+static size_t size_of(int fmt)
+{
+	return fmt == FMT_S16 ? sizeof(dst_s16) : sizeof(dst_f32);
+}
+
+static void *sample(void *data, int fmt, int offset)
+{
+	return fmt == FMT_S16 ? (void *) ((int16_t *) data + offset) :
+				(void *) ((float *) data + offset);
+}
+
+static const char *fmt_name(int fmt)
+{
+	return fmt == FMT_S16 ? "s16" : "f32";
+}
+
+static void check(const char *name, int fmt, int n_samples, int offset, double scale)
+{
+	if (memcmp(ref, dst_of(fmt), size_of(fmt)) == 0)
+		return;
+
+	printf("%s_%s: mismatch, %d samples offset %d scale %f\n",
+			name, fmt_name(fmt), n_samples, offset, scale);
+	n_failed++;
+}
+
+/* run the op of \a ops and of the C \a ref_ops on the same data and
+ * compare the complete destination */
+#define TEST_OP(op,...)								\
+	fill(seed);								\
+	ref_ops->op[fmt](sample(dst_of(fmt), fmt, offset), __VA_ARGS__);	\
+	memcpy(ref, dst_of(fmt), size_of(fmt));					\
+	fill(seed);								\
+	ops->op[fmt](sample(dst_of(fmt), fmt, offset), __VA_ARGS__);		\
+	check(#op, fmt, n_samples, offset, scale);
+
+static void test_ops(const struct spa_audiomixer_ops *ops, const struct spa_audiomixer_ops *ref_ops)
+{
+	int fmt, n_samples, offset, i, j;
+
+	/* the vector versions only replace the s16 and f32 ops */
+	for (fmt = FMT_S16; fmt <= FMT_F32; fmt++) {
+		const void *src = fmt == FMT_S16 ? (void *) src_s16 : (void *) src_f32;
+		int sample_size = fmt == FMT_S16 ? sizeof(int16_t) : sizeof(float);
+
+		for (n_samples = 0; n_samples <= MAX_SAMPLES; n_samples += n_samples < 70 ? 1 : 191) {
+			int n_bytes = n_samples * sample_size;
+
+			for (offset = 0; offset <= MAX_OFFSET; offset++) {
+				const void *s = sample((void *) src, fmt, MAX_OFFSET - offset);
+				unsigned int seed = n_samples * 7 + offset;
+				double scale = 1.0;
+
+				TEST_OP(add, s, n_bytes);
+				for (j = 0; j < SPA_N_ELEMENTS(strides); j++) {
+					TEST_OP(add_i, strides[j], s, strides[j], n_bytes);
+				}
+				for (i = 0; i < SPA_N_ELEMENTS(scales); i++) {
+					scale = scales[i];
+					TEST_OP(copy_scale, s, scale, n_bytes);
+					TEST_OP(add_scale, s, scale, n_bytes);
+					for (j = 0; j < SPA_N_ELEMENTS(strides); j++) {
+						TEST_OP(copy_scale_i, strides[j], s, strides[j],
+								scale, n_bytes);
+						TEST_OP(add_scale_i, strides[j], s, strides[j],
+								scale, n_bytes);
+					}
+				}
+			}
+		}
+	}
+}
+
+#define CHECK(name,cond)						\
+	if (!(cond)) {							\
+		printf("%s: unexpected result\n", name);		\
+		n_failed++;						\
+	}
+
+/* the C versions of the formats without vector versions, mostly the
+ * clipping */
+static void test_wide_formats(const struct spa_audiomixer_ops *ops)
+{
+	int32_t s32[4] = { 0x007fff00, -0x00800000, INT32_MAX, INT32_MIN };
+	int32_t d32[4] = { 0x00000100, -0x00000001, 1, -1 };
+	double f64[4] = { 0.5, -0.25, 1.0, 2.0 }, o64[4];
+
+	ops->add[FMT_S24_32](d32, s32, 2 * sizeof(int32_t));
+	CHECK("add_s24_32", d32[0] == 0x007fffff && d32[1] == -0x00800000);
+
+	/* negative samples without the sign in the upper byte */
+	d32[0] = 0x00ffffff;
+	d32[1] = 0x00800000;
+	ops->add[FMT_S24_32](d32, s32, 2 * sizeof(int32_t));
+	CHECK("add_s24_32 negative", d32[0] == 0x007ffeff && d32[1] == -0x00800000);
+
+	ops->add[FMT_S32](&d32[2], &s32[2], 2 * sizeof(int32_t));
+	CHECK("add_s32", d32[2] == INT32_MAX && d32[3] == INT32_MIN);
+
+	ops->copy_scale[FMT_S32](d32, s32, 2.0, sizeof(d32));
+	CHECK("copy_scale_s32", d32[0] == 0x00fffe00 && d32[1] == -0x01000000 &&
+				d32[2] == INT32_MAX && d32[3] == INT32_MIN);
+
+	ops->add_scale_i[FMT_S24_32](d32, 2, s32, 2, 2.0, 2 * sizeof(int32_t));
+	CHECK("add_scale_s24_32_i", d32[0] == 0x007fffff && d32[1] == -0x01000000 &&
+				    d32[2] == -3);
+
+	ops->copy_scale[FMT_F64](o64, f64, 0.5, sizeof(o64));
+	ops->add[FMT_F64](o64, f64, sizeof(o64));
+	CHECK("add_f64", o64[0] == 0.75 && o64[1] == -0.375 && o64[2] == 1.5 && o64[3] == 3.0);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		uint32_t flags;
+	} cpus[] = {
+		{ "sse2", MIX_CPU_FLAG_SSE2 },
+		{ "avx2", MIX_CPU_FLAG_SSE2 | MIX_CPU_FLAG_AVX2 },
+	};
+	struct spa_audiomixer_ops ref_ops, ops;
+	uint32_t cpu_flags = spa_audiomixer_get_cpu_flags();
+	int i;
+
+	spa_audiomixer_get_ops(&ref_ops, 0);
+
+	test_wide_formats(&ref_ops);
+	printf("wide formats: %s\n", n_failed ? "failed" : "ok");
+
+	for (i = 0; i < SPA_N_ELEMENTS(cpus); i++) {
+		if ((cpus[i].flags & cpu_flags) != cpus[i].flags) {
+			printf("%s: not supported\n", cpus[i].name);
+			continue;
+		}
+		spa_audiomixer_get_ops(&ops, cpus[i].flags);
+		test_ops(&ops, &ref_ops);
+		printf("%s: %s\n", cpus[i].name, n_failed ? "failed" : "ok");
+	}
+	return n_failed ? -1 : 0;
+}
@@ -0,0 +1,238 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "volume-ops.h"
+
+#define MAX_FRAMES	4096
+#define MAX_SAMPLES	(MAX_FRAMES * 8)
+
+static const uint32_t channels[] = { 1, 2, 3, 6, 8 };
+static const uint32_t ramps[] = { 0, 1, 100, 3000 };
+static const uint32_t chunks[] = { 1, 37, 1024, MAX_FRAMES };
+
+static union {
+	int16_t s16[MAX_SAMPLES];
+	int32_t s32[MAX_SAMPLES];
+	float f32[MAX_SAMPLES];
+} src, dst, ref;
+
+static int n_failed;
+
+static const char *fmt_name(uint32_t fmt)
+{
+	static const char *names[] = { "s16", "s32", "f32" };
+	return names[fmt];
+}
+
+static uint32_t sample_size(uint32_t fmt)
+{
+	return fmt == VOL_FMT_S16 ? sizeof(int16_t) : sizeof(int32_t);
+}
+
+static void fill(uint32_t fmt, uint32_t n_samples)
+{
+	uint32_t i;
+
+	srandom(n_samples);
+	for (i = 0; i < n_samples; i++) {
+		switch (fmt) {
+		case VOL_FMT_S16:
+			src.s16[i] = (random() & 0xffff) - 0x8000;
+			break;
+		case VOL_FMT_S32:
+			src.s32[i] = (random() & 0xffffffff) - 0x80000000LL;
+			break;
+		case VOL_FMT_F32:
+			src.f32[i] = (random() / (float) RAND_MAX) * 2.0f - 1.0f;
+			break;
+		}
+	}
+}
+
+static void set_gains(float *gains, uint32_t n_channels, float base)
+{
+	uint32_t c;
+
+	for (c = 0; c < n_channels; c++)
+		gains[c] = base * (c + 1) / n_channels;
+}
+
+/* the gain of \a frame, computed from scratch with doubles */
+static double ref_gain(double from, double to, enum spa_volume_curve curve,
+		       uint32_t ramp, uint32_t frame)
+{
+	if (frame >= ramp)
+		return to;
+	if (curve == VOLUME_CURVE_EXPONENTIAL) {
+		from = SPA_MAX(from, VOLUME_MIN_GAIN);
+		to = SPA_MAX(to, VOLUME_MIN_GAIN);
+		return from * pow(to / from, (double) frame / ramp);
+	}
+	return from + (to - from) * frame / ramp;
+}
+
+static void ref_process(uint32_t fmt, const float *from, const float *to, enum spa_volume_curve curve,
+			uint32_t ramp, uint32_t n_channels, uint32_t n_frames)
+{
+	uint32_t n, c, i;
+	double g, t;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++) {
+			g = ref_gain(from[c], to[c], curve, ramp, n);
+			i = n * n_channels + c;
+
+			switch (fmt) {
+			case VOL_FMT_S16:
+				t = rint(src.s16[i] * g);
+				ref.s16[i] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+				break;
+			case VOL_FMT_S32:
+				t = rint(src.s32[i] * g);
+				ref.s32[i] = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+				break;
+			case VOL_FMT_F32:
+				ref.f32[i] = src.f32[i] * g;
+				break;
+			}
+		}
+	}
+}
+
+/* the ramps step the gains with floats, allow for that */
+static bool compare(uint32_t fmt, uint32_t n_samples)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_samples; i++) {
+		switch (fmt) {
+		case VOL_FMT_S16:
+			if (abs(dst.s16[i] - ref.s16[i]) > 1)
+				return false;
+			break;
+		case VOL_FMT_S32:
+			if (fabs((double) dst.s32[i] - ref.s32[i]) > 1.0 + fabs(ref.s32[i]) * 1e-5)
+				return false;
+			break;
+		case VOL_FMT_F32:
+			if (fabsf(dst.f32[i] - ref.f32[i]) > 1e-5f)
+				return false;
+			break;
+		}
+	}
+	return true;
+}
+
+/* process from \a from to \a to in chunks and compare with the reference */
+static void test_ramps(const struct spa_volume_ops *ops)
+{
+	struct spa_volume_state state;
+	float from[VOLUME_MAX_CHANNELS], to[VOLUME_MAX_CHANNELS];
+	uint32_t fmt, ch, r, k, curve, pos, n;
+
+	for (fmt = 0; fmt < VOL_FMT_MAX; fmt++) {
+		for (ch = 0; ch < SPA_N_ELEMENTS(channels); ch++) {
+			uint32_t n_channels = channels[ch];
+			uint32_t stride = n_channels * sample_size(fmt);
+
+			fill(fmt, MAX_FRAMES * n_channels);
+
+			for (curve = VOLUME_CURVE_LINEAR; curve <= VOLUME_CURVE_EXPONENTIAL; curve++) {
+				for (r = 0; r < SPA_N_ELEMENTS(ramps); r++) {
+					for (k = 0; k < SPA_N_ELEMENTS(chunks); k++) {
+						set_gains(from, n_channels, r & 1 ? 0.0f : 1.0f);
+						set_gains(to, n_channels, r & 1 ? 1.5f : 0.25f);
+
+						spa_volume_state_init(&state, ops, fmt, n_channels);
+						spa_volume_state_set(&state, from, curve, 0);
+						spa_volume_state_set(&state, to, curve, ramps[r]);
+
+						for (pos = 0; pos < MAX_FRAMES; pos += n) {
+							n = SPA_MIN(chunks[k], MAX_FRAMES - pos);
+							spa_volume_state_process(&state,
+								SPA_MEMBER(&dst, pos * stride, void),
+								SPA_MEMBER(&src, pos * stride, void), n);
+						}
+						ref_process(fmt, from, to, curve, ramps[r],
+							    n_channels, MAX_FRAMES);
+
+						if (!compare(fmt, MAX_FRAMES * n_channels)) {
+							printf("%s: %u channels, curve %u, ramp %u, "
+							       "chunk %u differs\n", fmt_name(fmt),
+							       n_channels, curve, ramps[r], chunks[k]);
+							n_failed++;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/* constant gains must give exactly the same result as the C version */
+static void test_apply(const struct spa_volume_ops *ops, const struct spa_volume_ops *ref_ops)
+{
+	float gains[VOLUME_MAX_CHANNELS];
+	uint32_t fmt, ch, n_frames;
+
+	for (fmt = 0; fmt < VOL_FMT_MAX; fmt++) {
+		for (ch = 0; ch < SPA_N_ELEMENTS(channels); ch++) {
+			uint32_t n_channels = channels[ch];
+
+			for (n_frames = 0; n_frames < 70; n_frames++) {
+				fill(fmt, MAX_FRAMES * n_channels);
+				set_gains(gains, n_channels, 3.0f);
+
+				ref_ops->apply[fmt](&ref, &src, gains, n_channels, n_frames);
+				ops->apply[fmt](&dst, &src, gains, n_channels, n_frames);
+
+				if (memcmp(&ref, &dst, n_frames * n_channels * sample_size(fmt)) != 0) {
+					printf("apply_%s: %u channels, %u frames differs\n",
+					       fmt_name(fmt), n_channels, n_frames);
+					n_failed++;
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_volume_ops ref_ops, ops;
+	uint32_t cpu_flags = spa_volume_get_cpu_flags();
+
+	spa_volume_get_ops(&ref_ops, 0);
+	test_ramps(&ref_ops);
+	printf("c: %s\n", n_failed ? "failed" : "ok");
+
+	if (cpu_flags & VOLUME_CPU_FLAG_SSE2) {
+		spa_volume_get_ops(&ops, VOLUME_CPU_FLAG_SSE2);
+		test_apply(&ops, &ref_ops);
+		test_ramps(&ops);
+		printf("sse2: %s\n", n_failed ? "failed" : "ok");
+	} else {
+		printf("sse2: not supported\n");
+	}
+	return n_failed ? -1 : 0;
+}
@@ -21,6 +21,7 @@
 
 #include <pipewire/pipewire.h>
 #include <pipewire/core.h>
+#include <pipewire/data-loop.h>
 #include <pipewire/module.h>
 
 #include "daemon-config.h"
@@ -38,6 +39,7 @@ int main(int argc, char *argv[])
 	struct pw_daemon_config *config;
 	char *err = NULL;
 	struct pw_properties *props;
+	const char *str;
 
 	pw_init(&argc, &argv);
 
@@ -51,6 +53,16 @@ int main(int argc, char *argv[])
 
 	props = pw_properties_new(PW_CORE_PROP_NAME, "pipewire-0",
 				  PW_CORE_PROP_DAEMON, "1", NULL);
+	if ((str = getenv("PIPEWIRE_DATA_WORKERS")) != NULL)
+		pw_properties_set(props, PW_CORE_PROP_DATA_WORKERS, str);
+	if ((str = getenv("PIPEWIRE_LOOP_BACKEND")) != NULL)
+		pw_properties_set(props, PW_LOOP_PROP_BACKEND, str);
+	if ((str = getenv("PIPEWIRE_LOOP_PROFILE")) != NULL)
+		pw_properties_set(props, PW_LOOP_PROP_PROFILE, str);
+	if ((str = getenv("PIPEWIRE_DATA_LOOP_SPIN")) != NULL)
+		pw_properties_set(props, PW_DATA_LOOP_PROP_SPIN, str);
+	if ((str = getenv("PIPEWIRE_STATS_INTERVAL")) != NULL)
+		pw_properties_set(props, PW_CORE_PROP_STATS_INTERVAL, str);
 
 	loop = pw_main_loop_new(props);
 	pw_loop_add_signal(pw_main_loop_get_loop(loop), SIGINT, do_quit, loop);
@@ -44,6 +44,10 @@ struct pw_client_node_area {
 	uint32_t n_input_ports;		/**< number of input ports of the node */
 	uint32_t max_output_ports;	/**< max output ports of the node */
 	uint32_t n_output_ports;	/**< number of output ports of the node */
+	uint64_t signal_time;		/**< when the server woke up the client, nsec */
+	uint64_t start_time;		/**< when the client started processing, nsec */
+	uint64_t end_time;		/**< when the client finished processing, nsec */
+	uint32_t quantum;		/**< quantum of the server graph in samples */
 };
 
 /** \class pw_client_node_transport
@@ -59,9 +63,9 @@ struct pw_client_node_transport {
 	struct spa_io_buffers *inputs;		/**< array of buffer input io */
 	struct spa_io_buffers *outputs;		/**< array of buffer output io */
 	void *input_data;			/**< input memory for ringbuffer */
-	struct spa_ringbuffer *input_buffer;	/**< ringbuffer for input memory */
+	struct spa_ringbuffer_padded *input_buffer;	/**< ringbuffer for input memory */
 	void *output_data;			/**< output memory for ringbuffer */
-	struct spa_ringbuffer *output_buffer;	/**< ringbuffer for output memory */
+	struct spa_ringbuffer_padded *output_buffer;	/**< ringbuffer for output memory */
 
 	/** Destroy a transport
 	 * \param trans a transport to destroy
@@ -23,6 +23,8 @@
 
 #include "config.h"
 
+#include <spa/param/format-utils.h>
+
 #include "pipewire/core.h"
 #include "pipewire/interfaces.h"
 #include "pipewire/link.h"
@@ -30,10 +32,15 @@
 #include "pipewire/module.h"
 #include "pipewire/control.h"
 #include "pipewire/private.h"
+#include "modules/spa/spa-node.h"
+
+#define AUDIOCONVERT_LIB "audioconvert/libspa-audioconvert"
 
 struct impl {
 	struct pw_core *core;
 	struct pw_type *t;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
 	struct pw_module *module;
 	struct pw_properties *properties;
 
@@ -51,6 +58,7 @@ struct node_info {
 	struct spa_hook node_listener;
 
 	struct spa_list links;
+	struct spa_list converters;
 };
 
 struct link_data {
@@ -61,6 +69,14 @@ struct link_data {
 	struct spa_hook link_listener;
 };
 
+struct convert_data {
+	struct spa_list l;
+
+	struct node_info *node_info;
+	struct pw_node *node;
+	struct spa_hook node_listener;
+};
+
 static struct node_info *find_node_info(struct impl *impl, struct pw_node *node)
 {
 	struct node_info *info;
@@ -84,11 +100,14 @@ static void link_data_remove(struct link_data *data)
 static void node_info_free(struct node_info *info)
 {
 	struct link_data *ld, *t;
+	struct convert_data *cd, *ct;
 
 	spa_list_remove(&info->l);
 	spa_hook_remove(&info->node_listener);
 	spa_list_for_each_safe(ld, t, &info->links, l)
 		link_data_remove(ld);
+	spa_list_for_each_safe(cd, ct, &info->converters, l)
+		pw_node_destroy(cd->node);
 	free(info);
 }
 
@@ -175,6 +194,158 @@ static const struct pw_link_events link_events = {
 	.state_changed = link_state_changed,
 };
 
+static bool can_link(struct impl *impl, struct pw_port *port, struct pw_port *target)
+{
+	uint8_t buf[4096];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buf, sizeof(buf));
+	struct spa_pod *format;
+	char *error = NULL;
+	int res;
+
+	if (pw_port_get_direction(port) == PW_DIRECTION_INPUT)
+		res = pw_core_find_format(impl->core, target, port, NULL, 0, NULL,
+					  &format, &b, &error);
+	else
+		res = pw_core_find_format(impl->core, port, target, NULL, 0, NULL,
+					  &format, &b, &error);
+	free(error);
+
+	return res >= 0;
+}
+
+struct raw_audio {
+	struct impl *impl;
+	bool found;
+};
+
+static int find_raw_audio(void *data, struct spa_pod *param)
+{
+	struct raw_audio *d = data;
+	uint32_t media_type, media_subtype;
+
+	if (spa_pod_object_parse(param, "I", &media_type, "I", &media_subtype) < 0)
+		return 0;
+
+	d->found = media_type == d->impl->media_type.audio &&
+		   media_subtype == d->impl->media_subtype.raw;
+	return d->found ? 1 : 0;
+}
+
+static bool is_raw_audio(struct impl *impl, struct pw_port *port)
+{
+	struct raw_audio d = { impl, false };
+
+	pw_port_for_each_param(port, impl->t->param.idEnumFormat, NULL, find_raw_audio, &d);
+	return d.found;
+}
+
+/* the converter only handles raw audio, check both ends before loading one */
+static bool can_convert(struct impl *impl, struct pw_port *port, struct pw_port *target)
+{
+	return is_raw_audio(impl, port) && is_raw_audio(impl, target);
+}
+
+static int make_link(struct impl *impl, struct node_info *info,
+		     struct pw_port *port, struct pw_port *target, char **error)
+{
+	struct pw_link *link;
+	struct link_data *ld;
+
+	if (pw_port_get_direction(port) == PW_DIRECTION_INPUT) {
+	        struct pw_port *tmp = target;
+		target = port;
+		port = tmp;
+	}
+
+	link = pw_link_new(impl->core,
+			   port, target,
+			   NULL, NULL,
+			   error,
+			   sizeof(struct link_data));
+	if (link == NULL)
+		return -EINVAL;
+
+	ld = pw_link_get_user_data(link);
+	ld->link = link;
+	ld->node_info = info;
+	pw_link_add_listener(link, &ld->link_listener, &link_events, ld);
+
+	spa_list_append(&info->links, &ld->l);
+	pw_link_register(link, NULL, pw_module_get_global(impl->module), NULL);
+
+	try_link_controls(impl, port, target);
+
+	return 0;
+}
+
+static void convert_destroy(void *data)
+{
+	struct convert_data *cd = data;
+
+	spa_list_remove(&cd->l);
+	spa_hook_remove(&cd->node_listener);
+}
+
+static const struct pw_node_events convert_events = {
+	PW_VERSION_NODE_EVENTS,
+	.destroy = convert_destroy,
+};
+
+/* \a target can't take the format of \a port, put an audioconvert node in
+ * between. It runs in the data loop of \a node and only changes the sample
+ * format and the layout, rate and channels still have to match */
+static int link_with_converter(struct impl *impl, struct node_info *info, struct pw_node *node,
+			       struct pw_port *port, struct pw_port *target, char **error)
+{
+	const struct pw_properties *props = pw_node_get_properties(node);
+	enum pw_direction direction = pw_port_get_direction(port);
+	struct pw_properties *conv_props = NULL;
+	struct convert_data *cd;
+	struct pw_node *conv;
+	struct pw_port *conv_port, *conv_other;
+	const char *str;
+	int res;
+
+	if ((str = pw_properties_get(props, PW_NODE_PROP_DATA_LOOP)) != NULL)
+		conv_props = pw_properties_new(PW_NODE_PROP_DATA_LOOP, str, NULL);
+
+	conv = pw_spa_node_load(impl->core, NULL, pw_module_get_global(impl->module),
+				AUDIOCONVERT_LIB, "audioconvert", "audioconvert",
+				PW_SPA_NODE_FLAG_ACTIVATE, conv_props,
+				sizeof(struct convert_data));
+	if (conv == NULL) {
+		asprintf(error, "can't load converter");
+		return -ENOENT;
+	}
+
+	cd = pw_spa_node_get_user_data(conv);
+	cd->node_info = info;
+	cd->node = conv;
+	spa_list_append(&info->converters, &cd->l);
+	pw_node_add_listener(conv, &cd->node_listener, &convert_events, cd);
+
+	conv_port = pw_node_get_free_port(conv, pw_direction_reverse(direction));
+	conv_other = pw_node_get_free_port(conv, direction);
+	if (conv_port == NULL || conv_other == NULL ||
+	    !can_link(impl, port, conv_port) || !can_link(impl, conv_other, target)) {
+		asprintf(error, "format can't be converted");
+		res = -EINVAL;
+		goto error;
+	}
+
+	pw_log_debug("module %p: link through converter %p", impl, conv);
+
+	if ((res = make_link(impl, info, port, conv_port, error)) < 0 ||
+	    (res = make_link(impl, info, conv_other, target, error)) < 0)
+		goto error;
+
+	return 0;
+
+      error:
+	pw_node_destroy(conv);
+	return res;
+}
+
 static void try_link_port(struct pw_node *node, struct pw_port *port, struct node_info *info)
 {
 	struct impl *impl = info->impl;
@@ -182,11 +353,10 @@ static void try_link_port(struct pw_node *node, struct pw_port *port, struct nod
 	const char *str;
 	uint32_t path_id;
 	char *error = NULL;
-	struct pw_link *link;
 	struct pw_port *target;
-	struct link_data *ld;
 	struct pw_global *global = pw_node_get_global(info->node);
 	struct pw_client *owner = pw_global_get_owner(global);
+	int res;
 
 	props = pw_node_get_properties(node);
 
@@ -208,30 +378,18 @@ static void try_link_port(struct pw_node *node, struct pw_port *port, struct nod
 	if (target == NULL)
 		goto error;
 
-	if (pw_port_get_direction(port) == PW_DIRECTION_INPUT) {
-	        struct pw_port *tmp = target;
-		target = port;
-		port = tmp;
+	/* the port of a target node is picked without looking at the format */
+	if (can_link(impl, port, target))
+		res = make_link(impl, info, port, target, &error);
+	else if (can_convert(impl, port, target))
+		res = link_with_converter(impl, info, node, port, target, &error);
+	else {
+		asprintf(&error, "no common format and no conversion possible");
+		res = -EINVAL;
 	}
-
-	link = pw_link_new(impl->core,
-			   port, target,
-			   NULL, NULL,
-			   &error,
-			   sizeof(struct link_data));
-	if (link == NULL)
+	if (res < 0)
 		goto error;
 
-	ld = pw_link_get_user_data(link);
-	ld->link = link;
-	ld->node_info = info;
-	pw_link_add_listener(link, &ld->link_listener, &link_events, ld);
-
-	spa_list_append(&info->links, &ld->l);
-	pw_link_register(link, NULL, pw_module_get_global(impl->module), NULL);
-
-	try_link_controls(impl, port, target);
-
 	return;
 
       error:
@@ -293,6 +451,7 @@ core_global_added(void *data, struct pw_global *global)
 		ninfo->impl = impl;
 		ninfo->node = node;
 		spa_list_init(&ninfo->links);
+		spa_list_init(&ninfo->converters);
 
 		spa_list_append(&impl->node_list, &ninfo->l);
 		pw_node_add_listener(node, &ninfo->node_listener, &node_events, ninfo);
@@ -370,6 +529,8 @@ static int module_init(struct pw_module *module, struct pw_properties *propertie
 
 	impl->core = core;
 	impl->t = pw_core_get_type(core);
+	spa_type_media_type_map(impl->t->map, &impl->media_type);
+	spa_type_media_subtype_map(impl->t->map, &impl->media_subtype);
 	impl->module = module;
 	impl->properties = properties;
 
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <errno.h>
 #include <unistd.h>
+#include <time.h>
 #include <fcntl.h>
 #include <dlfcn.h>
 #include <sys/socket.h>
@@ -30,6 +31,7 @@
 
 #include <spa/node/node.h>
 #include <spa/lib/pod.h>
+#include <spa/utils/ringbuffer.h>
 
 #include "pipewire/pipewire.h"
 #include "pipewire/interfaces.h"
@@ -129,6 +131,7 @@ struct impl {
 
 	struct spa_hook node_listener;
 	struct spa_hook resource_listener;
+	struct spa_hook spin_check;
 
 	int fds[2];
 	int other_fds[2];
@@ -197,6 +200,13 @@ static int spa_proxy_node_set_param(struct spa_node *node, uint32_t id, uint32_t
 	return SPA_RESULT_RETURN_ASYNC(this->seq++);
 }
 
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
 static inline void do_flush(struct proxy *this)
 {
 	uint64_t cmd = 1;
@@ -531,6 +541,14 @@ spa_proxy_node_port_set_io(struct spa_node *node,
 
 	if (id == t->io.Buffers)
 		port->io = data;
+	else if (id == t->io.ControlQuantum) {
+		/* the quantum is passed in the transport area on every wakeup */
+		return 0;
+	}
+	else if (id == t->io.ControlClock) {
+		/* client nodes don't drive the graph */
+		return 0;
+	}
 	else {
 		struct pw_memblock *mem;
 		uint32_t memid = this->membase++;
@@ -781,6 +799,8 @@ static int spa_proxy_node_process_input(struct spa_node *node)
 		}
 		pw_client_node_transport_add_message(impl->transport,
 			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT));
+		impl->transport->area->quantum = impl->this.node->rt.quantum->size;
+		impl->transport->area->signal_time = get_time_ns();
 		do_flush(this);
 
 		impl->input_ready--;
@@ -818,11 +838,25 @@ static int spa_proxy_node_process_output(struct spa_node *node)
       done:
 	pw_client_node_transport_add_message(impl->transport,
 			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT));
+	impl->transport->area->quantum = impl->this.node->rt.quantum->size;
+	impl->transport->area->signal_time = get_time_ns();
 	do_flush(this);
 
 	return SPA_STATUS_OK;
 }
 
+/* the client writes its timings in the transport area before it replies */
+static void add_client_stats(struct impl *impl)
+{
+	struct pw_client_node_area *a = impl->transport->area;
+
+	if (a->signal_time == 0 || a->start_time < a->signal_time)
+		return;
+
+	pw_node_add_stats(impl->this.node, a->signal_time, a->start_time, a->end_time);
+	a->signal_time = 0;
+}
+
 static int handle_node_message(struct proxy *this, struct pw_client_node_message *message)
 {
 	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, proxy);
@@ -838,6 +872,7 @@ static int handle_node_message(struct proxy *this, struct pw_client_node_message
 			pw_log_trace("have output %d %d", p->io->status, p->io->buffer_id);
 		}
 		impl->out_pending = false;
+		add_client_stats(impl);
 		this->callbacks->have_output(this->callbacks_data);
 		break;
 
@@ -847,6 +882,7 @@ static int handle_node_message(struct proxy *this, struct pw_client_node_message
 			pw_log_trace("need input %d %d", p->io->status, p->io->buffer_id);
 		}
 		impl->input_ready++;
+		add_client_stats(impl);
 		this->callbacks->need_input(this->callbacks_data);
 		break;
 
@@ -1060,6 +1096,7 @@ proxy_init(struct proxy *this,
 	this->data_source.fd = -1;
 	this->data_source.mask = SPA_IO_IN | SPA_IO_ERR | SPA_IO_HUP;
 	this->data_source.rmask = 0;
+	this->data_source.priority = SPA_SOURCE_PRIORITY_HIGH;
 
 	return SPA_RESULT_RETURN_ASYNC(this->seq++);
 }
@@ -1080,20 +1117,72 @@ static int proxy_clear(struct proxy *this)
 	return 0;
 }
 
+/* the client writes its messages before it signals the eventfd, a
+ * spinning data loop can see them without polling */
+static bool check_transport(void *data)
+{
+	struct impl *impl = data;
+	uint32_t index;
+
+	return spa_ringbuffer_padded_get_read_index(impl->transport->input_buffer, &index, 1) > 0;
+}
+
+static const struct pw_data_loop_spin_check spin_check = {
+	PW_VERSION_DATA_LOOP_SPIN_CHECK,
+	.check = check_transport,
+};
+
+static int
+do_add_spin_check(struct spa_loop *loop,
+		  bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct impl *impl = user_data;
+	pw_data_loop_add_spin_check(impl->this.node->data_loop_impl,
+				    &impl->spin_check, &spin_check, impl);
+	return 0;
+}
+
+static int
+do_remove_spin_check(struct spa_loop *loop,
+		     bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct impl *impl = user_data;
+	spa_hook_remove(&impl->spin_check);
+	return 0;
+}
+
 static void client_node_resource_destroy(void *data)
 {
 	struct impl *impl = data;
 	struct pw_client_node *this = &impl->this;
-	struct proxy *proxy = &impl->proxy;
 
 	pw_log_debug("client-node %p: destroy", impl);
 
 	impl->proxy.resource = this->resource = NULL;
 
-	if (proxy->data_source.fd != -1)
+	pw_node_destroy(this->node);
+}
+
+/* the node can also be destroyed without the resource, when the core goes
+ * away, stop the data loop from using the transport before it is freed */
+static void node_destroy(void *data)
+{
+	struct impl *impl = data;
+	struct pw_client_node *this = &impl->this;
+	struct proxy *proxy = &impl->proxy;
+
+	if (proxy->data_source.fd != -1) {
 		spa_loop_remove_source(proxy->data_loop, &proxy->data_source);
+		pw_loop_invoke(this->node->data_loop, do_remove_spin_check,
+			       1, NULL, 0, true, impl);
+		proxy->data_source.fd = -1;
+	}
 
-	pw_node_destroy(this->node);
+	if (this->resource) {
+		spa_hook_remove(&impl->resource_listener);
+		pw_resource_destroy(this->resource);
+		impl->proxy.resource = this->resource = NULL;
+	}
 }
 
 
@@ -1114,6 +1203,7 @@ static void node_initialized(void *data)
 	impl->other_fds[1] = impl->fds[0];
 
 	spa_loop_add_source(impl->proxy.data_loop, &impl->proxy.data_source);
+	pw_loop_invoke(node->data_loop, do_add_spin_check, 1, NULL, 0, true, impl);
 	pw_log_debug("client-node %p: transport fd %d %d", node, impl->fds[0], impl->fds[1]);
 
 	pw_client_node_resource_transport(this->resource,
@@ -1144,6 +1234,7 @@ static void node_free(void *data)
 
 static const struct pw_node_events node_events = {
 	PW_VERSION_NODE_EVENTS,
+	.destroy = node_destroy,
 	.free = node_free,
 	.initialized = node_initialized,
 };
@@ -1204,6 +1295,8 @@ struct pw_client_node *pw_client_node_new(struct pw_resource *resource,
 	if (this->node == NULL)
 		goto error_no_node;
 
+	this->node->rt.remote_stats = true;
+
 	str = pw_properties_get(properties, "pipewire.client.reuse");
 	impl->client_reuse = str && pw_properties_parse_bool(str);
 
@@ -329,6 +329,8 @@ static struct pw_client *client_new(struct server *s, int fd)
 				      fd, SPA_IO_ERR | SPA_IO_HUP, true, connection_data, this);
 	if (this->source == NULL)
 		goto no_source;
+	/* let the realtime sources go first when many clients are busy */
+	this->source->priority = SPA_SOURCE_PRIORITY_LOW;
 
 	this->connection = pw_protocol_native_connection_new(fd);
 	if (this->connection == NULL)
@@ -467,6 +469,7 @@ static bool add_socket(struct pw_protocol *protocol, struct server *s)
 	s->source = pw_loop_add_io(s->loop, fd, SPA_IO_IN, true, socket_data, s);
 	if (s->source == NULL)
 		goto error_close;
+	s->source->priority = SPA_SOURCE_PRIORITY_LOW;
 
 	return true;
 
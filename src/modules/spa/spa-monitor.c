@@ -34,6 +34,7 @@
 #include <pipewire/log.h>
 #include <pipewire/type.h>
 #include <pipewire/node.h>
+#include <pipewire/private.h>
 
 #include "spa-monitor.h"
 #include "spa-node.h"
@@ -71,6 +72,7 @@ static void add_item(struct pw_spa_monitor *this, struct spa_pod *item)
 	struct pw_type *t = pw_core_get_type(impl->core);
 	const struct spa_support *support;
 	uint32_t n_support;
+	struct pw_data_domain *domain;
 
 	if (spa_pod_object_parse(item,
 			":",t->monitor.name,    "s", &name,
@@ -98,7 +100,11 @@ static void add_item(struct pw_spa_monitor *this, struct spa_pod *item)
 		}
 	}
 
-	support = pw_core_get_support(impl->core, &n_support);
+	if ((domain = pw_core_get_data_domain(impl->core, props)) != NULL) {
+		support = domain->support;
+		n_support = domain->n_support;
+	} else
+		support = pw_core_get_support(impl->core, &n_support);
 
 	handle = calloc(1, factory->size);
 	if ((res = spa_handle_factory_init(factory,
@@ -249,6 +249,7 @@ struct pw_node *pw_spa_node_load(struct pw_core *core,
 	const char *dir;
 	const struct spa_support *support;
 	uint32_t n_support;
+	struct pw_data_domain *domain;
 	struct pw_type *t = pw_core_get_type(core);
 
 	if ((dir = getenv("SPA_PLUGIN_DIR")) == NULL)
@@ -275,7 +276,12 @@ struct pw_node *pw_spa_node_load(struct pw_core *core,
 			break;
 	}
 
-	support = pw_core_get_support(core, &n_support);
+	/* the node runs from the data loop of its domain */
+	if ((domain = pw_core_get_data_domain(core, properties)) != NULL) {
+		support = domain->support;
+		n_support = domain->n_support;
+	} else
+		support = pw_core_get_support(core, &n_support);
 
 	handle = calloc(1, factory->size);
 	if ((res = spa_handle_factory_init(factory,
@@ -16,10 +16,16 @@
  * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
  * Boston, MA 02110-1301, USA.
  */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
 #include <stdio.h>
+#include <inttypes.h>
+#include <dlfcn.h>
 
 #define spa_debug pw_log_trace
 
@@ -33,9 +39,47 @@
 #include <pipewire/core.h>
 #include <pipewire/data-loop.h>
 
-#include <spa/graph/graph-scheduler6.h>
+#include <spa/graph/graph-scheduler7.h>
 
 /** \cond */
+struct domain {
+	struct pw_data_domain this;
+	struct spa_graph_data graph_data;
+};
+
+#define MAX_PROFILE_SOURCES	8
+
+/* the sources of a loop that spent the most time in their callbacks */
+struct loop_profile {
+	struct spa_loop_source_stats stats[MAX_PROFILE_SOURCES];
+	uint32_t n_stats;
+};
+
+struct impl {
+	struct pw_core this;
+
+	struct spa_graph_data graph_data;
+	struct pw_workers *workers;
+
+	struct spa_source *stats_timer;
+	int stats_interval;		/**< configured interval, -1 when not set */
+
+	struct pw_freewheel *freewheel;
+	uint64_t freewheel_cycles;	/**< cycles at the last stats update */
+	uint64_t freewheel_time;	/**< time of the last stats update */
+
+	uint64_t spin_time;		/**< data loop spin time at the last stats update */
+	uint64_t spin_stats_time;	/**< time of the last stats update */
+
+	bool profile;			/**< the data loop collects statistics */
+
+	uint32_t quantum_min;
+	uint32_t quantum_max;
+
+	struct spa_list reclaim_list;
+	struct spa_source *reclaim_event;
+};
+
 struct resource_data {
 	struct spa_hook resource_listener;
 };
@@ -319,6 +363,258 @@ core_bind_func(struct pw_global *global,
 	return -ENOMEM;
 }
 
+static void on_reclaim(void *data, uint64_t count)
+{
+	struct impl *impl = data;
+	struct pw_reclaim *r;
+
+	/* keep the order, later items can still refer to earlier ones */
+	while (!spa_list_is_empty(&impl->reclaim_list)) {
+		r = spa_list_first(&impl->reclaim_list, struct pw_reclaim, link);
+		if (!__atomic_load_n(&r->done, __ATOMIC_ACQUIRE))
+			break;
+		/* r is usually freed by func */
+		spa_list_remove(&r->link);
+		r->func(r->data);
+	}
+}
+
+static int
+do_reclaim(struct spa_loop *loop,
+	   bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_reclaim *r = user_data;
+	struct impl *impl = SPA_CONTAINER_OF(r->core, struct impl, this);
+
+	__atomic_store_n(&r->done, true, __ATOMIC_RELEASE);
+	pw_loop_signal_event(r->core->main_loop, impl->reclaim_event);
+	return 0;
+}
+
+static int
+do_sync(struct spa_loop *loop,
+	bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	return 0;
+}
+
+/** Defer a function until the data thread is done with an object
+ * \param core a core
+ * \param loop the data loop that uses the object
+ * \param reclaim the reclaim item, usually embedded in the object
+ * \param func the function to call
+ * \param data data passed to \a func
+ *
+ * Changes to the graph are queued on the data loop and applied between
+ * two cycles, the data thread can use the old objects until then. The
+ * data loop marks the end of the grace period when it reaches the item
+ * queued here, after which \a func is called from the main loop.
+ *
+ * \memberof pw_core
+ */
+void pw_core_defer_free(struct pw_core *core, struct pw_loop *loop,
+			struct pw_reclaim *reclaim,
+			void (*func) (void *data), void *data)
+{
+	struct impl *impl = SPA_CONTAINER_OF(core, struct impl, this);
+	struct pw_reclaim *r = reclaim;
+	int res;
+
+	r->core = core;
+	r->loop = loop;
+	r->done = false;
+	r->func = func;
+	r->data = data;
+	spa_list_append(&impl->reclaim_list, &r->link);
+
+	if ((res = pw_loop_invoke(loop, do_reclaim, SPA_ID_INVALID, NULL, 0, false, r)) < 0) {
+		/* the async invoke could not allocate, wait for the data
+		 * thread instead, this can't fail */
+		pw_log_warn("core %p: can't queue reclaim: %d", core, res);
+		pw_loop_invoke(loop, do_reclaim, SPA_ID_INVALID, NULL, 0, true, r);
+	}
+}
+
+static void flush_reclaim(struct impl *impl)
+{
+	struct pw_reclaim *r;
+
+	/* the functions can queue new items, like links between two data loops */
+	while (!spa_list_is_empty(&impl->reclaim_list)) {
+		spa_list_for_each(r, &impl->reclaim_list, link) {
+			if (!__atomic_load_n(&r->done, __ATOMIC_ACQUIRE))
+				pw_loop_invoke(r->loop, do_sync, SPA_ID_INVALID, NULL, 0, true, NULL);
+		}
+		on_reclaim(impl, 0);
+	}
+}
+
+static void update_freewheel_rate(struct impl *impl, uint64_t now)
+{
+	uint64_t cycles = pw_freewheel_get_cycles(impl->freewheel);
+	char rate[32];
+
+	if (now <= impl->freewheel_time)
+		return;
+
+	snprintf(rate, sizeof(rate), "%.1f", (double)(cycles - impl->freewheel_cycles) *
+			SPA_NSEC_PER_SEC / (now - impl->freewheel_time));
+	pw_log_info("core %p: freewheel %s quanta/s", impl, rate);
+
+	pw_core_update_properties(&impl->this,
+			&SPA_DICT_INIT(&SPA_DICT_ITEM_INIT(PW_CORE_PROP_FREEWHEEL_RATE, rate), 1));
+
+	impl->freewheel_cycles = cycles;
+	impl->freewheel_time = now;
+}
+
+static void update_spin_load(struct impl *impl, uint64_t now)
+{
+	struct pw_data_loop_stats stats;
+	char load[16];
+
+	pw_data_loop_get_stats(impl->this.data_loop_impl, &stats);
+
+	if (now > impl->spin_stats_time && impl->spin_stats_time != 0) {
+		snprintf(load, sizeof(load), "%.3f", (double)(stats.spin_time - impl->spin_time) /
+				(now - impl->spin_stats_time));
+		pw_core_update_properties(&impl->this,
+				&SPA_DICT_INIT(&SPA_DICT_ITEM_INIT(PW_DATA_LOOP_PROP_SPIN_LOAD, load), 1));
+	}
+	impl->spin_time = stats.spin_time;
+	impl->spin_stats_time = now;
+}
+
+static int collect_profile(struct pw_loop *loop, struct loop_profile *profile)
+{
+	struct spa_loop_source_stats stats;
+	uint32_t index = 0, i;
+	int res;
+
+	profile->n_stats = 0;
+	while ((res = pw_loop_get_stats(loop, &index, &stats)) > 0) {
+		for (i = profile->n_stats; i > 0; i--) {
+			if (profile->stats[i - 1].total_time >= stats.total_time)
+				break;
+			if (i < MAX_PROFILE_SOURCES)
+				profile->stats[i] = profile->stats[i - 1];
+		}
+		if (i < MAX_PROFILE_SOURCES) {
+			profile->stats[i] = stats;
+			if (profile->n_stats < MAX_PROFILE_SOURCES)
+				profile->n_stats++;
+		}
+	}
+	return res;
+}
+
+struct collect_data {
+	struct pw_loop *loop;
+	struct loop_profile *profile;	/**< filled in the loop thread */
+};
+
+static int
+do_collect_profile(struct spa_loop *loop,
+		   bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct collect_data *d = user_data;
+	return collect_profile(d->loop, d->profile);
+}
+
+/* name the callback with its symbol or the offset in its module */
+static void callback_name(const void *func, char *name, size_t size)
+{
+	Dl_info info;
+	const char *module;
+
+	if (dladdr(func, &info) == 0 || info.dli_fname == NULL) {
+		snprintf(name, size, "%p", func);
+		return;
+	}
+	module = strrchr(info.dli_fname, '/');
+	module = module ? module + 1 : info.dli_fname;
+
+	if (info.dli_sname)
+		snprintf(name, size, "%s (%s)", info.dli_sname, module);
+	else
+		snprintf(name, size, "%s+0x%tx", module,
+				(const char *) func - (const char *) info.dli_fbase);
+}
+
+static void update_loop_profile(struct impl *impl, const char *key, struct loop_profile *profile)
+{
+	char str[4096], name[256];
+	size_t len = 0;
+	uint32_t i;
+
+	str[0] = '\0';
+	for (i = 0; i < profile->n_stats && len < sizeof(str); i++) {
+		struct spa_loop_source_stats *s = &profile->stats[i];
+		uint64_t n = SPA_MAX(s->n_dispatch, 1u);
+
+		callback_name(s->func, name, sizeof(name));
+		len += snprintf(str + len, sizeof(str) - len,
+				"%s%s: %" PRIu64 " calls, time avg %.1fus max %.1fus, "
+				"delay avg %.1fus max %.1fus",
+				i > 0 ? "\n" : "", name, s->n_dispatch,
+				s->total_time / n / 1000.0, s->max_time / 1000.0,
+				s->total_delay / n / 1000.0, s->max_delay / 1000.0);
+	}
+	pw_core_update_properties(&impl->this,
+			&SPA_DICT_INIT(&SPA_DICT_ITEM_INIT(key, str), 1));
+}
+
+static void on_stats_timeout(void *data, uint64_t expirations)
+{
+	struct pw_core *this = data;
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct pw_node *node;
+	struct loop_profile profile;
+	struct timespec ts;
+	uint64_t now;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = SPA_TIMESPEC_TO_TIME(&ts);
+
+	spa_list_for_each(node, &this->node_list, link)
+		pw_node_update_stats(node, now);
+
+	if (impl->freewheel)
+		update_freewheel_rate(impl, now);
+	if (this->data_loop_impl->spin > 0)
+		update_spin_load(impl, now);
+
+	if (collect_profile(this->main_loop, &profile) == 0)
+		update_loop_profile(impl, PW_CORE_PROP_MAIN_LOOP_PROFILE, &profile);
+	if (impl->profile) {
+		/* the invoke is blocking so the data can live on the stack */
+		struct collect_data d = { this->data_loop, &profile };
+
+		if (pw_loop_invoke(this->data_loop, do_collect_profile, SPA_ID_INVALID,
+				   NULL, 0, true, &d) == 0)
+			update_loop_profile(impl, PW_CORE_PROP_DATA_LOOP_PROFILE, &profile);
+	}
+}
+
+/* the interval when nothing is configured but something publishes stats */
+#define DEFAULT_STATS_INTERVAL	1000
+
+static void start_stats_timer(struct impl *impl, int interval)
+{
+	struct pw_core *this = &impl->this;
+	struct timespec timeout;
+
+	if (impl->stats_timer != NULL || interval <= 0)
+		return;
+
+	pw_log_debug("core %p: stats every %d ms", this, interval);
+
+	timeout.tv_sec = interval / 1000;
+	timeout.tv_nsec = (interval % 1000) * 1000000;
+	impl->stats_timer = pw_loop_add_timer(this->main_loop, on_stats_timeout, this);
+	pw_loop_update_timer(this->main_loop, impl->stats_timer, &timeout, &timeout, false);
+}
+
 /** Create a new core object
  *
  * \param main_loop the main loop to use
@@ -329,13 +625,16 @@ core_bind_func(struct pw_global *global,
  */
 struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *properties)
 {
+	struct impl *impl;
 	struct pw_core *this;
-	const char *name;
+	const char *name, *str;
 
-	this = calloc(1, sizeof(struct pw_core));
-	if (this == NULL)
+	impl = calloc(1, sizeof(struct impl));
+	if (impl == NULL)
 		return NULL;
 
+	this = &impl->this;
+
 	pw_log_debug("core %p: new", this);
 
 	if (properties == NULL)
@@ -356,7 +655,13 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	pw_map_init(&this->globals, 128, 32);
 
 	spa_graph_init(&this->rt.graph);
-	spa_graph_set_callbacks(&this->rt.graph, &spa_graph_impl_default, NULL);
+	spa_graph_data_init(&impl->graph_data, &this->rt.graph);
+	spa_graph_set_callbacks(&this->rt.graph, &spa_graph_impl_default, &impl->graph_data);
+
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_DATA_WORKERS)) != NULL &&
+	    atoi(str) > 0)
+		impl->workers = pw_workers_new(&this->rt.graph, atoi(str),
+					       this->data_loop_impl->rtprio);
 
 	spa_debug_set_type_map(this->type.map);
 
@@ -384,8 +689,12 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	spa_list_init(&this->link_list);
 	spa_list_init(&this->control_list[0]);
 	spa_list_init(&this->control_list[1]);
+	spa_list_init(&this->data_domain_list);
 	spa_hook_list_init(&this->listener_list);
 
+	spa_list_init(&impl->reclaim_list);
+	impl->reclaim_event = pw_loop_add_event(this->main_loop, on_reclaim, impl);
+
 	if ((name = pw_properties_get(properties, PW_CORE_PROP_NAME)) == NULL) {
 		pw_properties_setf(properties,
 				   PW_CORE_PROP_NAME, "pipewire-%s-%d",
@@ -404,6 +713,30 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 
 	this->sc_pagesize = sysconf(_SC_PAGESIZE);
 
+	impl->quantum_min = 64;
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_QUANTUM_MIN)) != NULL)
+		impl->quantum_min = SPA_MAX(atoi(str), 1);
+	impl->quantum_max = 1024;
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_QUANTUM_MAX)) != NULL)
+		impl->quantum_max = SPA_MAX(atoi(str), 1);
+	impl->quantum_max = SPA_MAX(impl->quantum_max, impl->quantum_min);
+
+	this->rt.quantum.size = impl->quantum_max;
+	pw_properties_setf(properties, PW_CORE_PROP_QUANTUM, "%u", this->rt.quantum.size);
+
+	if ((str = pw_properties_get(properties, PW_LOOP_PROP_PROFILE)) != NULL)
+		impl->profile = pw_properties_parse_bool(str);
+
+	impl->stats_interval = -1;
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_STATS_INTERVAL)) != NULL)
+		impl->stats_interval = SPA_MAX(atoi(str), 0);
+
+	/* the profiles and the spin load are only published from the timer */
+	if (impl->stats_interval >= 0)
+		start_stats_timer(impl, impl->stats_interval);
+	else if (impl->profile || this->data_loop_impl->spin > 0)
+		start_stats_timer(impl, DEFAULT_STATS_INTERVAL);
+
 	this->global = pw_global_new(this,
 				     this->type.core,
 				     PW_VERSION_CORE,
@@ -420,11 +753,87 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 		this->info.id = this->global->id;
 	}
 
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_FREEWHEEL)) != NULL &&
+	    pw_properties_parse_bool(str))
+		pw_core_set_freewheel(this, true);
+
 	return this;
 
       no_mem:
       no_data_loop:
-	free(this);
+	free(impl);
+	return NULL;
+}
+
+static void data_domain_destroy(struct pw_data_domain *domain)
+{
+	struct domain *d = SPA_CONTAINER_OF(domain, struct domain, this);
+
+	pw_log_debug("data-domain %p: destroy", domain);
+
+	spa_list_remove(&domain->link);
+	pw_data_loop_destroy(domain->data_loop_impl);
+	spa_graph_data_clear(&d->graph_data);
+	free(domain->name);
+	free(d);
+}
+
+struct pw_data_domain *
+pw_core_get_data_domain(struct pw_core *core, const struct pw_properties *properties)
+{
+	struct impl *impl = SPA_CONTAINER_OF(core, struct impl, this);
+	struct pw_data_domain *this;
+	struct domain *d;
+	struct pw_properties *props;
+	const char *name;
+	uint32_t i;
+
+	if (properties == NULL ||
+	    (name = pw_properties_get(properties, PW_NODE_PROP_DATA_LOOP)) == NULL)
+		return NULL;
+
+	spa_list_for_each(this, &core->data_domain_list, link) {
+		if (strcmp(this->name, name) == 0)
+			return this;
+	}
+
+	d = calloc(1, sizeof(struct domain));
+	if (d == NULL)
+		return NULL;
+
+	this = &d->this;
+
+	props = pw_properties_copy(properties);
+	this->data_loop_impl = pw_data_loop_new(props);
+	pw_properties_free(props);
+	if (this->data_loop_impl == NULL)
+		goto no_data_loop;
+
+	this->name = strdup(name);
+	this->data_loop = pw_data_loop_get_loop(this->data_loop_impl);
+
+	spa_graph_init(&this->rt.graph);
+	spa_graph_data_init(&d->graph_data, &this->rt.graph);
+	this->rt.quantum.size = impl->quantum_max;
+	spa_graph_set_callbacks(&this->rt.graph, &spa_graph_impl_default, &d->graph_data);
+
+	for (i = 0; i < core->n_support; i++) {
+		this->support[i] = core->support[i];
+		if (strcmp(this->support[i].type, SPA_TYPE_LOOP__DataLoop) == 0)
+			this->support[i].data = this->data_loop->loop;
+	}
+	this->n_support = core->n_support;
+
+	spa_list_append(&core->data_domain_list, &this->link);
+
+	pw_log_debug("data-domain %p: new \"%s\"", this, name);
+
+	pw_data_loop_start(this->data_loop_impl);
+
+	return this;
+
+      no_data_loop:
+	free(d);
 	return NULL;
 }
 
@@ -436,14 +845,21 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
  */
 void pw_core_destroy(struct pw_core *core)
 {
+	struct impl *impl = SPA_CONTAINER_OF(core, struct impl, this);
 	struct pw_global *global, *t;
 	struct pw_module *module, *tm;
 	struct pw_remote *remote, *tr;
 	struct pw_node *node, *tn;
+	struct pw_data_domain *domain, *td;
 
 	pw_log_debug("core %p: destroy", core);
 	spa_hook_list_call(&core->listener_list, struct pw_core_events, destroy);
 
+	if (impl->stats_timer)
+		pw_loop_destroy_source(core->main_loop, impl->stats_timer);
+
+	pw_core_set_freewheel(core, false);
+
 	spa_list_for_each_safe(remote, tr, &core->remote_list, link)
 		pw_remote_destroy(remote);
 
@@ -458,14 +874,24 @@ void pw_core_destroy(struct pw_core *core)
 
 	spa_hook_list_call(&core->listener_list, struct pw_core_events, free);
 
+	flush_reclaim(impl);
+	pw_loop_destroy_source(core->main_loop, impl->reclaim_event);
+
+	spa_list_for_each_safe(domain, td, &core->data_domain_list, link)
+		data_domain_destroy(domain);
+
 	pw_data_loop_destroy(core->data_loop_impl);
 
+	if (impl->workers)
+		pw_workers_destroy(impl->workers);
+	spa_graph_data_clear(&impl->graph_data);
+
 	pw_properties_free(core->properties);
 
 	pw_map_clear(&core->globals);
 
 	pw_log_debug("core %p: free", core);
-	free(core);
+	free(impl);
 }
 
 const struct pw_core_info *pw_core_get_info(struct pw_core *core)
@@ -507,6 +933,112 @@ const struct pw_properties *pw_core_get_properties(struct pw_core *core)
 	return core->properties;
 }
 
+/** Run the graph as fast as possible
+ * \param core a core
+ * \param freewheel if the graph should freewheel
+ * \return 0 on success, < 0 on error
+ *
+ * In freewheel mode the core data loop runs cycles back to back and pulls
+ * data into the sinks of the core graph without waiting for a hardware
+ * clock. Use this to render offline or to load test a graph. The number of
+ * cycles per second is published in the \ref PW_CORE_PROP_FREEWHEEL_RATE
+ * property.
+ *
+ * \memberof pw_core
+ */
+int pw_core_set_freewheel(struct pw_core *core, bool freewheel)
+{
+	struct impl *impl = SPA_CONTAINER_OF(core, struct impl, this);
+	struct timespec ts;
+
+	if (freewheel == (impl->freewheel != NULL))
+		return 0;
+
+	pw_log_debug("core %p: freewheel %d", core, freewheel);
+
+	if (freewheel) {
+		impl->freewheel = pw_freewheel_new(core);
+		if (impl->freewheel == NULL)
+			return -errno;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		impl->freewheel_time = SPA_TIMESPEC_TO_TIME(&ts);
+		impl->freewheel_cycles = 0;
+
+		/* publish the rate unless the updates were disabled */
+		if (impl->stats_interval < 0)
+			start_stats_timer(impl, DEFAULT_STATS_INTERVAL);
+	} else {
+		pw_freewheel_destroy(impl->freewheel);
+		impl->freewheel = NULL;
+	}
+	return 0;
+}
+
+/* the smallest quantum of the running nodes in the graph */
+static uint32_t graph_quantum(struct impl *impl, struct spa_graph *graph)
+{
+	struct pw_node *node;
+	uint32_t quantum = impl->quantum_max;
+	const char *str;
+	int q;
+
+	spa_list_for_each(node, &impl->this.node_list, link) {
+		if (node->rt.graph != graph)
+			continue;
+		if (node->info.state != PW_NODE_STATE_RUNNING || node->properties == NULL)
+			continue;
+		if ((str = pw_properties_get(node->properties, PW_NODE_PROP_QUANTUM)) == NULL)
+			continue;
+		if ((q = atoi(str)) > 0)
+			quantum = SPA_MIN(quantum, (uint32_t) q);
+	}
+	return SPA_CLAMP(quantum, impl->quantum_min, impl->quantum_max);
+}
+
+/** Update the quantum of the graph
+ * \param core a core
+ *
+ * The graph runs with the smallest \ref PW_NODE_PROP_QUANTUM of the
+ * running nodes, clamped between \ref PW_CORE_PROP_QUANTUM_MIN and
+ * \ref PW_CORE_PROP_QUANTUM_MAX. The drivers read the new quantum at
+ * the start of their next cycle and the other nodes follow, the buffers
+ * are allocated for the largest quantum so nothing is renegotiated.
+ *
+ * The nodes of a data domain run in their own graph and the quantum of
+ * every domain is negotiated between its own nodes only.
+ *
+ * \memberof pw_core
+ */
+void pw_core_update_quantum(struct pw_core *core)
+{
+	struct impl *impl = SPA_CONTAINER_OF(core, struct impl, this);
+	struct pw_data_domain *domain;
+	uint32_t quantum;
+	char val[16];
+
+	spa_list_for_each(domain, &core->data_domain_list, link) {
+		quantum = graph_quantum(impl, &domain->rt.graph);
+		if (quantum == domain->rt.quantum.size)
+			continue;
+
+		pw_log_info("data-domain %p: quantum %u -> %u", domain,
+				domain->rt.quantum.size, quantum);
+		__atomic_store_n(&domain->rt.quantum.size, quantum, __ATOMIC_RELAXED);
+	}
+
+	quantum = graph_quantum(impl, &core->rt.graph);
+	if (quantum == core->rt.quantum.size)
+		return;
+
+	pw_log_info("core %p: quantum %u -> %u", core, core->rt.quantum.size, quantum);
+	__atomic_store_n(&core->rt.quantum.size, quantum, __ATOMIC_RELAXED);
+
+	snprintf(val, sizeof(val), "%u", quantum);
+	pw_core_update_properties(core,
+			&SPA_DICT_INIT(&SPA_DICT_ITEM_INIT(PW_CORE_PROP_QUANTUM, val), 1));
+}
+
 /** Update core properties
  *
  * \param core a core
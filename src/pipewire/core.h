@@ -110,6 +110,33 @@ struct pw_core_events {
 #define PW_CORE_PROP_VERSION	"pipewire.core.version"
 /** If the core should listen for connections, boolean default false */
 #define PW_CORE_PROP_DAEMON	"pipewire.daemon"
+/** Number of extra threads that process the graph in parallel with the
+ * data loop, default 0 */
+#define PW_CORE_PROP_DATA_WORKERS	"pipewire.core.data-workers"
+/** Interval in milliseconds between updates of the node statistics
+ * properties, 0 disables the updates. When not set, the updates run every
+ * second while the loops are profiled, the data loop spins or the graph
+ * freewheels */
+#define PW_CORE_PROP_STATS_INTERVAL	"pipewire.core.stats-interval"
+/** Run the graph as fast as possible without a driver, boolean default false */
+#define PW_CORE_PROP_FREEWHEEL		"pipewire.core.freewheel"
+/** Number of cycles per second while freewheeling, updated with the
+ * node statistics */
+#define PW_CORE_PROP_FREEWHEEL_RATE	"pipewire.core.freewheel-rate"
+/** The current quantum of the graph in samples, the smallest
+ * \ref PW_NODE_PROP_QUANTUM of the running nodes */
+#define PW_CORE_PROP_QUANTUM		"pipewire.core.quantum"
+/** Smallest quantum of the graph in samples, default 64 */
+#define PW_CORE_PROP_QUANTUM_MIN	"pipewire.core.quantum-min"
+/** Largest quantum of the graph in samples, used when no running node
+ * asks for a quantum, default 1024 */
+#define PW_CORE_PROP_QUANTUM_MAX	"pipewire.core.quantum-max"
+/** The sources of the main loop that spent the most time in their
+ * callbacks, one per line, updated with the node statistics when
+ * \ref PW_LOOP_PROP_PROFILE is enabled */
+#define PW_CORE_PROP_MAIN_LOOP_PROFILE	"pipewire.core.main-loop.profile"
+/** Like \ref PW_CORE_PROP_MAIN_LOOP_PROFILE for the data loop */
+#define PW_CORE_PROP_DATA_LOOP_PROFILE	"pipewire.core.data-loop.profile"
 
 /** Make a new core object for a given main_loop. Ownership of the properties is taken */
 struct pw_core * pw_core_new(struct pw_loop *main_loop, struct pw_properties *props);
@@ -135,6 +162,9 @@ struct pw_global *pw_core_get_global(struct pw_core *core);
 /** Get the core properties */
 const struct pw_properties *pw_core_get_properties(struct pw_core *core);
 
+/** Start or stop running the graph as fast as possible */
+int pw_core_set_freewheel(struct pw_core *core, bool freewheel);
+
 /** Update the core properties */
 int pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict);
 
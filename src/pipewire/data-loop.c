@@ -19,6 +19,8 @@
 
 #include <pthread.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <time.h>
 #include <sys/resource.h>
 
 #include "pipewire/log.h"
@@ -26,15 +28,15 @@
 #include "pipewire/data-loop.h"
 #include "pipewire/private.h"
 
-static void make_realtime(struct pw_data_loop *this)
+/** Make the calling thread realtime with priority \a rtprio */
+void pw_thread_make_realtime(int rtprio)
 {
 	struct sched_param sp;
 	struct pw_rtkit_bus *system_bus;
 	struct rlimit rl;
-	int r, rtprio;
+	int r;
 	long long rttime;
 
-	rtprio = 20;
 	rttime = 20000;
 
 	spa_zero(sp);
@@ -69,17 +71,93 @@ static void make_realtime(struct pw_data_loop *this)
 	pw_rtkit_bus_free(system_bus);
 }
 
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+static bool run_spin_checks(struct pw_data_loop *this)
+{
+	struct spa_hook *h;
+
+	spa_list_for_each(h, &this->spin_list.list, link) {
+		const struct pw_data_loop_spin_check *c = h->funcs;
+		if (c->check(h->data))
+			return true;
+	}
+	return false;
+}
+
+/* Poll the loop without sleeping until there is work or the spin budget
+ * runs out. Between the polls, the spin checks look at shared memory so
+ * that the loop can dispatch right after a client wrote its ringbuffer,
+ * without waiting for the syscall of the next poll. */
+static int spin_loop(struct pw_data_loop *this)
+{
+	uint64_t start, now, end;
+	uint32_t n = 0;
+	int res;
+
+	start = now = get_time_ns();
+	end = start + this->spin;
+
+	while ((res = pw_loop_iterate(this->loop, 0)) == 0 && this->running) {
+		/* poll every 64 rounds for the fds without a spin check */
+		while (++n & 63) {
+			if (run_spin_checks(this))
+				break;
+			cpu_relax();
+		}
+		if ((now = get_time_ns()) >= end)
+			break;
+	}
+
+	__atomic_store_n(&this->stats.n_spins, this->stats.n_spins + 1, __ATOMIC_RELAXED);
+	if (res != 0)
+		__atomic_store_n(&this->stats.n_hits, this->stats.n_hits + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&this->stats.spin_time,
+			this->stats.spin_time + get_time_ns() - start, __ATOMIC_RELAXED);
+
+	return res;
+}
+
 static void *do_loop(void *user_data)
 {
 	struct pw_data_loop *this = user_data;
 	int res;
 
-	make_realtime(this);
+	if (this->cpu >= 0) {
+		cpu_set_t set;
+		int err;
+
+		CPU_ZERO(&set);
+		CPU_SET(this->cpu, &set);
+		if ((err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0)
+			pw_log_warn("data-loop %p: can't set cpu %d: %s", this, this->cpu,
+				    strerror(err));
+	}
+	pw_thread_make_realtime(this->rtprio);
 
 	pw_log_debug("data-loop %p: enter thread", this);
 	pw_loop_enter(this->loop);
 
 	while (this->running) {
+		if (this->spin > 0 && (res = spin_loop(this)) != 0) {
+			if (res < 0)
+				pw_log_warn("data-loop %p: iterate error %d", this, res);
+			continue;
+		}
 		if ((res = pw_loop_iterate(this->loop, -1)) < 0)
 			pw_log_warn("data-loop %p: iterate error %d", this, res);
 	}
@@ -97,6 +175,8 @@ static void do_stop(void *data, uint64_t count)
 }
 
 /** Create a new \ref pw_data_loop.
+ * \param properties extra properties, see \ref PW_DATA_LOOP_PROP_RT_PRIO,
+ *	\ref PW_DATA_LOOP_PROP_CPU and \ref PW_DATA_LOOP_PROP_SPIN
  * \return a newly allocated data loop
  *
  * \memberof pw_data_loop
@@ -104,6 +184,7 @@ static void do_stop(void *data, uint64_t count)
 struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 {
 	struct pw_data_loop *this;
+	const char *str;
 
 	this = calloc(1, sizeof(struct pw_data_loop));
 	if (this == NULL)
@@ -115,7 +196,21 @@ struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 	if (this->loop == NULL)
 		goto no_loop;
 
+	this->rtprio = 20;
+	this->cpu = -1;
+	if (properties) {
+		if ((str = pw_properties_get(properties, PW_DATA_LOOP_PROP_RT_PRIO)) != NULL)
+			this->rtprio = atoi(str);
+		if ((str = pw_properties_get(properties, PW_DATA_LOOP_PROP_CPU)) != NULL)
+			this->cpu = atoi(str);
+		if ((str = pw_properties_get(properties, PW_DATA_LOOP_PROP_SPIN)) != NULL)
+			this->spin = SPA_MAX(atoi(str), 0) * SPA_NSEC_PER_USEC;
+	}
+	pw_log_debug("data-loop %p: rtprio %d cpu %d spin %"PRIu64, this,
+			this->rtprio, this->cpu, this->spin);
+
 	spa_hook_list_init(&this->listener_list);
+	spa_hook_list_init(&this->spin_list);
 
 	this->event = pw_loop_add_event(this->loop, do_stop, this);
 
@@ -151,6 +246,42 @@ void pw_data_loop_add_listener(struct pw_data_loop *loop,
 	spa_hook_list_append(&loop->listener_list, listener, events, data);
 }
 
+/** Add a spin check
+ * \param loop the data loop
+ * \param hook the hook to add, remove it with spa_hook_remove() from the
+ *	loop thread
+ * \param check the check
+ * \param data data passed to the check
+ *
+ * The checks are only run when the loop spins, see \ref PW_DATA_LOOP_PROP_SPIN.
+ * This must be called from the loop thread, use pw_loop_invoke().
+ *
+ * \memberof pw_data_loop
+ */
+void pw_data_loop_add_spin_check(struct pw_data_loop *loop,
+				 struct spa_hook *hook,
+				 const struct pw_data_loop_spin_check *check,
+				 void *data)
+{
+	spa_hook_list_append(&loop->spin_list, hook, check, data);
+}
+
+/** Get the spin statistics
+ * \param loop the data loop
+ * \param stats the statistics, the counters are updated by the loop
+ *	thread and are read without locking
+ * \return 0
+ *
+ * \memberof pw_data_loop
+ */
+int pw_data_loop_get_stats(struct pw_data_loop *loop, struct pw_data_loop_stats *stats)
+{
+	stats->n_spins = __atomic_load_n(&loop->stats.n_spins, __ATOMIC_RELAXED);
+	stats->n_hits = __atomic_load_n(&loop->stats.n_hits, __ATOMIC_RELAXED);
+	stats->spin_time = __atomic_load_n(&loop->stats.spin_time, __ATOMIC_RELAXED);
+	return 0;
+}
+
 struct pw_loop *
 pw_data_loop_get_loop(struct pw_data_loop *loop)
 {
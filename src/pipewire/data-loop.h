@@ -44,6 +44,34 @@ struct pw_data_loop_events {
 	void (*destroy) (void *data);
 };
 
+/** Realtime priority of the loop thread, default 20 */
+#define PW_DATA_LOOP_PROP_RT_PRIO	"pipewire.data-loop.rt-prio"
+/** CPU the loop thread is bound to, default unbound */
+#define PW_DATA_LOOP_PROP_CPU		"pipewire.data-loop.cpu"
+/** Time in usec the loop thread spins for new work before it sleeps,
+ * default 0 (always sleep). Only useful on an isolated cpu. */
+#define PW_DATA_LOOP_PROP_SPIN		"pipewire.data-loop.spin"
+/** Fraction of the time the core data loop spent spinning, updated with
+ * the node statistics in the core properties */
+#define PW_DATA_LOOP_PROP_SPIN_LOAD	"pipewire.data-loop.spin-load"
+
+/** Checks that are run while the loop spins, use
+ * \ref pw_data_loop_add_spin_check from the loop thread */
+struct pw_data_loop_spin_check {
+#define PW_VERSION_DATA_LOOP_SPIN_CHECK		0
+	uint32_t version;
+	/** Check shared memory for new work without a syscall, return true
+	 * when the loop should stop spinning and dispatch */
+	bool (*check) (void *data);
+};
+
+/** Spin statistics of the loop, times in nanoseconds */
+struct pw_data_loop_stats {
+	uint64_t n_spins;	/**< number of times the loop started spinning */
+	uint64_t n_hits;	/**< spins that found work before the budget ran out */
+	uint64_t spin_time;	/**< total time spent spinning */
+};
+
 /** Make a new loop */
 struct pw_data_loop *
 pw_data_loop_new(struct pw_properties *properties);
@@ -54,6 +82,15 @@ void pw_data_loop_add_listener(struct pw_data_loop *loop,
 			       const struct pw_data_loop_events *events,
 			       void *data);
 
+/** Add a check for new work to the spin loop, call this from the loop thread */
+void pw_data_loop_add_spin_check(struct pw_data_loop *loop,
+				 struct spa_hook *hook,
+				 const struct pw_data_loop_spin_check *check,
+				 void *data);
+
+/** Get the spin statistics of the loop */
+int pw_data_loop_get_stats(struct pw_data_loop *loop, struct pw_data_loop_stats *stats);
+
 /** Get the loop implementation of this data loop */
 struct pw_loop *
 pw_data_loop_get_loop(struct pw_data_loop *loop);
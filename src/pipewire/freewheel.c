@@ -0,0 +1,243 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include "pipewire/log.h"
+#include "pipewire/private.h"
+
+/* a cycle that did not complete after this many seconds is abandoned */
+#define CYCLE_TIMEOUT	1
+
+/** \cond */
+struct pw_freewheel {
+	struct pw_core *core;
+	struct pw_loop *loop;
+	struct spa_graph *graph;
+	struct spa_source *event;	/**< starts the next cycle */
+	struct spa_source *timer;	/**< checks for cycles that don't complete */
+	bool pending;			/**< a cycle was started and is not complete */
+	uint32_t n_pending;		/**< sinks that did not complete the cycle */
+	uint64_t checked_cycles;	/**< n_cycles at the last timeout */
+	uint64_t n_cycles;		/**< updated from the data thread */
+};
+/** \endcond */
+
+static inline bool port_active(struct spa_graph_port *p)
+{
+	return p->peer != NULL && !(p->peer->flags & SPA_GRAPH_PORT_FLAG_DISABLED);
+}
+
+/* the ports of a node are connected to the links through the mixer of
+ * the port, look through it for an active link */
+static bool has_active(struct spa_graph_node *node, enum spa_direction direction, int depth)
+{
+	struct spa_graph_port *p;
+
+	spa_list_for_each(p, &node->ports[direction], link) {
+		if (!port_active(p))
+			continue;
+		if (depth == 0 || has_active(p->peer->node, direction, depth - 1))
+			return true;
+	}
+	return false;
+}
+
+/* the nodes that have active input links and no active output links */
+static struct pw_node *get_sink(struct spa_graph_node *n)
+{
+	if (has_active(n, SPA_DIRECTION_OUTPUT, 1) ||
+	    !has_active(n, SPA_DIRECTION_INPUT, 1))
+		return NULL;
+	return pw_node_from_graph_node(n);
+}
+
+static void reset_nodes(struct pw_freewheel *this)
+{
+	struct spa_graph_node *n;
+	struct pw_node *node;
+
+	spa_list_for_each(n, &this->graph->nodes, link) {
+		if ((node = pw_node_from_graph_node(n)) != NULL)
+			node->rt.freewheel_cycles = 0;
+	}
+}
+
+static void cycle_complete(struct pw_freewheel *this)
+{
+	this->pending = false;
+	__atomic_store_n(&this->n_cycles, this->n_cycles + 1, __ATOMIC_RELAXED);
+	pw_loop_signal_event(this->loop, this->event);
+}
+
+/** Called from the data thread when a sink completed the pulled cycle */
+void pw_freewheel_node_done(struct pw_freewheel *this, struct pw_node *node)
+{
+	node->rt.freewheel_cycles = 0;
+	if (this->pending && --this->n_pending == 0)
+		cycle_complete(this);
+}
+
+static void on_event(void *data, uint64_t count)
+{
+	struct pw_freewheel *this = data;
+	struct spa_graph *graph = this->graph;
+	struct spa_graph_node *n;
+	struct pw_node *node;
+	struct timespec ts;
+
+	if (this->pending)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	this->core->rt.cycle_start = SPA_TIMESPEC_TO_TIME(&ts);
+
+	/* one extra so that the sinks that complete while pulling don't end
+	 * the cycle early */
+	this->pending = true;
+	this->n_pending = 1;
+
+	/* pull one quantum into every sink */
+	spa_list_for_each(n, &graph->nodes, link) {
+		if ((node = get_sink(n)) == NULL)
+			continue;
+		node->rt.freewheel_cycles = node->rt.stats->n_cycles + 1;
+		this->n_pending++;
+		spa_graph_need_input(graph, n);
+	}
+
+	if (this->n_pending == 1) {
+		/* nothing to pull, the timer tries again */
+		this->pending = false;
+		this->n_pending = 0;
+		return;
+	}
+	if (--this->n_pending == 0)
+		cycle_complete(this);
+}
+
+static void on_timeout(void *data, uint64_t expirations)
+{
+	struct pw_freewheel *this = data;
+
+	if (this->pending) {
+		if (this->n_cycles != this->checked_cycles) {
+			this->checked_cycles = this->n_cycles;
+			return;
+		}
+		pw_log_warn("freewheel %p: %u sinks did not complete the cycle, restarting",
+				this, this->n_pending);
+		reset_nodes(this);
+		this->pending = false;
+		this->n_pending = 0;
+	}
+	pw_loop_signal_event(this->loop, this->event);
+}
+
+static int
+do_start(struct spa_loop *loop,
+	 bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_freewheel *this = user_data;
+	struct timespec timeout = { CYCLE_TIMEOUT, 0 };
+
+	this->event = pw_loop_add_event(this->loop, on_event, this);
+	if (this->event == NULL)
+		return -errno;
+	this->timer = pw_loop_add_timer(this->loop, on_timeout, this);
+	if (this->timer == NULL) {
+		pw_loop_destroy_source(this->loop, this->event);
+		return -errno;
+	}
+	pw_loop_update_timer(this->loop, this->timer, &timeout, &timeout, false);
+
+	reset_nodes(this);
+	this->core->rt.freewheel = this;
+	pw_loop_signal_event(this->loop, this->event);
+	return 0;
+}
+
+static int
+do_stop(struct spa_loop *loop,
+	bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_freewheel *this = user_data;
+
+	this->core->rt.freewheel = NULL;
+	pw_loop_destroy_source(this->loop, this->timer);
+	pw_loop_destroy_source(this->loop, this->event);
+	return 0;
+}
+
+/** Run the graph of a core as fast as possible
+ * \param core the core with the graph to run
+ * \return a new \ref pw_freewheel or NULL on error
+ *
+ * The data loop of the core starts the cycles itself instead of waiting for
+ * a driver. Every cycle pulls data into all the nodes that have active input
+ * links and no active output links, the next cycle starts when all those
+ * nodes processed the data. A cycle that does not complete within a second
+ * is abandoned. The wakeups of the drivers of the graph are ignored while
+ * freewheeling.
+ */
+struct pw_freewheel *pw_freewheel_new(struct pw_core *core)
+{
+	struct pw_freewheel *this;
+	int res;
+
+	this = calloc(1, sizeof(struct pw_freewheel));
+	if (this == NULL)
+		return NULL;
+
+	pw_log_debug("freewheel %p: new", this);
+
+	this->core = core;
+	this->loop = core->data_loop;
+	this->graph = &core->rt.graph;
+
+	if ((res = pw_loop_invoke(this->loop, do_start, SPA_ID_INVALID, NULL, 0, true, this)) < 0) {
+		pw_log_error("freewheel %p: can't add sources: %d", this, res);
+		free(this);
+		errno = -res;
+		return NULL;
+	}
+	return this;
+}
+
+/** Get the number of cycles
+ * \param freewheel a freewheel driver
+ * \return the number of cycles that were completed by all the sinks
+ */
+uint64_t pw_freewheel_get_cycles(struct pw_freewheel *freewheel)
+{
+	return __atomic_load_n(&freewheel->n_cycles, __ATOMIC_RELAXED);
+}
+
+/** Stop and destroy a freewheel driver
+ * \param freewheel the freewheel driver to destroy
+ */
+void pw_freewheel_destroy(struct pw_freewheel *freewheel)
+{
+	pw_log_debug("freewheel %p: destroy", freewheel);
+
+	pw_loop_invoke(freewheel->loop, do_stop, SPA_ID_INVALID, NULL, 0, true, freewheel);
+	free(freewheel);
+}
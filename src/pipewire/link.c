@@ -50,6 +50,9 @@ struct impl {
 	struct spa_hook input_node_listener;
 	struct spa_hook output_port_listener;
 	struct spa_hook output_node_listener;
+
+	struct pw_loop *input_loop;	/**< data loop of the input node, for reclaim */
+	struct pw_reclaim reclaim;
 };
 
 struct resource_data {
@@ -714,6 +717,7 @@ do_activate_link(struct spa_loop *loop,
         struct pw_link *this = user_data;
 	SPA_FLAG_UNSET(this->rt.out_port.flags, SPA_GRAPH_PORT_FLAG_DISABLED);
 	SPA_FLAG_UNSET(this->rt.in_port.flags, SPA_GRAPH_PORT_FLAG_DISABLED);
+	spa_graph_changed(this->output->node->rt.graph);
 	return 0;
 }
 
@@ -862,7 +866,8 @@ static void input_remove(struct pw_link *this, struct pw_port *port)
 	spa_hook_remove(&impl->input_node_listener);
 
 	pw_loop_invoke(port->node->data_loop,
-		       do_remove_input, 1, NULL, 0, true, this);
+		       do_remove_input, SPA_ID_INVALID, NULL, 0, false, this);
+	spa_graph_reserve(port->rt.graph, 0, -1);
 
 	clear_port_buffers(this, port);
 }
@@ -885,7 +890,8 @@ static void output_remove(struct pw_link *this, struct pw_port *port)
 	spa_hook_remove(&impl->output_node_listener);
 
 	pw_loop_invoke(port->node->data_loop,
-		       do_remove_output, 1, NULL, 0, true, this);
+		       do_remove_output, SPA_ID_INVALID, NULL, 0, false, this);
+	spa_graph_reserve(port->rt.graph, 0, -1);
 
 	clear_port_buffers(this, port);
 }
@@ -936,6 +942,7 @@ do_deactivate_link(struct spa_loop *loop,
         struct pw_link *this = user_data;
 	SPA_FLAG_SET(this->rt.out_port.flags, SPA_GRAPH_PORT_FLAG_DISABLED);
 	SPA_FLAG_SET(this->rt.in_port.flags, SPA_GRAPH_PORT_FLAG_DISABLED);
+	spa_graph_changed(this->output->node->rt.graph);
 	return 0;
 }
 
@@ -950,7 +957,7 @@ int pw_link_deactivate(struct pw_link *this)
 	impl->active = false;
 	pw_log_debug("link %p: deactivate", this);
 	pw_loop_invoke(this->output->node->data_loop,
-		       do_deactivate_link, SPA_ID_INVALID, NULL, 0, true, this);
+		       do_deactivate_link, SPA_ID_INVALID, NULL, 0, false, this);
 
 	input_node = this->input->node;
 	output_node = this->output->node;
@@ -1083,6 +1090,11 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	if (pw_link_find(output, input))
 		goto link_exists;
 
+	/* the graphs of different data domains run from their own loops,
+	 * data can't flow between them */
+	if (output->node->rt.graph != input->node->rt.graph)
+		goto different_domains;
+
 	impl = calloc(1, sizeof(struct impl) + user_data_size);
 	if (impl == NULL)
 		goto no_mem;
@@ -1159,7 +1171,9 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	this->rt.in_port.scheduler_data = this;
 	this->rt.out_port.scheduler_data = this;
 
-	/* nodes can be in different data loops so we do this twice */
+	/* add the port of each side of the link */
+	spa_graph_reserve(output->rt.graph, 0, 1);
+	spa_graph_reserve(input->rt.graph, 0, 1);
 	pw_loop_invoke(output_node->data_loop, do_add_link,
 		       SPA_ID_INVALID, &output, sizeof(struct pw_port *), false, this);
 	pw_loop_invoke(input_node->data_loop, do_add_link,
@@ -1176,6 +1190,9 @@ struct pw_link *pw_link_new(struct pw_core *core,
       link_exists:
 	asprintf(error, "link already exists");
 	return NULL;
+      different_domains:
+	asprintf(error, "can't link nodes of different data loops");
+	return NULL;
       no_mem:
 	asprintf(error, "no memory");
 	return NULL;
@@ -1222,10 +1239,39 @@ int pw_link_register(struct pw_link *link,
 	return 0;
 }
 
+static void link_free(void *data)
+{
+	struct impl *impl = data;
+	struct pw_link *link = &impl->this;
+
+	pw_log_debug("link %p: reclaim", impl);
+
+	if (link->buffer_owner == link) {
+		free(link->buffers);
+		pw_memblock_free(link->buffer_mem);
+	}
+	free(impl);
+}
+
+static void link_free_input(void *data)
+{
+	struct impl *impl = data;
+	pw_core_defer_free(impl->this.core, impl->input_loop, &impl->reclaim, link_free, impl);
+}
+
+/** Destroy a link
+ * \param link a link to destroy
+ *
+ * The link is removed from the graph without waiting for the data
+ * threads, the memory they can still use is freed later.
+ *
+ * \memberof pw_link
+ */
 void pw_link_destroy(struct pw_link *link)
 {
 	struct impl *impl = SPA_CONTAINER_OF(link, struct impl, this);
 	struct pw_resource *resource, *tmp;
+	struct pw_loop *output_loop;
 
 	pw_log_debug("link %p: destroy", impl);
 	spa_hook_list_call(&link->listener_list, struct pw_link_events, destroy);
@@ -1240,6 +1286,9 @@ void pw_link_destroy(struct pw_link *link)
 	spa_list_for_each_safe(resource, tmp, &link->resource_list, link)
 	    pw_resource_destroy(resource);
 
+	output_loop = link->output->node->data_loop;
+	impl->input_loop = link->input->node->data_loop;
+
 	input_remove(link, link->input);
 	spa_list_remove(&link->input_link);
 	spa_hook_list_call(&link->input->listener_list, struct pw_port_events, link_removed, link);
@@ -1261,11 +1310,12 @@ void pw_link_destroy(struct pw_link *link)
 	if (link->info.format)
 		free(link->info.format);
 
-	if (link->buffer_owner == link) {
-		free(link->buffers);
-		pw_memblock_free(link->buffer_mem);
-	}
-	free(impl);
+	/* the link can be in the graphs of two data loops */
+	if (output_loop == impl->input_loop)
+		pw_core_defer_free(link->core, output_loop, &impl->reclaim, link_free, impl);
+	else
+		pw_core_defer_free(link->core, output_loop, &impl->reclaim,
+				   link_free_input, impl);
 }
 
 void pw_link_add_listener(struct pw_link *link,
@@ -75,7 +75,8 @@ struct pw_link_events {
   * set to "1" or "0" */
 #define PW_LINK_PROP_PASSIVE	"pipewire.link.passive"
 
-/** Make a new link between two ports \memberof pw_link
+/** Make a new link between two ports of nodes of the same data loop
+ * \memberof pw_link
  * \return a newly allocated link */
 struct pw_link *
 pw_link_new(struct pw_core *core,		/**< the core object */
@@ -38,6 +38,8 @@ struct impl {
 /** \endcond */
 
 /** Create a new loop
+ * \param properties extra properties, see \ref PW_LOOP_PROP_BACKEND and
+ *	\ref PW_LOOP_PROP_PROFILE
  * \returns a newly allocated loop
  * \memberof pw_loop
  */
@@ -74,7 +76,7 @@ struct pw_loop *pw_loop_new(struct pw_properties *properties)
 
 	if ((res = spa_handle_factory_init(factory,
 					   impl->handle,
-					   NULL,
+					   properties ? &properties->dict : NULL,
 					   support,
 					   n_support)) < 0) {
 		fprintf(stderr, "can't make factory instance: %d\n", res);
@@ -40,6 +40,12 @@ struct pw_loop {
 	struct spa_loop_utils *utils;		/**< loop utils */
 };
 
+/** The backend of the loop, "epoll" (default) or "io_uring" */
+#define PW_LOOP_PROP_BACKEND	SPA_LOOP_INFO_BACKEND
+/** Collect dispatch statistics of the sources, boolean default false,
+ * see \ref pw_loop_get_stats */
+#define PW_LOOP_PROP_PROFILE	SPA_LOOP_INFO_PROFILE
+
 struct pw_loop *
 pw_loop_new(struct pw_properties *properties);
 
@@ -56,6 +62,7 @@ pw_loop_destroy(struct pw_loop *loop);
 #define pw_loop_enter(l)		spa_loop_control_enter((l)->control)
 #define pw_loop_iterate(l,...)		spa_loop_control_iterate((l)->control,__VA_ARGS__)
 #define pw_loop_leave(l)		spa_loop_control_leave((l)->control)
+#define pw_loop_get_stats(l,...)	spa_loop_control_get_stats((l)->control,__VA_ARGS__)
 
 #define pw_loop_add_io(l,...)		spa_loop_utils_add_io((l)->utils,__VA_ARGS__)
 #define pw_loop_update_io(l,...)	spa_loop_utils_update_io((l)->utils,__VA_ARGS__)
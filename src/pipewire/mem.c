@@ -251,9 +251,10 @@ void pw_memblock_free(struct pw_memblock *mem)
 	if (mem == NULL)
 		return;
 
-	if (mem->flags & PW_MEMBLOCK_FLAG_WITH_FD) {
+	if (mem->flags & (PW_MEMBLOCK_FLAG_WITH_FD | PW_MEMBLOCK_FLAG_MAP_TWICE)) {
 		if (mem->ptr)
-			munmap(mem->ptr, mem->size);
+			munmap(mem->ptr, mem->flags & PW_MEMBLOCK_FLAG_MAP_TWICE ?
+					mem->size << 1 : mem->size);
 		if (mem->fd != -1)
 			close(mem->fd);
 	} else {
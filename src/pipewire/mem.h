@@ -33,7 +33,9 @@ enum pw_memblock_flags {
 	PW_MEMBLOCK_FLAG_SEAL = (1 << 1),
 	PW_MEMBLOCK_FLAG_MAP_READ = (1 << 2),
 	PW_MEMBLOCK_FLAG_MAP_WRITE = (1 << 3),
-	PW_MEMBLOCK_FLAG_MAP_TWICE = (1 << 4),
+	PW_MEMBLOCK_FLAG_MAP_TWICE = (1 << 4),	/**< map the memory twice back to back, for
+						  *  spa_ringbuffer_write_reserve(). The size
+						  *  must be a multiple of the page size */
 };
 
 #define PW_MEMBLOCK_FLAG_MAP_READWRITE (PW_MEMBLOCK_FLAG_MAP_READ | PW_MEMBLOCK_FLAG_MAP_WRITE)
@@ -21,6 +21,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <time.h>
+#include <inttypes.h>
 
 #include <spa/clock/clock.h>
 #include <spa/lib/debug.h>
@@ -39,6 +41,13 @@ struct impl {
 	struct pw_node this;
 
 	struct pw_work_queue *work;
+
+	struct spa_node schedule_node;
+
+	struct pw_node_stats rt_stats;	/**< updated by the data thread */
+	struct pw_node_stats stats;	/**< stats at the last update */
+	uint64_t stats_time;		/**< time of the last update */
+	bool stats_idle;		/**< the last update had no cycles */
 };
 
 struct resource_data {
@@ -47,6 +56,63 @@ struct resource_data {
 
 /** \endcond */
 
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+/* the graph schedules the node through this wrapper so that the time
+ * spent in the implementation can be measured */
+static int schedule_node_input(struct spa_node *data)
+{
+	struct impl *impl = SPA_CONTAINER_OF(data, struct impl, schedule_node);
+	struct pw_node *this = &impl->this;
+	uint64_t start;
+	int res;
+
+	if (this->rt.remote_stats)
+		return spa_node_process_input(this->node);
+
+	start = get_time_ns();
+	res = spa_node_process_input(this->node);
+	pw_node_add_stats(this, start, start, get_time_ns());
+
+	return res;
+}
+
+static int schedule_node_output(struct spa_node *data)
+{
+	struct impl *impl = SPA_CONTAINER_OF(data, struct impl, schedule_node);
+	struct pw_node *this = &impl->this;
+	uint64_t start;
+	int res;
+
+	if (this->rt.remote_stats)
+		return spa_node_process_output(this->node);
+
+	start = get_time_ns();
+	res = spa_node_process_output(this->node);
+	pw_node_add_stats(this, start, start, get_time_ns());
+
+	return res;
+}
+
+static int schedule_node_reuse_buffer(struct spa_node *data, uint32_t port_id, uint32_t buffer_id)
+{
+	struct impl *impl = SPA_CONTAINER_OF(data, struct impl, schedule_node);
+	return spa_node_port_reuse_buffer(impl->this.node, port_id, buffer_id);
+}
+
+static const struct spa_node schedule_node = {
+	SPA_VERSION_NODE,
+	NULL,
+	.process_input = schedule_node_input,
+	.process_output = schedule_node_output,
+	.port_reuse_buffer = schedule_node_reuse_buffer,
+};
+
 static int pause_node(struct pw_node *this)
 {
 	int res = 0;
@@ -342,6 +408,7 @@ int pw_node_register(struct pw_node *this,
 	update_port_ids(this);
 	update_info(this);
 
+	spa_graph_reserve(this->rt.graph, 1, 0);
 	pw_loop_invoke(this->data_loop, do_node_add, 1, NULL, 0, false, this);
 
 	if (properties == NULL)
@@ -377,6 +444,7 @@ struct pw_node *pw_node_new(struct pw_core *core,
 {
 	struct impl *impl;
 	struct pw_node *this;
+	struct pw_data_domain *domain;
 
 	impl = calloc(1, sizeof(struct impl) + user_data_size);
 	if (impl == NULL)
@@ -396,12 +464,26 @@ struct pw_node *pw_node_new(struct pw_core *core,
 
 	this->properties = properties;
 
+	this->rt.stats = &impl->rt_stats;
+
 	impl->work = pw_work_queue_new(this->core->main_loop);
 	this->info.name = strdup(name);
 
-	this->data_loop = core->data_loop;
-
-	this->rt.graph = &core->rt.graph;
+	if ((domain = pw_core_get_data_domain(core, properties)) != NULL) {
+		this->data_loop = domain->data_loop;
+		this->data_loop_impl = domain->data_loop_impl;
+		this->rt.graph = &domain->rt.graph;
+		this->rt.quantum = &domain->rt.quantum;
+		this->rt.deadline = &domain->rt.deadline;
+		this->rt.cycle_start = &domain->rt.cycle_start;
+	} else {
+		this->data_loop = core->data_loop;
+		this->data_loop_impl = core->data_loop_impl;
+		this->rt.graph = &core->rt.graph;
+		this->rt.quantum = &core->rt.quantum;
+		this->rt.deadline = &core->rt.deadline;
+		this->rt.cycle_start = &core->rt.cycle_start;
+	}
 
 	spa_list_init(&this->resource_list);
 
@@ -416,6 +498,8 @@ struct pw_node *pw_node_new(struct pw_core *core,
 	pw_map_init(&this->output_port_map, 64, 64);
 
 	spa_graph_node_init(&this->rt.node);
+	impl->schedule_node = schedule_node;
+	spa_graph_node_set_implementation(&this->rt.node, &impl->schedule_node);
 
 	return this;
 
@@ -457,6 +541,9 @@ int pw_node_update_properties(struct pw_node *node, const struct spa_dict *dict)
 	for (i = 0; i < dict->n_items; i++)
 		pw_properties_set(node->properties, dict->items[i].key, dict->items[i].value);
 
+	if (spa_dict_lookup(dict, PW_NODE_PROP_QUANTUM) != NULL)
+		pw_core_update_quantum(node->core);
+
 	node->info.props = &node->properties->dict;
 
 	node->info.change_mask = PW_NODE_CHANGE_MASK_PROPS;
@@ -492,19 +579,75 @@ static void node_event(void *data, struct spa_event *event)
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, event, event);
 }
 
+/* a driver starts a new cycle of the graph, remote nodes complete the
+ * cycles that were started by others */
+static inline void driver_start(struct pw_node *node)
+{
+	if (!node->rt.remote_stats)
+		*node->rt.cycle_start = get_time_ns();
+	if (node->rt.clock.deadline != 0)
+		*node->rt.deadline = node->rt.clock.deadline;
+}
+
+/* check the deadline after the local nodes are processed, remote nodes
+ * account for themselves when they complete */
+static void driver_end(struct pw_node *node)
+{
+	struct pw_node_stats *s = node->rt.stats;
+	struct spa_io_control_clock *clock = &node->rt.clock;
+	uint32_t seq = s->seq;
+	bool missed;
+
+	if (clock->deadline == 0)
+		return;
+
+	missed = get_time_ns() > clock->deadline;
+	if (!missed && clock->n_xruns == s->n_xruns)
+		return;
+
+	if (missed)
+		pw_log_trace("node %p: missed deadline", node);
+
+	__atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	s->n_xruns = clock->n_xruns;
+	if (missed)
+		s->n_missed++;
+
+	__atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* while the core graph freewheels, the freewheel driver starts the cycles
+ * and the wakeups of the drivers are ignored */
+static inline bool driver_suspended(struct pw_node *node)
+{
+	return node->rt.clock.deadline != 0 &&
+	       node->rt.graph == &node->core->rt.graph &&
+	       node->core->rt.freewheel != NULL;
+}
+
 static void node_need_input(void *data)
 {
 	struct pw_node *node = data;
 	pw_log_trace("node %p: need input", node);
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, need_input);
+	if (driver_suspended(node))
+		return;
+	driver_start(node);
 	spa_graph_need_input(node->rt.graph, &node->rt.node);
+	driver_end(node);
 }
 
 static void node_have_output(void *data)
 {
 	struct pw_node *node = data;
 	pw_log_trace("node %p: have output", node);
-	spa_graph_have_output(node->rt.graph, &node->rt.node);
+	if (!driver_suspended(node)) {
+		driver_start(node);
+		spa_graph_have_output(node->rt.graph, &node->rt.node);
+		driver_end(node);
+	}
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, have_output);
 }
 
@@ -539,7 +682,6 @@ void pw_node_set_implementation(struct pw_node *node,
 {
 	node->node = spa_node;
 	spa_node_set_callbacks(node->node, &node_callbacks, node);
-	spa_graph_node_set_implementation(&node->rt.node, spa_node);
 
 	if (spa_node->info)
 		pw_node_update_properties(node, spa_node->info);
@@ -550,6 +692,144 @@ struct spa_node *pw_node_get_implementation(struct pw_node *node)
 	return node->node;
 }
 
+struct pw_node *pw_node_from_graph_node(struct spa_graph_node *node)
+{
+	struct impl *impl;
+
+	if (node->implementation == NULL ||
+	    node->implementation->process_input != schedule_node_input)
+		return NULL;
+
+	impl = SPA_CONTAINER_OF(node->implementation, struct impl, schedule_node);
+	return &impl->this;
+}
+
+void pw_node_add_stats(struct pw_node *node, uint64_t signal_time,
+		       uint64_t start_time, uint64_t end_time)
+{
+	struct pw_node_stats *s = node->rt.stats;
+	uint64_t time, wakeup, prev, deadline = *node->rt.deadline;
+	uint64_t cycle_start = *node->rt.cycle_start;
+	uint32_t seq = s->seq;
+
+	time = end_time > start_time ? end_time - start_time : 0;
+
+	__atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	/* a node can be processed more than once in a cycle of the graph,
+	 * the calls of one cycle are added up */
+	if (cycle_start == 0 || cycle_start != s->cycle_start) {
+		if (cycle_start != 0 && s->cycle_start != 0 && cycle_start > s->cycle_start)
+			s->period = cycle_start - s->cycle_start;
+		else if (cycle_start == 0 && s->start_time != 0 && start_time > s->start_time)
+			s->period = start_time - s->start_time;
+		s->n_cycles++;
+		s->cycle_start = cycle_start;
+		s->cycle_time = 0;
+		s->signal_time = signal_time;
+		s->start_time = start_time;
+	}
+	prev = s->cycle_time;
+	s->cycle_time += time;
+	s->end_time = end_time;
+	s->busy_time += time;
+
+	wakeup = s->start_time > s->signal_time ? s->start_time - s->signal_time : 0;
+	if (s->cycle_time > s->max_time)
+		s->max_time = s->cycle_time;
+	if (wakeup > s->max_wakeup_time)
+		s->max_wakeup_time = wakeup;
+	/* only count the call that makes the cycle overrun */
+	if (s->period != 0 && prev + wakeup <= s->period &&
+	    s->cycle_time + wakeup > s->period)
+		s->n_overruns++;
+	/* nodes that start after the deadline are only late because of
+	 * the nodes before them */
+	if (deadline != 0 && start_time <= deadline && end_time > deadline) {
+		s->n_late++;
+		s->late_time += end_time - deadline;
+		if (end_time - deadline > s->max_late_time)
+			s->max_late_time = end_time - deadline;
+	}
+
+	__atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+
+	if (SPA_UNLIKELY(node->rt.freewheel_cycles == s->n_cycles) &&
+	    node->core->rt.freewheel != NULL)
+		pw_freewheel_node_done(node->core->rt.freewheel, node);
+}
+
+/** Get the node statistics
+ * \param node a node
+ * \param stats the statistics to fill
+ * \return 0 on success
+ *
+ * The statistics are updated from the data thread without locking, this
+ * function retries until it has read a consistent copy.
+ *
+ * \memberof pw_node
+ */
+int pw_node_get_stats(struct pw_node *node, struct pw_node_stats *stats)
+{
+	struct pw_node_stats *s = node->rt.stats;
+	uint32_t seq1, seq2;
+
+	do {
+		seq1 = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+		*stats = *s;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		seq2 = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+	} while ((seq1 & 1) || seq1 != seq2);
+
+	return 0;
+}
+
+void pw_node_update_stats(struct pw_node *node, uint64_t now)
+{
+	struct impl *impl = SPA_CONTAINER_OF(node, struct impl, this);
+	struct pw_node_stats stats;
+	struct spa_dict_item items[8];
+	char load[32], max_time[32], max_wakeup[32], overruns[32];
+	char xruns[32], missed[32], late[32], max_late[32];
+	double busy = 0.0;
+
+	pw_node_get_stats(node, &stats);
+
+	/* only update the idle stats once */
+	if (stats.n_cycles == impl->stats.n_cycles && impl->stats_idle)
+		goto done;
+
+	if (now > impl->stats_time && impl->stats_time != 0)
+		busy = (double)(stats.busy_time - impl->stats.busy_time) /
+			(now - impl->stats_time);
+
+	snprintf(load, sizeof(load), "%.3f", busy);
+	snprintf(max_time, sizeof(max_time), "%"PRIu64, stats.max_time / 1000);
+	snprintf(max_wakeup, sizeof(max_wakeup), "%"PRIu64, stats.max_wakeup_time / 1000);
+	snprintf(overruns, sizeof(overruns), "%"PRIu64, stats.n_overruns);
+	snprintf(xruns, sizeof(xruns), "%"PRIu64, stats.n_xruns);
+	snprintf(missed, sizeof(missed), "%"PRIu64, stats.n_missed);
+	snprintf(late, sizeof(late), "%"PRIu64, stats.n_late);
+	snprintf(max_late, sizeof(max_late), "%"PRIu64, stats.max_late_time / 1000);
+
+	items[0] = SPA_DICT_ITEM_INIT(PW_NODE_PROP_STATS_LOAD, load);
+	items[1] = SPA_DICT_ITEM_INIT(PW_NODE_PROP_STATS_MAX_TIME, max_time);
+	items[2] = SPA_DICT_ITEM_INIT(PW_NODE_PROP_STATS_MAX_WAKEUP, max_wakeup);
+	items[3] = SPA_DICT_ITEM_INIT(PW_NODE_PROP_STATS_OVERRUNS, overruns);
+	items[4] = SPA_DICT_ITEM_INIT(PW_NODE_PROP_STATS_XRUNS, xruns);
+	items[5] = SPA_DICT_ITEM_INIT(PW_NODE_PROP_STATS_MISSED, missed);
+	items[6] = SPA_DICT_ITEM_INIT(PW_NODE_PROP_STATS_LATE, late);
+	items[7] = SPA_DICT_ITEM_INIT(PW_NODE_PROP_STATS_MAX_LATE, max_late);
+
+	pw_node_update_properties(node, &SPA_DICT_INIT(items, 8));
+
+	impl->stats_idle = stats.n_cycles == impl->stats.n_cycles;
+      done:
+	impl->stats = stats;
+	impl->stats_time = now;
+}
+
 void pw_node_add_listener(struct pw_node *node,
 			   struct spa_hook *listener,
 			   const struct pw_node_events *events,
@@ -594,6 +874,8 @@ void pw_node_destroy(struct pw_node *node)
 		spa_list_remove(&node->link);
 		pw_global_destroy(node->global);
 		node->global = NULL;
+		pw_core_update_quantum(node->core);
+		spa_graph_reserve(node->rt.graph, -1, 0);
 	}
 
 	spa_list_for_each_safe(resource, tmp, &node->resource_list, link)
@@ -860,6 +1142,9 @@ void pw_node_update_state(struct pw_node *node, enum pw_node_state state, char *
 		if (state == PW_NODE_STATE_IDLE)
 			node_deactivate(node);
 
+		if (old == PW_NODE_STATE_RUNNING || state == PW_NODE_STATE_RUNNING)
+			pw_core_update_quantum(node->core);
+
 		spa_hook_list_call(&node->listener_list, struct pw_node_events, state_changed,
 				 old, state, error);
 
@@ -93,6 +93,66 @@ struct pw_node_events {
 #define PW_NODE_PROP_AUTOCONNECT	"pipewire.autoconnect"
 /** Try to connect the node to this node id */
 #define PW_NODE_PROP_TARGET_NODE	"pipewire.target.node"
+/** Schedule the node from the data loop with this name instead of the
+ * core data loop. Nodes with the same name share the loop, the
+ * \ref PW_DATA_LOOP_PROP_RT_PRIO and \ref PW_DATA_LOOP_PROP_CPU properties
+ * of the first node configure it. Only nodes of the same data loop can be
+ * linked. */
+#define PW_NODE_PROP_DATA_LOOP		"pipewire.data-loop"
+/** The quantum in samples the node wants to process. The graph runs with
+ * the smallest quantum of the running nodes. */
+#define PW_NODE_PROP_QUANTUM		"pipewire.quantum"
+
+/** Fraction of the time spent processing since the previous update */
+#define PW_NODE_PROP_STATS_LOAD		"pipewire.node.load"
+/** Max time in usec to process one cycle */
+#define PW_NODE_PROP_STATS_MAX_TIME	"pipewire.node.max-time"
+/** Max time in usec between waking up a client node and the client
+ * starting to process */
+#define PW_NODE_PROP_STATS_MAX_WAKEUP	"pipewire.node.max-wakeup"
+/** Number of cycles that took longer than the time between two cycles */
+#define PW_NODE_PROP_STATS_OVERRUNS	"pipewire.node.overruns"
+/** Number of xruns of the node when it drives the graph */
+#define PW_NODE_PROP_STATS_XRUNS	"pipewire.node.xruns"
+/** Number of cycles started by the node as a driver that did not
+ * complete before the deadline */
+#define PW_NODE_PROP_STATS_MISSED	"pipewire.node.missed"
+/** Number of cycles where the node was still processing at the deadline
+ * of the driver, this is the node that made the cycle miss the deadline */
+#define PW_NODE_PROP_STATS_LATE		"pipewire.node.late"
+/** Max time in usec the node finished after the deadline */
+#define PW_NODE_PROP_STATS_MAX_LATE	"pipewire.node.max-late"
+
+/** Processing statistics of a node.
+ *
+ * The statistics are kept in the node and updated from the data thread
+ * every time the node is processed. They are protected by a sequence
+ * lock: \a seq is odd while an update is in progress, use
+ * \ref pw_node_get_stats to read a consistent copy from another thread.
+ * All times are in nanoseconds of CLOCK_MONOTONIC. */
+struct pw_node_stats {
+	uint32_t seq;			/**< update sequence number */
+	uint32_t padding;
+	uint64_t n_cycles;		/**< number of cycles the node processed in */
+	uint64_t signal_time;		/**< when the last cycle was signaled */
+	uint64_t start_time;		/**< when the last cycle started */
+	uint64_t end_time;		/**< when the last cycle ended */
+	uint64_t period;		/**< time between the starts of the last two
+					  *  cycles of the graph */
+	uint64_t busy_time;		/**< total time spent processing */
+	uint64_t max_time;		/**< max time processing in one cycle */
+	uint64_t max_wakeup_time;	/**< max time between signal and start */
+	uint64_t n_overruns;		/**< cycles that took longer than the period */
+	uint64_t n_xruns;		/**< xruns of the driver */
+	uint64_t n_missed;		/**< driven cycles that missed the deadline */
+	uint64_t n_late;		/**< cycles that ended after the deadline and
+					  *  started before it */
+	uint64_t late_time;		/**< total time past the deadline */
+	uint64_t max_late_time;		/**< max time past the deadline */
+	uint64_t cycle_start;		/**< start of the cycle of the graph of the
+					  *  last update, 0 when unknown */
+	uint64_t cycle_time;		/**< time spent processing in that cycle */
+};
 
 /** Create a new node \memberof pw_node */
 struct pw_node *
@@ -133,6 +193,9 @@ void pw_node_set_implementation(struct pw_node *node, struct spa_node *spa_node)
 /** Get the node implementation */
 struct spa_node *pw_node_get_implementation(struct pw_node *node);
 
+/** Get a consistent copy of the processing statistics of the node */
+int pw_node_get_stats(struct pw_node *node, struct pw_node_stats *stats);
+
 /** Add an event listener */
 void pw_node_add_listener(struct pw_node *node,
 			  struct spa_hook *listener,
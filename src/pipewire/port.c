@@ -320,8 +320,18 @@ int pw_port_add(struct pw_port *port, struct pw_node *node)
 			     port->direction, port_id,
 			     node->core->type.io.Buffers,
 			     port->rt.port.io, sizeof(*port->rt.port.io));
+	spa_node_port_set_io(node->node,
+			     port->direction, port_id,
+			     node->core->type.io.ControlQuantum,
+			     node->rt.quantum, sizeof(*node->rt.quantum));
+	spa_node_port_set_io(node->node,
+			     port->direction, port_id,
+			     node->core->type.io.ControlClock,
+			     &node->rt.clock, sizeof(node->rt.clock));
 
+	/* the mix node with the port of the node and the mix port */
 	port->rt.graph = node->rt.graph;
+	spa_graph_reserve(port->rt.graph, 1, 2);
 	pw_loop_invoke(node->data_loop, do_add_port, SPA_ID_INVALID, NULL, 0, false, port);
 
 	if (port->state <= PW_PORT_STATE_INIT)
@@ -349,18 +359,37 @@ static int do_remove_port(struct spa_loop *loop,
 	return 0;
 }
 
+static void port_free(void *data)
+{
+	struct pw_port *port = data;
+
+	pw_log_debug("port %p: reclaim", port);
+
+	if (port->allocated) {
+		free(port->buffers);
+		pw_memblock_free(port->buffer_mem);
+	}
+	free(port);
+}
+
 void pw_port_destroy(struct pw_port *port)
 {
 	struct pw_node *node = port->node;
+	struct pw_loop *data_loop = NULL;
 
 	pw_log_debug("port %p: destroy", port);
 
 	spa_hook_list_call(&port->listener_list, struct pw_port_events, destroy);
 
 	if (node) {
-		if (port->rt.graph)
-			pw_loop_invoke(port->node->data_loop, do_remove_port,
-				       SPA_ID_INVALID, NULL, 0, true, port);
+		/* the data thread can use the port until it removed it from
+		 * the graph, the memory is reclaimed after that */
+		if (port->rt.graph) {
+			data_loop = node->data_loop;
+			pw_loop_invoke(data_loop, do_remove_port,
+				       SPA_ID_INVALID, NULL, 0, false, port);
+			spa_graph_reserve(port->rt.graph, -1, -2);
+		}
 
 		if (port->direction == PW_DIRECTION_INPUT) {
 			pw_map_remove(&node->input_port_map, port->port_id);
@@ -377,15 +406,13 @@ void pw_port_destroy(struct pw_port *port)
 	pw_log_debug("port %p: free", port);
 	spa_hook_list_call(&port->listener_list, struct pw_port_events, free);
 
-	if (port->allocated) {
-		free(port->buffers);
-		pw_memblock_free(port->buffer_mem);
-	}
-
 	if (port->properties)
 		pw_properties_free(port->properties);
 
-	free(port);
+	if (data_loop)
+		pw_core_defer_free(node->core, data_loop, &port->reclaim, port_free, port);
+	else
+		port_free(port);
 }
 
 static int
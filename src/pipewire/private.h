@@ -31,6 +31,7 @@ extern "C" {
 #include "pipewire/mem.h"
 #include "pipewire/pipewire.h"
 #include "pipewire/introspect.h"
+#include "pipewire/data-loop.h"
 
 #ifndef spa_debug
 #define spa_debug pw_log_trace
@@ -146,6 +147,7 @@ struct pw_core {
 	struct spa_list factory_list;		/**< list of factories */
 	struct spa_list link_list;		/**< list of links */
 	struct spa_list control_list[2];	/**< list of controls, indexed by direction */
+	struct spa_list data_domain_list;	/**< list of data domains */
 
 	struct spa_hook_list listener_list;
 
@@ -162,6 +164,12 @@ struct pw_core {
 
 	struct {
 		struct spa_graph graph;
+		struct spa_io_control_quantum quantum;	/**< quantum of the graph */
+		uint64_t deadline;			/**< deadline of the current cycle */
+		uint64_t cycle_start;			/**< start of the current cycle */
+		struct pw_freewheel *freewheel;		/**< starts the cycles while the graph
+							  *  freewheels, only used from the
+							  *  data thread */
 	} rt;
 };
 
@@ -174,6 +182,34 @@ struct pw_data_loop {
 
         bool running;
         pthread_t thread;
+
+	int rtprio;		/**< realtime priority of the thread */
+	int cpu;		/**< cpu of the thread or -1 */
+
+	uint64_t spin;		/**< spin budget in nsec, 0 disables spinning */
+	struct spa_hook_list spin_list;	/**< checks run while spinning */
+	struct pw_data_loop_stats stats;	/**< written by the loop thread */
+};
+
+/** Nodes that are scheduled from their own data loop and graph, independent
+ * of the core data loop. Domains are created on first use and live as long
+ * as the core. */
+struct pw_data_domain {
+	struct spa_list link;		/**< link in core data_domain_list */
+	char *name;			/**< name of the domain */
+
+	struct pw_loop *data_loop;	/**< data loop of the domain */
+	struct pw_data_loop *data_loop_impl;
+
+	struct spa_support support[16];	/**< core support with the domain data loop */
+	uint32_t n_support;		/**< number of support items */
+
+	struct {
+		struct spa_graph graph;
+		struct spa_io_control_quantum quantum;	/**< quantum of the graph */
+		uint64_t deadline;		/**< deadline of the current cycle */
+		uint64_t cycle_start;		/**< start of the current cycle */
+	} rt;
 };
 
 struct pw_main_loop {
@@ -263,15 +299,49 @@ struct pw_node {
 	struct spa_hook_list listener_list;
 
 	struct pw_loop *data_loop;		/**< the data loop for this node */
+	struct pw_data_loop *data_loop_impl;
 
 	struct {
 		struct spa_graph *graph;
 		struct spa_graph_node node;
+		struct pw_node_stats *stats;	/**< statistics of the data thread */
+		bool remote_stats;		/**< the statistics are added when the
+						  *  remote client completes */
+		struct spa_io_control_clock clock;	/**< clock when the node is a driver */
+		struct spa_io_control_quantum *quantum;	/**< quantum of the graph */
+		uint64_t *deadline;		/**< deadline of the cycle of the graph */
+		uint64_t *cycle_start;		/**< start of the cycle of the graph */
+		uint64_t freewheel_cycles;	/**< cycles the node must reach to complete
+						  *  the pull of the freewheel driver */
 	} rt;
 
         void *user_data;                /**< extra user data */
 };
 
+/** Add the timings of one processed cycle to the node statistics, only
+ * call this from the data thread of the node */
+void pw_node_add_stats(struct pw_node *node, uint64_t signal_time,
+		       uint64_t start_time, uint64_t end_time);
+
+/** Get the node that is scheduled by a graph node, NULL when the graph node
+ * is not the node of a \ref pw_node */
+struct pw_node *pw_node_from_graph_node(struct spa_graph_node *node);
+
+/** Update the statistics properties of the node, called from the main loop */
+void pw_node_update_stats(struct pw_node *node, uint64_t now);
+
+/** Memory that is freed once a data loop is done with it, embed this in
+ * the object so that queueing the free can't fail, see
+ * pw_core_defer_free() */
+struct pw_reclaim {
+	struct spa_list link;		/**< link in the core reclaim list */
+	struct pw_core *core;
+	struct pw_loop *loop;
+	bool done;			/**< set from the data thread */
+	void (*func) (void *data);
+	void *data;
+};
+
 struct pw_port {
 	struct spa_list link;		/**< link in node port_list */
 
@@ -306,6 +376,8 @@ struct pw_port {
 		struct spa_graph_node mix_node;	/**< mixer node */
 	} rt;					/**< data only accessed from the data thread */
 
+	struct pw_reclaim reclaim;	/**< frees the port after the data thread */
+
         void *user_data;                /**< extra user data */
 };
 
@@ -512,6 +584,46 @@ int pw_link_activate(struct pw_link *link);
 /** Deactivate a link \memberof pw_link */
 int pw_link_deactivate(struct pw_link *link);
 
+/** Make the calling thread realtime */
+void pw_thread_make_realtime(int rtprio);
+
+/** Find or create the data domain named in \a properties with
+ * \ref PW_NODE_PROP_DATA_LOOP. Returns NULL when the core data loop
+ * should be used. */
+struct pw_data_domain *
+pw_core_get_data_domain(struct pw_core *core, const struct pw_properties *properties);
+
+/** Call \a func from the main loop once \a loop has handled everything
+ * that was queued on it with pw_loop_invoke() before this call. Use this
+ * to free memory that the data thread can still see instead of blocking
+ * in pw_loop_invoke(). \a reclaim is owned by the core until \a func is
+ * called and can be used again from \a func. */
+void pw_core_defer_free(struct pw_core *core, struct pw_loop *loop,
+			struct pw_reclaim *reclaim,
+			void (*func) (void *data), void *data);
+
+/** Update the quantum of the graph after the state or the
+ * \ref PW_NODE_PROP_QUANTUM of a node changed */
+void pw_core_update_quantum(struct pw_core *core);
+
+/** Create a pool of workers that runs the graph in parallel */
+struct pw_workers *pw_workers_new(struct spa_graph *graph, uint32_t n_workers, int rtprio);
+
+/** Destroy a pool of workers */
+void pw_workers_destroy(struct pw_workers *workers);
+
+/** Run a graph back to back from its data loop */
+struct pw_freewheel *pw_freewheel_new(struct pw_core *core);
+
+/** Called from the data thread when \a node completed the freewheel cycle */
+void pw_freewheel_node_done(struct pw_freewheel *freewheel, struct pw_node *node);
+
+/** Get the number of cycles that were run */
+uint64_t pw_freewheel_get_cycles(struct pw_freewheel *freewheel);
+
+/** Stop and destroy a freewheel driver */
+void pw_freewheel_destroy(struct pw_freewheel *freewheel);
+
 struct pw_control *
 pw_control_new(struct pw_core *core,
 	       struct pw_port *owner,		/**< can be NULL */
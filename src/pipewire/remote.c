@@ -22,6 +22,7 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/mman.h>
 
 #include <spa/pod/parser.h>
@@ -102,6 +103,13 @@ struct node_data {
 
 /** \endcond */
 
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
 const char *pw_remote_state_as_string(enum pw_remote_state state)
 {
 	switch (state) {
@@ -526,6 +534,11 @@ on_rtsocket_condition(void *user_data, int fd, enum spa_io mask)
 		if (cmd > 1)
 			pw_log_warn("proxy %p: %ld messages", proxy, cmd);
 
+		data->trans->area->start_time = get_time_ns();
+		/* the daemon started the cycle of our graph */
+		*data->node->rt.cycle_start = data->trans->area->start_time;
+		if (data->trans->area->quantum != 0)
+			data->node->rt.quantum->size = data->trans->area->quantum;
 
 		while (pw_client_node_transport_next_message(data->trans, &message) == 1) {
 			struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
@@ -580,10 +593,12 @@ static void clean_transport(struct pw_proxy *proxy)
 	spa_list_for_each(port, &data->node->input_ports, link) {
 		spa_graph_port_remove(&data->in_ports[port->port_id].output);
 		spa_graph_port_remove(&data->in_ports[port->port_id].input);
+		spa_graph_reserve(port->rt.graph, 0, -1);
 	}
 	spa_list_for_each(port, &data->node->output_ports, link) {
 		spa_graph_port_remove(&data->out_ports[port->port_id].output);
 		spa_graph_port_remove(&data->out_ports[port->port_id].input);
+		spa_graph_reserve(port->rt.graph, 0, -1);
 	}
 
 	pw_array_for_each(mid, &data->mem_ids)
@@ -683,6 +698,7 @@ static void client_node_transport(void *object, uint32_t node_id,
 		pw_log_info("transport in %d %p", i, &data->trans->inputs[i]);
 	}
 	spa_list_for_each(port, &data->node->input_ports, link) {
+		spa_graph_reserve(port->rt.graph, 0, 1);
 		spa_graph_port_add(&port->rt.mix_node, &data->in_ports[port->port_id].input);
 		data->in_ports[port->port_id].port = port;
 	}
@@ -705,6 +721,7 @@ static void client_node_transport(void *object, uint32_t node_id,
 		pw_log_info("transport out %d %p", i, &data->trans->inputs[i]);
 	}
 	spa_list_for_each(port, &data->node->output_ports, link) {
+		spa_graph_reserve(port->rt.graph, 0, 1);
 		spa_graph_port_add(&port->rt.mix_node, &data->out_ports[port->port_id].output);
 		data->out_ports[port->port_id].port = port;
 	}
@@ -794,6 +811,7 @@ static void node_need_input(void *data)
 {
 	struct node_data *d = data;
         uint64_t cmd = 1;
+	d->trans->area->end_time = get_time_ns();
 	pw_client_node_transport_add_message(d->trans,
 				&PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_NEED_INPUT));
         write(d->rtwritefd, &cmd, 8);
@@ -803,6 +821,7 @@ static void node_have_output(void *data)
 {
 	struct node_data *d = data;
         uint64_t cmd = 1;
+	d->trans->area->end_time = get_time_ns();
         pw_client_node_transport_add_message(d->trans,
                                &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT));
         write(d->rtwritefd, &cmd, 8);
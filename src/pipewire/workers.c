@@ -0,0 +1,781 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "pipewire/log.h"
+#include "pipewire/private.h"
+
+/** \cond */
+#define PHASE_PULL	0
+#define PHASE_PUSH	1
+
+#define EMPTY		((uint32_t)-1)
+
+/* rounds without work before a worker leaves the phase or the data thread
+ * sleeps until there is work */
+#define SPIN_ROUNDS	4096
+
+struct node {
+	struct spa_graph_node *node;
+	uint32_t component;		/**< connected component of the node */
+	uint32_t n_peers[2];		/**< number of in-graph peers, per direction */
+	uint32_t *peers[2];		/**< index of the in-graph peers, per direction */
+	int32_t pending;		/**< unfinished dependencies in this phase */
+};
+
+/* Chase-Lev work stealing deque. Each node is queued at most once per
+ * phase so the array never needs to grow. */
+struct deque {
+	int32_t top __attribute__((aligned(64)));
+	int32_t bottom __attribute__((aligned(64)));
+	uint32_t *items;
+};
+
+/* the memory for the nodes, the peers and the queues */
+struct storage {
+	struct storage *next;		/**< next retired storage */
+	uint32_t max_nodes;
+	uint32_t max_peers;
+	struct node *nodes;
+	uint32_t *peers;		/**< peers followed by the component parents */
+	uint32_t *items;		/**< queue items, max_nodes per worker */
+};
+
+struct worker {
+	struct pw_workers *workers;
+	uint32_t id;
+	pthread_t thread;
+	sem_t sem;
+	struct deque queue;
+	uint32_t steal_from;
+};
+
+struct pw_workers {
+	struct spa_graph *graph;
+	const struct spa_graph_callbacks *callbacks;	/**< replaced callbacks */
+	void *callbacks_data;
+	uint32_t version;
+
+	struct node *nodes;
+	uint32_t n_nodes;
+	struct storage *storage;	/**< in use by the data thread */
+
+	/* owned by the thread that changes the graph */
+	struct storage *pending;	/**< newest storage, not taken yet */
+	struct storage *retired;	/**< storage given back to be freed */
+	int32_t reserved_nodes;		/**< room asked for */
+	int32_t reserved_peers;
+	uint32_t max_nodes;		/**< room of the newest storage */
+	uint32_t max_peers;
+
+	uint32_t n_workers;
+	struct worker *workers;		/**< worker 0 is the calling data thread */
+	int rtprio;
+
+	bool running;			/**< a cycle runs, read from the workers */
+	bool quit;			/**< the workers should exit */
+	int phase;
+	struct spa_graph_node *trigger;
+	uint32_t component;
+
+	int32_t remaining __attribute__((aligned(64)));	/**< nodes left in the phase */
+	int32_t busy;			/**< workers still in the phase */
+	int32_t sleeping;		/**< the data thread waits for work */
+};
+/** \endcond */
+
+static inline void deque_reset(struct deque *d)
+{
+	__atomic_store_n(&d->top, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&d->bottom, 0, __ATOMIC_RELAXED);
+}
+
+static inline void deque_push(struct deque *d, uint32_t item)
+{
+	int32_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+	d->items[b] = item;
+	__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t deque_pop(struct deque *d)
+{
+	int32_t b, t;
+	uint32_t item = EMPTY;
+
+	b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+	__atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+	if (t <= b) {
+		item = d->items[b];
+		if (t == b) {
+			if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, false,
+							 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+				item = EMPTY;
+			__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+		}
+	} else {
+		__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+	return item;
+}
+
+static inline uint32_t deque_steal(struct deque *d)
+{
+	int32_t t, b;
+	uint32_t item;
+
+	t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+
+	if (t >= b)
+		return EMPTY;
+
+	item = d->items[t];
+	if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, false,
+					 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return EMPTY;
+	return item;
+}
+
+static struct node *find_node(struct pw_workers *this, struct spa_graph_node *node)
+{
+	struct node *nd = node->scheduler_data;
+
+	/* removed nodes can still point to an old slot */
+	if (node->graph != this->graph || nd == NULL ||
+	    nd < this->nodes || nd >= this->nodes + this->n_nodes || nd->node != node)
+		return NULL;
+	return nd;
+}
+
+static inline struct spa_graph_node *peer_node(struct spa_graph_port *p)
+{
+	struct spa_graph_port *pp = p->peer;
+
+	/* nodes of other graphs are scheduled from their own data loop */
+	if (pp == NULL || (pp->flags & SPA_GRAPH_PORT_FLAG_DISABLED) ||
+	    (pp->node->graph != NULL && pp->node->graph != p->node->graph))
+		return NULL;
+	return pp->node;
+}
+
+static uint32_t find_component(struct pw_workers *this, uint32_t *parent, uint32_t i)
+{
+	while (parent[i] != i)
+		i = parent[i] = parent[parent[i]];
+	return i;
+}
+
+static struct storage *storage_new(struct pw_workers *this,
+				   uint32_t max_nodes, uint32_t max_peers)
+{
+	struct storage *s;
+
+	s = malloc(sizeof(struct storage) + max_nodes * sizeof(struct node) +
+		   (2 * max_peers + this->n_workers * max_nodes) * sizeof(uint32_t));
+	if (s == NULL)
+		return NULL;
+
+	s->next = NULL;
+	s->max_nodes = max_nodes;
+	s->max_peers = max_peers;
+	s->nodes = SPA_MEMBER(s, sizeof(struct storage), struct node);
+	s->peers = SPA_MEMBER(s->nodes, max_nodes * sizeof(struct node), uint32_t);
+	s->items = s->peers + 2 * max_peers;
+	return s;
+}
+
+static void free_retired(struct pw_workers *this)
+{
+	struct storage *s, *next;
+
+	s = __atomic_exchange_n(&this->retired, NULL, __ATOMIC_ACQUIRE);
+	for (; s; s = next) {
+		next = s->next;
+		free(s);
+	}
+}
+
+/* give \a s back to the thread that changes the graph */
+static void retire(struct pw_workers *this, struct storage *s)
+{
+	s->next = __atomic_load_n(&this->retired, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&this->retired, &s->next, s, false,
+					    __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* make room, from the thread that changes the graph */
+static int reserve(struct pw_workers *this, int32_t n_nodes, int32_t n_ports)
+{
+	struct storage *s;
+	uint32_t max_nodes, max_peers;
+
+	free_retired(this);
+
+	/* a port has at most one peer */
+	this->reserved_nodes = SPA_MAX(this->reserved_nodes + n_nodes, 0);
+	this->reserved_peers = SPA_MAX(this->reserved_peers + n_ports, 0);
+
+	/* the peers array also holds the component parents while sorting */
+	max_nodes = this->reserved_nodes;
+	max_peers = SPA_MAX(this->reserved_peers, this->reserved_nodes);
+	if (max_nodes <= this->max_nodes && max_peers <= this->max_peers)
+		return 0;
+
+	max_nodes = SPA_MAX(max_nodes, this->max_nodes * 2);
+	max_peers = SPA_MAX(max_peers, this->max_peers * 2);
+	if ((s = storage_new(this, max_nodes, max_peers)) == NULL)
+		return -ENOMEM;
+
+	/* a storage that was not taken yet was never used */
+	free(__atomic_exchange_n(&this->pending, s, __ATOMIC_ACQ_REL));
+	this->max_nodes = max_nodes;
+	this->max_peers = max_peers;
+
+	return 0;
+}
+
+/* take the newest storage, from the data thread */
+static int ensure(struct pw_workers *this, uint32_t n_nodes, uint32_t n_peers)
+{
+	struct storage *s, *old = this->storage;
+	uint32_t i;
+
+	if ((s = __atomic_exchange_n(&this->pending, NULL, __ATOMIC_ACQUIRE)) == NULL)
+		s = old;
+
+	/* only when nodes or ports were added without reserving room */
+	if (s == NULL || n_nodes > s->max_nodes || n_peers > s->max_peers) {
+		struct storage *t;
+
+		pw_log_debug("workers %p: %d nodes %d peers were not reserved", this,
+			     n_nodes, n_peers);
+		if ((t = storage_new(this, n_nodes * 2, n_peers * 2)) == NULL)
+			return -ENOMEM;
+		if (s != NULL && s != old)
+			retire(this, s);
+		s = t;
+	}
+	if (s != old) {
+		if (old != NULL)
+			retire(this, old);
+		this->storage = s;
+		this->nodes = s->nodes;
+		this->n_nodes = 0;
+		for (i = 0; i < this->n_workers; i++)
+			this->workers[i].queue.items = s->items + i * s->max_nodes;
+	}
+	return 0;
+}
+
+static int rebuild(struct pw_workers *this)
+{
+	struct spa_graph *graph = this->graph;
+	struct spa_graph_node *n, *pn;
+	struct spa_graph_port *p;
+	uint32_t i, j, d, n_nodes = 0, n_peers = 0, *peers, *parent;
+	struct node *nd;
+	int res;
+
+	spa_list_for_each(n, &graph->nodes, link) {
+		n_nodes++;
+		for (d = 0; d < 2; d++)
+			spa_list_for_each(p, &n->ports[d], link)
+				n_peers++;
+	}
+
+	/* the peers array also holds the component parents while sorting */
+	if ((res = ensure(this, n_nodes, SPA_MAX(n_peers, n_nodes))) < 0)
+		return res;
+	peers = this->storage->peers;
+
+	i = 0;
+	spa_list_for_each(n, &graph->nodes, link) {
+		nd = &this->nodes[i];
+		nd->node = n;
+		nd->component = i++;
+		n->scheduler_data = nd;
+	}
+	this->n_nodes = n_nodes;
+
+	parent = &peers[this->storage->max_peers];
+	for (i = 0; i < n_nodes; i++)
+		parent[i] = i;
+
+	j = 0;
+	for (i = 0; i < n_nodes; i++) {
+		nd = &this->nodes[i];
+		for (d = 0; d < 2; d++) {
+			nd->peers[d] = &peers[j];
+			nd->n_peers[d] = 0;
+			spa_list_for_each(p, &nd->node->ports[d], link) {
+				struct node *pnd;
+				if ((pn = peer_node(p)) == NULL ||
+				    (pnd = find_node(this, pn)) == NULL)
+					continue;
+				nd->peers[d][nd->n_peers[d]++] = pnd - this->nodes;
+				parent[find_component(this, parent, i)] =
+					find_component(this, parent, pnd - this->nodes);
+			}
+			j += nd->n_peers[d];
+		}
+	}
+	for (i = 0; i < n_nodes; i++)
+		this->nodes[i].component = find_component(this, parent, i);
+
+	this->version = graph->version;
+
+	pw_log_debug("workers %p: rebuild %d nodes %d peers", this, n_nodes, j);
+
+	return 0;
+}
+
+/* the linked ports of \a node in \a dir with \a status, \a required counts
+ * the ports that are not optional */
+static uint32_t count_ports(struct spa_graph_node *node, enum spa_direction dir,
+			    int status, uint32_t *required)
+{
+	struct spa_graph_port *p;
+	uint32_t n = 0;
+
+	if (required)
+		*required = 0;
+	spa_list_for_each(p, &node->ports[dir], link) {
+		if (peer_node(p) == NULL || p->io->status != status)
+			continue;
+		n++;
+		if (required && !(p->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
+			(*required)++;
+	}
+	return n;
+}
+
+/* like the serial scheduler, a node runs when all the ports it asked for
+ * are ready: pull when data is requested on the outputs it produced on
+ * last time, push when there is data on the inputs it asked data for.
+ * A node that did not ask for anything runs when any port is ready. */
+static bool node_wants(struct spa_graph_node *node, int phase)
+{
+	enum spa_direction dir;
+	uint32_t ready, required;
+
+	if (phase == PHASE_PULL) {
+		dir = SPA_DIRECTION_OUTPUT;
+		ready = count_ports(node, dir, SPA_STATUS_NEED_BUFFER, NULL);
+	} else {
+		dir = SPA_DIRECTION_INPUT;
+		ready = count_ports(node, dir, SPA_STATUS_HAVE_BUFFER, NULL);
+	}
+	required = node->required[dir];
+
+	return required > 0 ? ready >= required : ready > 0;
+}
+
+/* remember what the node asked for after it was processed, the ports it
+ * needs data on and the ports it produced data on */
+static void node_update_required(struct spa_graph_node *node, int phase)
+{
+	if (phase == PHASE_PULL)
+		count_ports(node, SPA_DIRECTION_INPUT, SPA_STATUS_NEED_BUFFER,
+			    &node->required[SPA_DIRECTION_INPUT]);
+	else
+		count_ports(node, SPA_DIRECTION_OUTPUT, SPA_STATUS_HAVE_BUFFER,
+			    &node->required[SPA_DIRECTION_OUTPUT]);
+}
+
+/* nodes that are linked to the graph but not part of it are processed
+ * together with their peer */
+static void process_foreign(struct pw_workers *this, struct spa_graph_node *node, int phase)
+{
+	struct spa_graph_port *p;
+	struct spa_graph_node *pn;
+
+	if (phase == PHASE_PULL) {
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+			if ((pn = peer_node(p)) == NULL || find_node(this, pn) ||
+			    p->io->status != SPA_STATUS_NEED_BUFFER)
+				continue;
+			spa_node_process_output(pn->implementation);
+		}
+	} else {
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+			if ((pn = peer_node(p)) == NULL || find_node(this, pn) ||
+			    p->io->status != SPA_STATUS_HAVE_BUFFER)
+				continue;
+			spa_node_process_input(pn->implementation);
+		}
+	}
+}
+
+/* wake up the data thread when it sleeps in run_phase */
+static inline void wake_data_thread(struct pw_workers *this)
+{
+	if (__atomic_load_n(&this->sleeping, __ATOMIC_SEQ_CST) &&
+	    __atomic_exchange_n(&this->sleeping, 0, __ATOMIC_SEQ_CST))
+		sem_post(&this->workers[0].sem);
+}
+
+static void process_node(struct pw_workers *this, struct worker *w, uint32_t index)
+{
+	struct node *nd = &this->nodes[index];
+	struct spa_graph_node *node = nd->node;
+	int phase = this->phase;
+	uint32_t i, dir;
+
+	if (node != this->trigger && node_wants(node, phase)) {
+		if (phase == PHASE_PULL) {
+			spa_node_process_output(node->implementation);
+		} else {
+			spa_node_process_input(node->implementation);
+		}
+	}
+	node_update_required(node, phase);
+	process_foreign(this, node, phase);
+
+	/* the pull phase releases the upstream nodes, the push phase
+	 * releases the downstream nodes */
+	dir = phase == PHASE_PULL ? SPA_DIRECTION_INPUT : SPA_DIRECTION_OUTPUT;
+	for (i = 0; i < nd->n_peers[dir]; i++) {
+		uint32_t peer = nd->peers[dir][i];
+		if (__atomic_sub_fetch(&this->nodes[peer].pending, 1, __ATOMIC_ACQ_REL) == 0)
+			deque_push(&w->queue, peer);
+	}
+	__atomic_sub_fetch(&this->remaining, 1, __ATOMIC_SEQ_CST);
+	wake_data_thread(this);
+}
+
+static uint32_t next_node(struct pw_workers *this, struct worker *w)
+{
+	uint32_t i, item;
+
+	if ((item = deque_pop(&w->queue)) != EMPTY)
+		return item;
+
+	for (i = 0; i < this->n_workers; i++) {
+		struct worker *v = &this->workers[w->steal_from];
+
+		if (++w->steal_from == this->n_workers)
+			w->steal_from = 0;
+		if (v == w)
+			continue;
+		if ((item = deque_steal(&v->queue)) != EMPTY)
+			return item;
+	}
+	return EMPTY;
+}
+
+/* process nodes until the phase is done or no node was found for a while,
+ * the data thread stays and processes the nodes that are released later */
+static void work(struct pw_workers *this, struct worker *w)
+{
+	uint32_t item, spins = 0;
+
+	while (__atomic_load_n(&this->remaining, __ATOMIC_ACQUIRE) > 0 &&
+	       spins < SPIN_ROUNDS) {
+		if ((item = next_node(this, w)) != EMPTY) {
+			process_node(this, w, item);
+			spins = 0;
+		} else
+			spins++;
+	}
+}
+
+static bool phase_done(struct pw_workers *this)
+{
+	return __atomic_load_n(&this->remaining, __ATOMIC_SEQ_CST) == 0 &&
+	       __atomic_load_n(&this->busy, __ATOMIC_SEQ_CST) == 0;
+}
+
+static bool can_steal(struct pw_workers *this)
+{
+	uint32_t i;
+
+	for (i = 1; i < this->n_workers; i++) {
+		struct deque *d = &this->workers[i].queue;
+		if (__atomic_load_n(&d->top, __ATOMIC_ACQUIRE) <
+		    __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE))
+			return true;
+	}
+	return false;
+}
+
+/* sleep until a node is released, the phase is done or a worker leaves */
+static void wait_work(struct pw_workers *this, struct worker *w)
+{
+	__atomic_store_n(&this->sleeping, 1, __ATOMIC_SEQ_CST);
+	if (phase_done(this) || can_steal(this)) {
+		/* when a worker cleared the flag, it also posts the semaphore */
+		if (__atomic_exchange_n(&this->sleeping, 0, __ATOMIC_SEQ_CST))
+			return;
+	}
+	while (sem_wait(&w->sem) < 0 && errno == EINTR);
+}
+
+static void *do_work(void *user_data)
+{
+	struct worker *w = user_data;
+	struct pw_workers *this = w->workers;
+
+	pw_thread_make_realtime(this->rtprio);
+
+	pw_log_debug("workers %p: worker %d enter thread", this, w->id);
+	while (true) {
+		while (sem_wait(&w->sem) < 0 && errno == EINTR);
+		if (__atomic_load_n(&this->quit, __ATOMIC_ACQUIRE))
+			break;
+		work(this, w);
+		__atomic_sub_fetch(&this->busy, 1, __ATOMIC_SEQ_CST);
+		wake_data_thread(this);
+	}
+	pw_log_debug("workers %p: worker %d leave thread", this, w->id);
+	return NULL;
+}
+
+static void run_phase(struct pw_workers *this, int phase)
+{
+	struct worker *w = &this->workers[0];
+	uint32_t i, n_active = 0, dir, item, spins = 0;
+
+	this->phase = phase;
+	dir = phase == PHASE_PULL ? SPA_DIRECTION_OUTPUT : SPA_DIRECTION_INPUT;
+
+	for (i = 0; i < this->n_workers; i++)
+		deque_reset(&this->workers[i].queue);
+
+	for (i = 0; i < this->n_nodes; i++) {
+		struct node *nd = &this->nodes[i];
+
+		if (nd->component != this->component)
+			continue;
+
+		n_active++;
+		nd->pending = nd->n_peers[dir];
+		if (nd->pending == 0)
+			deque_push(&w->queue, i);
+	}
+	if (n_active == 0)
+		return;
+
+	this->remaining = n_active;
+	this->busy = this->n_workers - 1;
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	for (i = 1; i < this->n_workers; i++)
+		sem_post(&this->workers[i].sem);
+
+	/* the nodes can only be reset when all workers left the phase */
+	while (!phase_done(this)) {
+		if ((item = next_node(this, w)) != EMPTY) {
+			process_node(this, w, item);
+			spins = 0;
+		} else if (++spins >= SPIN_ROUNDS) {
+			wait_work(this, w);
+			spins = 0;
+		}
+	}
+}
+
+static int run(struct pw_workers *this, struct spa_graph_node *node, int phase)
+{
+	struct node *nd;
+	struct spa_graph_port *p;
+	uint32_t d;
+
+	/* called from a node while processing, maybe from a worker, the cycle
+	 * is already running */
+	if (__atomic_load_n(&this->running, __ATOMIC_ACQUIRE))
+		return 0;
+
+	if (this->version != this->graph->version && rebuild(this) < 0) {
+		pw_log_error("workers %p: can't rebuild graph", this);
+		return -ENOMEM;
+	}
+
+	if ((nd = find_node(this, node)) == NULL) {
+		for (d = 0; d < 2 && nd == NULL; d++) {
+			spa_list_for_each(p, &node->ports[d], link) {
+				if (p->peer && p->peer->node &&
+				    (nd = find_node(this, p->peer->node)) != NULL)
+					break;
+			}
+		}
+	}
+	if (nd == NULL)
+		return 0;
+
+	__atomic_store_n(&this->running, true, __ATOMIC_RELEASE);
+	this->trigger = node;
+	this->component = nd->component;
+
+	if (phase == PHASE_PULL)
+		run_phase(this, PHASE_PULL);
+
+	/* after a pull, the node that started the cycle consumes the data */
+	this->trigger = phase == PHASE_PULL ? NULL : node;
+	run_phase(this, PHASE_PUSH);
+
+	this->trigger = NULL;
+	__atomic_store_n(&this->running, false, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static int workers_need_input(void *data, struct spa_graph_node *node)
+{
+	return run(data, node, PHASE_PULL);
+}
+
+static int workers_have_output(void *data, struct spa_graph_node *node)
+{
+	return run(data, node, PHASE_PUSH);
+}
+
+static int workers_reserve(void *data, int32_t n_nodes, int32_t n_ports)
+{
+	struct pw_workers *this = data;
+	int res;
+
+	/* the replaced callbacks run the graph again when the workers are gone */
+	if (this->callbacks && this->callbacks->reserve &&
+	    (res = this->callbacks->reserve(this->callbacks_data, n_nodes, n_ports)) < 0)
+		return res;
+
+	return reserve(this, n_nodes, n_ports);
+}
+
+static const struct spa_graph_callbacks workers_callbacks = {
+	SPA_VERSION_GRAPH_CALLBACKS,
+	.need_input = workers_need_input,
+	.have_output = workers_have_output,
+	.reserve = workers_reserve,
+};
+
+/** Create a pool of workers that run the graph
+ * \param graph the graph to run
+ * \param n_workers the number of extra threads
+ * \param rtprio the realtime priority of the extra threads
+ * \return a new \ref pw_workers or NULL on error
+ *
+ * Independent branches of the graph are processed in parallel on the
+ * calling data thread and \a n_workers extra realtime threads. Each node
+ * has a counter of unfinished peers; when it drops to 0, the node is
+ * queued on the worker that released it and idle workers steal from
+ * the other queues.
+ *
+ * A cycle pulls data from upstream, releasing a node when all of its
+ * downstream peers are done, and then pushes the data downstream,
+ * releasing a node when all of its upstream peers are done. Only the
+ * nodes connected to the node that started the cycle are processed.
+ *
+ * Workers that find no node to process for a while go back to sleep until
+ * the next phase, the calling data thread finishes the phase and sleeps
+ * until a node is released when it has nothing to do itself.
+ *
+ * The graph callbacks are replaced by the workers until they are
+ * destroyed. The memory for the graph is reserved through the callbacks
+ * by the thread that changes the graph, so the workers should be created
+ * before nodes are added to the graph.
+ */
+struct pw_workers *pw_workers_new(struct spa_graph *graph, uint32_t n_workers, int rtprio)
+{
+	struct pw_workers *this;
+	uint32_t i;
+	int err;
+
+	this = calloc(1, sizeof(struct pw_workers));
+	if (this == NULL)
+		return NULL;
+
+	pw_log_debug("workers %p: new %d", this, n_workers);
+
+	this->graph = graph;
+	this->rtprio = rtprio;
+	this->version = SPA_ID_INVALID;
+	this->n_workers = n_workers + 1;
+	this->workers = calloc(this->n_workers, sizeof(struct worker));
+	if (this->workers == NULL)
+		goto no_mem;
+
+	for (i = 0; i < this->n_workers; i++) {
+		struct worker *w = &this->workers[i];
+
+		w->workers = this;
+		w->id = i;
+		w->steal_from = (i + 1) % this->n_workers;
+		sem_init(&w->sem, 0, 0);
+		if (i == 0)
+			continue;
+
+		if ((err = pthread_create(&w->thread, NULL, do_work, w)) != 0) {
+			pw_log_warn("workers %p: can't create thread: %s", this, strerror(err));
+			sem_destroy(&w->sem);
+			this->n_workers = i;
+			break;
+		}
+	}
+
+	this->callbacks = graph->callbacks;
+	this->callbacks_data = graph->callbacks_data;
+	spa_graph_set_callbacks(graph, &workers_callbacks, this);
+
+	return this;
+
+      no_mem:
+	free(this);
+	return NULL;
+}
+
+/** Destroy a pool of workers
+ * \param workers the workers to destroy
+ *
+ * The graph must not be running. The graph callbacks that were replaced
+ * by the workers are restored.
+ */
+void pw_workers_destroy(struct pw_workers *workers)
+{
+	uint32_t i;
+
+	pw_log_debug("workers %p: destroy", workers);
+
+	spa_graph_set_callbacks(workers->graph, workers->callbacks, workers->callbacks_data);
+
+	__atomic_store_n(&workers->quit, true, __ATOMIC_RELEASE);
+	for (i = 1; i < workers->n_workers; i++)
+		sem_post(&workers->workers[i].sem);
+
+	for (i = 0; i < workers->n_workers; i++) {
+		struct worker *w = &workers->workers[i];
+		if (i > 0)
+			pthread_join(w->thread, NULL);
+		sem_destroy(&w->sem);
+	}
+	free(workers->workers);
+	free_retired(workers);
+	free(workers->storage);
+	free(workers->pending);
+	free(workers);
+}
@@ -153,7 +153,15 @@ static void print_properties(struct spa_dict *props, char mark, bool header)
 	}
 
 	spa_dict_for_each(item, props) {
-		fprintf(stdout, "%c\t\t%s = \"%s\"\n", mark, item->key, item->value);
+		const char *s = item->value, *e;
+
+		fprintf(stdout, "%c\t\t%s = \"", mark, item->key);
+		/* indent the lines of multi-line values like the loop profiles */
+		while ((e = strchr(s, '\n')) != NULL) {
+			fprintf(stdout, "%.*s\n%c\t\t\t", (int)(e - s), s, mark);
+			s = e + 1;
+		}
+		fprintf(stdout, "%s\"\n", s);
 	}
 }
 